@@ -15,6 +15,28 @@
 // PB1 => status indicator LED
 // PB3 => relay coil pin1 (goes high for set/activate)
 // PB2 => relay coil pin2 (goes high for reset/deactivate)
+// PB4 => mute output, high = muted (USE_MUTE), or power-good input, low =
+//        supply failing (USE_POWER_FAIL)
+//
+// a non-latching relay (USE_NON_LATCHING, ATtiny85 only) has its coil on
+// PB3 only, which Timer1 drives (~OC1B) while the relay is held; PB2 is
+// unused
+//
+// a dimmed status LED (USE_LED_DIM, LED_DIM_PWM) is driven by Timer0 (OC0B)
+// on PB1 while the mcu sleeps
+//
+// MIDI input (USE_MIDI, ATtiny85 only): PB0 is the MIDI input (DI, from the
+// optocoupler's output), which the USI receives with Timer0 as its bit
+// clock; the switch moves to PB4
+//
+// multi-channel (MRC_N_CHANNELS == 2): two switches, and two single-coil
+// latching relays whose coils return through a shared pin; no pins are left
+// for status LEDs (light them from a spare relay pole)
+// PB0 => channel 0 momentary switch
+// PB2 => channel 1 momentary switch
+// PB3 => channel 0 relay coil (goes high for set, low for reset)
+// PB4 => channel 1 relay coil
+// PB1 => relay coil return, shared (low for set, high for reset)
 
 #include "../mcu-relay-controller-iface.h"
 
@@ -24,23 +46,238 @@
 #include <avr/power.h>     // power_all_disable();
 #include <avr/sleep.h>     // sleep states
 #include <avr/interrupt.h> // ISR() interrupt service routine macro
+#include <avr/wdt.h>       // wdt_reset(), wdt_enable()
+
+// start-up delay, run twice (before and after the peripheral set-up): a
+// margin for the surrounding circuitry to settle, on top of the start-up
+// time the SUT fuses already hold the mcu in reset for (14CK + 64ms with the
+// factory fuses), while the supply comes up; USE_FAST_BOOT relies on the
+// latter alone
+#ifndef STARTUP_DELAY_MS
+#  ifdef USE_FAST_BOOT
+#    define STARTUP_DELAY_MS 0
+#  else
+#    define STARTUP_DELAY_MS 5
+#  endif
+#endif
+
+// Timer0 in CTC mode, clocked at F_CPU/8: compare value for one tick
+#define TIMER0_TICK_OCR ((F_CPU / 8UL / 1000UL) * TIMER_TICK_MS - 1)
+
+// ATtiny13 has dedicated Timer0 interrupt mask/flag registers, the ATtiny85
+// shares TIMSK/TIFR between Timer0 and Timer1
+#ifdef ATTINY13
+#  define TIMER0_TIMSK TIMSK0
+#  define TIMER0_TIFR  TIFR0
+#else
+#  define TIMER0_TIMSK TIMSK
+#  define TIMER0_TIFR  TIFR
+#endif
+
+// Timer0 clock select: clk/8 at the normal clock; at the low clock (which is
+// already divided by 8) clk/1, so that a tick stays TIMER0_TICK_OCR + 1
+// counts long
+#ifdef USE_CLOCK_SCALING
+#  if CLOCK_LOW_DIV != 8
+#    error "Timer0 prescaler assumes CLOCK_LOW_DIV == 8"
+#  endif
+#  define TIMER0_CLOCK_SELECT (attiny_clock_low ? (1 << CS00) : (1 << CS01))
+volatile uint8_t attiny_clock_low = FALSE;
+static uint8_t clkps_normal; // CLKPR prescaler select, as set by the fuses
+#else
+#  define TIMER0_CLOCK_SELECT (1 << CS01)
+#endif // USE_CLOCK_SCALING
+
+// MRC_sleep_lowpower_ms(): whole periods of the watchdog (at its shortest,
+// 2048 cycles of its 128kHz oscillator) in power-down, the rest with Timer0
+// in idle mode, counting at 15.625kHz: clk/64 at the normal clock, clk/8 at
+// the low one
+#define WDT_PERIOD_MS 16
+#ifdef ATTINY13
+#  define WDT_INT_ENABLE WDTIE
+#else
+#  define WDT_INT_ENABLE WDIE
+#endif
+#ifdef USE_CLOCK_SCALING
+#  define LOWPOWER_TIMER0_CLOCK_SELECT (attiny_clock_low ? (1 << CS01) : ((1 << CS01) | (1 << CS00)))
+#else
+#  define LOWPOWER_TIMER0_CLOCK_SELECT ((1 << CS01) | (1 << CS00))
+#endif // USE_CLOCK_SCALING
+
+// power-good input (USE_POWER_FAIL): a divider from the unregulated supply,
+// its threshold above the regulator's dropout, or a supervisor's output;
+// no pull-up
+#ifdef USE_POWER_FAIL
+#  ifdef USE_MUTE
+#    error "USE_POWER_FAIL: the power-good pin is PB4, the mute output"
+#  endif
+#  define POWER_GOOD_PIN (1 << PB4)
+#endif // USE_POWER_FAIL
 
-#define STARTUP_DELAY_MS 5
+// non-latching relay hold (USE_NON_LATCHING): Timer1 in PWM mode B,
+// clocked at clk/1, counts 0..OCR1C; ~OC1B (PB3) is low from 0 to the
+// compare match, and high from there to OCR1C, i.e. for the hold duty.
+// Timer0 is taken (timer tick, low-power delays), and its outputs are the
+// switch and LED pins; OC1B (PB4) toggles along with ~OC1B, which does not
+// matter while PB4 is an input (the power-good pin, or NC)
+#ifdef USE_NON_LATCHING
+#  ifdef ATTINY13
+#    error "USE_NON_LATCHING: the hold PWM needs Timer1, which the ATtiny13 does not have"
+#  endif
+#  ifdef USE_MUTE
+#    error "USE_NON_LATCHING: Timer1 also drives OC1B, i.e. PB4, the mute output"
+#  endif
+// ~20kHz, above the audio band; OCR1B rounded down, so that the hold duty
+// is rounded up
+#  define HOLD_PWM_HZ 20000UL
+// Timer1 at clk/1, or clk/2 at 8MHz (USE_MIDI), where 400 steps would not
+// fit in OCR1C
+#  if (F_CPU / HOLD_PWM_HZ) <= 256
+#    define HOLD_DIV     1UL
+#    define HOLD_CS      (1 << CS10)
+#  else
+#    define HOLD_DIV     2UL
+#    define HOLD_CS      (1 << CS11)
+#  endif
+#  define HOLD_TOP       ((uint8_t)(F_CPU / HOLD_DIV / HOLD_PWM_HZ - 1))
+#  define HOLD_OCR(top)  ((uint8_t)((100U - RELAY_HOLD_PERCENT) * ((top) + 1U) / 100U))
+#  ifdef USE_CLOCK_SCALING
+#    define HOLD_TOP_LOW ((uint8_t)(F_CPU / HOLD_DIV / CLOCK_LOW_DIV / HOLD_PWM_HZ - 1))
+#  endif
+static volatile uint8_t attiny_relay_hold = FALSE;
+#  define HOLD_PWM_RUNNING attiny_relay_hold
+#else
+#  define HOLD_PWM_RUNNING FALSE
+#endif // USE_NON_LATCHING
+
+// dimmed status LED (USE_LED_DIM), while the mcu sleeps:
+//   - LED_DIM_PWM: Timer0 in fast PWM mode with OCR0A as TOP, clocked at
+//     clk/1 (~20kHz, as the hold); OC0B (PB1) is high from 0 to the compare
+//     match, i.e. for OCR0B + 1 of every LED_PWM_TOP + 1 counts.  Timer0's
+//     other uses (timer tick, low-power delays) are all while the mcu is
+//     awake, and always at the normal clock
+//   - LED_DIM_WDT: PB1 is driven high for LED_DIM_PULSE_US from each
+//     watchdog interrupt, in power-down
+#ifdef USE_LED_DIM
+#  if LED_DIM_METHOD == LED_DIM_PWM
+#    define LED_PWM_HZ  20000UL
+#    define LED_PWM_TOP ((uint8_t)(F_CPU / LED_PWM_HZ - 1))
+#    define LED_PWM_OCR ((uint8_t)((LED_DIM_PERCENT * (LED_PWM_TOP + 1U) + 99U) / 100U - 1U)) // rounded up
+#    define LED_PWM_RUNNING attiny_led_dim
+#  else
+#    define LED_DIM_PULSE_US (LED_DIM_PERCENT * WDT_PERIOD_MS * 10UL)
+#  endif
+static volatile uint8_t attiny_led_dim = FALSE;
+#endif // USE_LED_DIM
+#ifndef LED_PWM_RUNNING
+#  define LED_PWM_RUNNING FALSE
+#endif
+
+// Timer0 and Timer1 run from clkIO, which power-down stops: idle mode while
+// either drives an output
+#define SLEEP_MODE_DEEPEST ((HOLD_PWM_RUNNING || LED_PWM_RUNNING) ? SLEEP_MODE_IDLE : SLEEP_MODE_PWR_DOWN)
+
+// the watchdog wakes the mcu from power-down for the low-power delays
+// (USE_LOWPOWER_SLEEP) and the LED pulses (LED_DIM_WDT)
+#if defined(USE_LOWPOWER_SLEEP) || (defined(USE_LED_DIM) && (LED_DIM_METHOD == LED_DIM_WDT))
+#  define WDT_WAKE
+#endif
+
+// MIDI input (USE_MIDI): the USI shifts DI into USIDR on each Timer0
+// compare match, once a bit, with its wire mode off (USIWM = 00), so that
+// it leaves the port alone (three-wire mode would drive DO, PB1, the LED);
+// the start bit's falling edge reaches PCINT0_vect, which starts Timer0
+// (CTC, clk/1) with TCNT0 preset so that the compare matches fall in the
+// middle of the bits, and masks DI for the rest of the byte; the USI counter
+// overflows at the middle of bit 7, and its interrupt stops Timer0, unmasks
+// DI and queues USIBR (bit-reversed: the line is LSB first) for
+// MRC_midi_get().  it needs the 8MHz clock (CKDIV8 unprogrammed,
+// F_CPU=8000000UL): at 1MHz a bit is 32 cycles, and MIDI_START_CYCLES,
+// counted from the instruction set rather than the compiled vector, could
+// be off by a third of one
+#ifdef USE_MIDI
+#  ifdef ATTINY13
+#    error "USE_MIDI: the ATtiny13 has no USI"
+#  endif
+#  if defined(USE_MUTE) || defined(USE_POWER_FAIL)
+#    error "USE_MIDI: the switch moves to PB4, the mute output or power-good input"
+#  endif
+#  if defined(USE_LOWPOWER_SLEEP) || defined(USE_LED_DIM)
+#    error "USE_MIDI: Timer0 is the USI's bit clock"
+#  endif
+#  ifdef USE_CLOCK_SCALING
+#    error "USE_MIDI: the bit timing is counted in cycles of F_CPU"
+#  endif
+#  ifdef USE_TRACE
+#    error "USE_MIDI: the receiver's interrupts would stretch the trace dump's bits"
+#  endif
+#  define MIDI_BAUD       31250UL
+#  define MIDI_BIT_CYCLES (F_CPU / MIDI_BAUD)
+#  if (F_CPU % MIDI_BAUD) || (MIDI_BIT_CYCLES != 256)
+#    error "USE_MIDI: needs F_CPU=8000000UL (the CKDIV8 fuse unprogrammed)"
+#  endif
+// cycles from the start bit's edge to the TCNT0 write in PCINT0_vect, the
+// mcu awake: synchronizer (2), interrupt response and vector (6), the
+// prologue and the DI test; the wake-up from power-down adds ~10.  an
+// estimate: 15 cycles either way moves the sample point by 6% of a bit
+#  ifndef MIDI_START_CYCLES
+#    define MIDI_START_CYCLES 32
+#  endif
+// the first compare match is in the middle of bit 0, 1.5 bits after the
+// edge; if the interrupt comes sooner than half a bit, TCNT0 cannot be set
+// back that far, and the first match is in the middle of the start bit
+// instead, which a ninth sample shifts out of USIDR
+#  if MIDI_START_CYCLES > MIDI_BIT_CYCLES / 2
+#    define MIDI_TCNT_START (MIDI_START_CYCLES - 1 - MIDI_BIT_CYCLES / 2)
+#    define MIDI_SAMPLES    8
+#  else
+#    define MIDI_TCNT_START (MIDI_BIT_CYCLES / 2 - 1 + MIDI_START_CYCLES)
+#    define MIDI_SAMPLES    9
+#  endif
+// received bytes, as shifted in, in a ring (one slot kept empty)
+#  define MIDI_RX_SIZE     16
+#  define MIDI_RX_LOST_RAW 0x2F // MIDI_RX_LOST, bit-reversed
+static volatile uint8_t midi_rx[MIDI_RX_SIZE];
+static volatile uint8_t midi_rx_head; // written by USI_OVF_vect
+static volatile uint8_t midi_rx_tail; // written by MRC_midi_get()
+static volatile uint8_t midi_rx_lost; // a byte was dropped, not yet marked
+static volatile uint8_t attiny_midi_busy; // a byte on its way in
+static volatile uint8_t attiny_midi_high; // DI's level, as last seen
+#endif // USE_MIDI
+
+// the ATtiny13 has only the low byte of the EEPROM address register
+#ifdef ATTINY13
+#  define EEPROM_ADDR EEARL
+#else
+#  define EEPROM_ADDR EEAR
+#endif
 
 
 void MRC_hardware_init(void)
 {
-    // not sure if this is necessary - just want to give the mcu and
-    // surrounding circuitry little time to "settle"
+#ifdef USE_POWER_FAIL
+    // after the watchdog reset of MRC_power_fail_halt(), WDRF keeps the
+    // watchdog enabled (in reset mode) until it is cleared
+    MCUSR = 0;
+    wdt_disable();
+#endif // USE_POWER_FAIL
+
+#if STARTUP_DELAY_MS
     _delay_ms(STARTUP_DELAY_MS);
+#endif
 
     // set data direction register so that PB0 is an input,
-    // PB1-3 are outputs
-    DDRB = 0b00001110;
+    // PB1-3 are outputs (and PB4, for the mute output)
+    DDRB = DDRB_OUTPUTS;
 
-    // enable the input pullup for PB0
+    // enable the input pullup for PB0 (the switch pins)
     // keeps PB0 high, will go low when switch is pressed
-    PORTB = 0b00000001;
+    PORTB = SWITCH_PINS;
+
+#ifdef USE_CLOCK_SCALING
+    // with the CKDIV8 fuse programmed, this is clk/8 (i.e. F_CPU = 1MHz)
+    clkps_normal = CLKPR & 0x0F;
+#endif // USE_CLOCK_SCALING
 
     // disable ADC (analog to digital converter)
     ADCSRA = 0;
@@ -54,53 +291,653 @@ void MRC_hardware_init(void)
     // turn on pin change interrupts
     GIMSK = 0b00100000;
 
-    // set physical pin5 aka PB0 to be the pin watched for pin changes
+    // set physical pin5 aka PB0 (the switch pins) to be the pin watched for
+    // pin changes
     // bits 5:0 - PCINT[5:0]
     // PCINT0 = bit0 of PCMSK, aka physical pin5 aka PB0
     // see page 52, section 9.3.4 of datasheet
-    PCMSK = 0b00000001; 
+    PCMSK = SWITCH_PINS;
 
     // MCU Control Register
     // Bits 1:0 - ISC0[1:0]: Interrupt Sense Control 0 Bit 1 and Bit 0
     //MCUCR = 0b00000010; // falling edge of INT0 generates an interrupt request
 
+#ifdef USE_MIDI
+    // DI pulled up: an input with nothing plugged in idles high
+    PORTB |= MIDI_PIN;
+    power_timer0_enable(); // were disabled by power_all_disable()
+    power_usi_enable();
+    OCR0A  = MIDI_BIT_CYCLES - 1;
+    TCCR0A = (1 << WGM01); // CTC mode, OC0A/OC0B pins disconnected; stopped
+    USISR  = (1 << USIOIF) | (16 - MIDI_SAMPLES);
+    USICR  = (1 << USIOIE) | (1 << USICS0); // Timer0 compare match clock
+    attiny_midi_high = TRUE;
+    PCMSK = SWITCH_PINS | MIDI_PIN;
+#endif // USE_MIDI
+
+#if STARTUP_DELAY_MS
     _delay_ms(STARTUP_DELAY_MS);
+#endif
 
     // SLEEP_MODE_PWR_DOWN is the lowest power state for the ATtiny45/85
     // for our purposes, we generally want only the pin-change detection
     // circuitry active
 	set_sleep_mode(SLEEP_MODE_PWR_DOWN);
 
+#ifdef USE_MIDI
+    MRC_switch_pin_clear_int_flags(); // takes the switch's level
+#endif // USE_MIDI
+
+#ifdef USE_POWER_FAIL
+    // the power-good pin shares the pin-change interrupt with the switch,
+    // and is armed from here on; a pin that is low already makes no change
+    PCMSK = POWER_GOOD_PIN;
+    sei();
+    if (!(PINB & POWER_GOOD_PIN)) { power_fail(); }
+#endif // USE_POWER_FAIL
 }
 
-void MRC_disable_interrupts(void) { cli(); }
+// the switch's pin changes since MRC_switch_pin_clear_int_flags(): PCIF,
+// while interrupts are disabled, or this flag, once the interrupt has taken
+// PCIF (interrupts enabled for the timer, USE_POWER_FAIL or USE_MIDI)
+static volatile uint8_t attiny_switch_edge;
+
+#ifdef USE_MIDI
+// with the MIDI input sharing the pin-change interrupt, a change of the
+// switch is told from the others by its level, as at the last clear
+static volatile uint8_t attiny_switch_level;
+#endif // USE_MIDI
+
+#if defined(USE_POWER_FAIL) || defined(USE_MIDI)
+// the switch masks itself once a change of it is recorded (see
+// PCINT0_vect), so interrupts are left enabled: the power-good pin can
+// still preempt the core, and the MIDI input keeps receiving; the longest
+// the interrupt waits is then another interrupt's service routine, or one
+// of the few-cycle timed sequences below
+void MRC_switch_wake_disarm(void) { sei(); }
+#else
+// nothing else to serve: interrupts off, and PCIF records the switch
+void MRC_switch_wake_disarm(void) { cli(); }
+#endif // USE_POWER_FAIL || USE_MIDI
 void MRC_disable_sleep(void) { sleep_disable(); }
-void MRC_enable_interrupts(void) { sei(); }
 
+#ifdef WDT_WAKE
+static volatile uint8_t lowpower_wake; // set by the interrupt that ends a wait
+
+// interrupt mode (WDE = 0), WDP[3:0] = 0000: 16ms; the change needs the
+// timed WDCE sequence, with interrupts disabled
+static void wdt_interrupt_start(void)
+{
+    wdt_reset();
+    WDTCR = (1 << WDCE) | (1 << WDE);
+    WDTCR = (1 << WDT_INT_ENABLE);
+}
+
+static void wdt_interrupt_stop(void)
+{
+    WDTCR = (1 << WDCE) | (1 << WDE);
+    WDTCR = 0;
+}
+
+ISR(WDT_vect)
+{
+    lowpower_wake = TRUE;
+}
+#endif // WDT_WAKE
+
+#if defined(USE_LED_DIM) && (LED_DIM_METHOD == LED_DIM_WDT)
+// sleep until a pin change, with the LED lit for LED_DIM_PULSE_US after each
+// watchdog wake-up; a pin change during a pulse is taken as soon as it is
+// over.  called, and returns, with interrupts disabled
+static void led_dim_sleep(void)
+{
+    wdt_interrupt_start();
+    while (!attiny_switch_edge)
+    {
+        lowpower_wake = FALSE;
+        sleep_enable();
+        sei();       // the instruction following sei() runs before any
+        sleep_cpu(); // pending interrupt, so the wake-up cannot be missed
+        sleep_disable();
+        cli();
+        if (lowpower_wake && !attiny_switch_edge)
+        {
+            PORTB |= (1 << PB1);
+            _delay_us(LED_DIM_PULSE_US);
+            PORTB &= ~(1 << PB1);
+        }
+    }
+    wdt_interrupt_stop();
+}
+#endif // USE_LED_DIM
+
+// the switch is armed and the mcu put to sleep as one operation, with
+// interrupts disabled up to the sleep instruction: a pin change since
+// MRC_switch_pin_clear_int_flags() is either still pending in PCIF, and
+// wakes the mcu as soon as it sleeps, or was taken by the interrupt
+// already, and there is no sleep at all
 void MRC_enter_sleep_mode(void)
 {
-    sleep_enable(); // enable sleeping
-    sleep_mode();   // go to sleep
+    cli();
+    if (attiny_switch_edge) { sei(); return; }
+#ifdef USE_POWER_FAIL
+    PCMSK = SWITCH_PINS | POWER_GOOD_PIN; // masked until now at start-up
+#endif // USE_POWER_FAIL
+#if defined(USE_NON_LATCHING) || defined(USE_LED_DIM)
+    set_sleep_mode(SLEEP_MODE_DEEPEST);
+#endif // USE_NON_LATCHING || USE_LED_DIM
+#if defined(USE_LED_DIM) && (LED_DIM_METHOD == LED_DIM_WDT)
+    if (attiny_led_dim) { led_dim_sleep(); return; }
+#endif // USE_LED_DIM
+#ifdef USE_MIDI
+    // a byte on its way needs Timer0 and the USI, i.e. clkIO: idle until it
+    // is in; a byte in the buffer, or a switch change, ends the sleep
+    while (!attiny_switch_edge && (midi_rx_head == midi_rx_tail))
+    {
+        set_sleep_mode(attiny_midi_busy ? SLEEP_MODE_IDLE : SLEEP_MODE_DEEPEST);
+        sleep_enable();
+        sei();       // the instruction following sei() runs before any
+        sleep_cpu(); // pending interrupt, so the wake-up cannot be missed
+        sleep_disable();
+        cli();
+    }
+    set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+    sei();
+#else
+    sleep_enable();
+    sei();       // the instruction following sei() runs before any
+    sleep_cpu(); // pending interrupt, so the wake-up cannot be missed
+    sleep_disable();
+#endif // USE_MIDI
+}
+
+#ifdef USE_TIMER_TICK
+void MRC_timer_start(void)
+{
+#ifndef ATTINY13
+    power_timer0_enable(); // was disabled by power_all_disable()
+#endif // ATTINY13
+    TCNT0  = 0;
+    OCR0A  = TIMER0_TICK_OCR;
+    TCCR0A = (1 << WGM01); // CTC mode, OC0A/OC0B pins disconnected
+    TCCR0B = TIMER0_CLOCK_SELECT; // clk/8 (or clk/1 at the low clock), starts the timer
+    TIMER0_TIFR = (1 << OCF0A); // clear any stale flag (write one to clear)
+    TIMER0_TIMSK |= (1 << OCIE0A);
+    sei();
+}
+
+void MRC_timer_stop(void)
+{
+    TIMER0_TIMSK &= ~(1 << OCIE0A);
+    TCCR0B = 0; // no clock source, timer stopped
+#ifndef ATTINY13
+    power_timer0_disable();
+#endif // ATTINY13
+}
+
+// the cpu clock halts, but clkIO (and so Timer0) keeps running
+void MRC_enter_idle_mode(void)
+{
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    sleep_mode();
+    set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+}
+
+ISR(TIM0_COMPA_vect)
+{
+    timer_tick();
+}
+#endif // USE_TIMER_TICK
+
+#ifdef USE_LOWPOWER_SLEEP
+// sleep in mode until the watchdog or Timer0 compare B interrupt; called,
+// and returns, with interrupts disabled
+static void lowpower_sleep(uint8_t mode)
+{
+    set_sleep_mode(mode);
+    lowpower_wake = FALSE;
+    while (!lowpower_wake)
+    {
+        sleep_enable();
+        sei();       // the instruction following sei() runs before any
+        sleep_cpu(); // pending interrupt, so the wake-up cannot be missed
+        sleep_disable();
+        cli();
+    }
+}
+
+void MRC_sleep_lowpower_ms(uint16_t ms)
+{
+    uint8_t sreg = SREG;
+    cli();
+
+    // pin changes still set PCIF, as they would during a busy-wait, but do
+    // not wake the mcu; with USE_POWER_FAIL the power-good pin must still
+    // wake it, and a switch change then only wakes it to be recorded (see
+    // MRC_switch_pin_clear_int_flags())
+    uint8_t gimsk = GIMSK;
+#ifndef USE_POWER_FAIL
+    GIMSK = 0;
+#endif // USE_POWER_FAIL
+
+    uint16_t periods = ms / WDT_PERIOD_MS;
+    if (periods)
+    {
+        wdt_interrupt_start();
+        while (periods--) { lowpower_sleep(SLEEP_MODE_DEEPEST); }
+        wdt_interrupt_stop();
+    }
+
+    uint8_t rest_ms = ms % WDT_PERIOD_MS;
+    if (rest_ms)
+    {
+#ifndef ATTINY13
+        power_timer0_enable(); // was disabled by power_all_disable()
+#endif // ATTINY13
+        TCCR0A = 0; // normal mode
+        TCNT0  = 0;
+        OCR0B  = (uint8_t)(rest_ms * 125U / 8U - 1); // 15.625 counts per ms
+        TIMER0_TIFR = (1 << OCF0B);
+        TIMER0_TIMSK |= (1 << OCIE0B);
+        TCCR0B = LOWPOWER_TIMER0_CLOCK_SELECT;
+        lowpower_sleep(SLEEP_MODE_IDLE);
+        TCCR0B = 0;
+        TIMER0_TIMSK &= ~(1 << OCIE0B);
+#ifndef ATTINY13
+        power_timer0_disable();
+#endif // ATTINY13
+    }
+
+    GIMSK = gimsk;
+    set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+    SREG = sreg;
+}
+
+ISR(TIM0_COMPB_vect)
+{
+    lowpower_wake = TRUE;
+}
+#endif // USE_LOWPOWER_SLEEP
+
+#ifdef USE_VCC_COMPENSATION
+#ifdef ATTINY13
+#  error "USE_VCC_COMPENSATION: the ATtiny13 ADC cannot measure its bandgap reference"
+#endif // ATTINY13
+
+// convert the 1.1V bandgap with VCC as the reference: ADC = 1.1V * 1024 / VCC
+#define BANDGAP_MV 1100UL
+
+// ADC clock: clk/8 at 1MHz, clk/64 at 8MHz (USE_MIDI); 50-200kHz
+#if F_CPU >= 8000000UL
+#  define ADC_PRESCALE ((1 << ADPS2) | (1 << ADPS1))
+#else
+#  define ADC_PRESCALE ((1 << ADPS1) | (1 << ADPS0))
+#endif
+
+static uint16_t adc_convert(void)
+{
+    ADCSRA |= (1 << ADSC);
+    while (ADCSRA & (1 << ADSC)) { }
+    return ADC;
+}
+
+uint16_t MRC_supply_millivolts(void)
+{
+    power_adc_enable(); // was disabled by power_all_disable()
+    ADMUX = 0b00001100; // REFS[2:0] = 000: VCC reference; MUX[3:0] = 1100: Vbg
+    ADCSRA = (1 << ADEN) | ADC_PRESCALE; // 125kHz
+
+    // the first conversion (25 ADC clocks, 200us) also covers the bandgap
+    // start-up time; discard it
+    adc_convert();
+    uint16_t adc = adc_convert();
+
+    ADCSRA = 0;
+    power_adc_disable();
+    return adc ? (uint16_t)(BANDGAP_MV * 1024UL / adc) : UINT16_MAX;
+}
+#endif // USE_VCC_COMPENSATION
+
+#ifdef USE_NON_LATCHING
+// the period for the clock in use: the same frequency at the low clock,
+// with fewer steps of duty
+static void hold_pwm_set(void)
+{
+    uint8_t top = HOLD_TOP;
+#ifdef USE_CLOCK_SCALING
+    if (attiny_clock_low) { top = HOLD_TOP_LOW; }
+#endif // USE_CLOCK_SCALING
+    OCR1C = top;
+    OCR1B = HOLD_OCR(top);
+}
+
+void MRC_relay_hold_start(void)
+{
+    power_timer1_enable(); // was disabled by power_all_disable()
+    hold_pwm_set();
+    TCNT1 = 0;
+    GTCCR = (1 << PWM1B) | (1 << COM1B0); // ~OC1B takes over PB3 from PORTB
+    TCCR1 = HOLD_CS; // starts the timer
+    attiny_relay_hold = TRUE;
+}
+
+// PORTB's PB3 is cleared while ~OC1B still overrides it, so that the pin
+// goes straight from the PWM to low; Timer1's registers cannot be written
+// once it is powered down, hence the flag
+void MRC_relay_hold_stop(void)
+{
+    if (!attiny_relay_hold) { return; }
+    PORTB &= ~(1 << PB3);
+    GTCCR = 0;
+    TCCR1 = 0; // no clock source, timer stopped
+    power_timer1_disable();
+    attiny_relay_hold = FALSE;
+}
+#endif // USE_NON_LATCHING
+
+#ifdef USE_LED_DIM
+#if LED_DIM_METHOD == LED_DIM_PWM
+void MRC_led_dim_start(void)
+{
+#ifndef ATTINY13
+    power_timer0_enable(); // was disabled by power_all_disable()
+#endif // ATTINY13
+    TCNT0  = 0;
+    OCR0A  = LED_PWM_TOP;
+    OCR0B  = LED_PWM_OCR;
+    TCCR0A = (1 << COM0B1) | (1 << WGM01) | (1 << WGM00); // OC0B takes over PB1 from PORTB
+    TCCR0B = (1 << WGM02) | (1 << CS00); // fast PWM to OCR0A, clk/1, starts the timer
+    attiny_led_dim = TRUE;
+}
+
+// PORTB's PB1 is still set: the pin goes straight from the PWM to lit
+void MRC_led_dim_stop(void)
+{
+    if (!attiny_led_dim) { return; }
+    TCCR0B = 0; // no clock source, timer stopped
+    TCCR0A = 0; // OC0B disconnected
+#ifndef ATTINY13
+    power_timer0_disable();
+#endif // ATTINY13
+    attiny_led_dim = FALSE;
+}
+#else
+// PB1 is low between the pulses of led_dim_sleep(), which stops the
+// watchdog before it returns
+void MRC_led_dim_start(void) { PORTB &= ~(1 << PB1); attiny_led_dim = TRUE; }
+
+void MRC_led_dim_stop(void)
+{
+    if (!attiny_led_dim) { return; }
+    PORTB |= (1 << PB1);
+    attiny_led_dim = FALSE;
+}
+#endif // LED_DIM_METHOD
+#endif // USE_LED_DIM
+
+#ifdef USE_CLOCK_SCALING
+void MRC_set_clock_profile(uint8_t profile)
+{
+    uint8_t low = (CLOCK_PROFILE_LOW == profile);
+    uint8_t clkps = low ? clkps_normal + CLOCK_LOW_SHIFT : clkps_normal;
+    uint8_t sreg = SREG;
+
+    // the CLKPR change is a timed sequence: the new value must be written
+    // within four cycles of setting CLKPCE (clkps is computed beforehand)
+    cli();
+    CLKPR = (1 << CLKPCE);
+    CLKPR = clkps;
+    attiny_clock_low = low;
+#ifdef USE_TIMER_TICK
+    if (TCCR0B) { TCCR0B = TIMER0_CLOCK_SELECT; } // timer running
+#endif // USE_TIMER_TICK
+#ifdef USE_NON_LATCHING
+    if (attiny_relay_hold) { hold_pwm_set(); }
+#endif // USE_NON_LATCHING
+    SREG = sreg;
+}
+#endif // USE_CLOCK_SCALING
+
+#ifdef USE_PERSIST
+uint8_t MRC_eeprom_read(uint16_t addr)
+{
+    while (EECR & (1 << EEPE)) { } // no reads while a write is in progress
+    EEPROM_ADDR = addr;
+    EECR |= (1 << EERE);
+    return EEDR;
+}
+
+void MRC_eeprom_write_start(uint16_t addr, uint8_t value)
+{
+    while (EECR & (1 << EEPE)) { }
+    uint8_t sreg = SREG;
+
+    // EEPE must be set within four cycles of EEMPE
+    cli();
+    EECR = 0; // EEPM[1:0] = 00: atomic erase and write, 3.4ms
+    EEPROM_ADDR = addr;
+    EEDR = value;
+    EECR |= (1 << EEMPE);
+    EECR |= (1 << EEPE);
+    SREG = sreg;
+}
+
+// the write runs on its own oscillator; sleep in idle mode (power-down would
+// be left partly awake by it) until EE_RDY, which fires as long as EERIE is
+// set and no write is in progress, so the ISR clears EERIE; returns with
+// interrupts as they were (enabled with USE_POWER_FAIL or USE_MIDI, which
+// need them throughout)
+void MRC_eeprom_wait(void)
+{
+    uint8_t sreg = SREG;
+    cli();
+    while (EECR & (1 << EEPE))
+    {
+        EECR |= (1 << EERIE);
+        set_sleep_mode(SLEEP_MODE_IDLE);
+        sleep_enable();
+        sei();       // the instruction following sei() runs before any
+        sleep_cpu(); // pending interrupt, so EE_RDY cannot be missed
+        sleep_disable();
+        cli();
+        set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+    }
+    SREG = sreg;
+}
+
+ISR(EE_RDY_vect)
+{
+    EECR &= ~(1 << EERIE);
 }
+#endif // USE_PERSIST
 
+#ifndef MRC_INLINE_HAL // otherwise macros in attiny.h
+#if MRC_N_CHANNELS > 1
+// PB0 => bit 0, PB2 => bit 1
+uint8_t MRC_switch_pins_get_state(void)
+{
+    uint8_t pins = PINB;
+    return (pins & 0b01) | ((pins >> 1) & 0b10);
+}
+
+// set: coil pins high, return low; reset: return high, coil pins low, and
+// the coil pins of the other channels high with the return, so that no
+// current flows through their coils; one write to PORTB
+void MRC_relay_coils_drive(uint8_t mask, uint8_t state)
+{
+    uint8_t coils = (uint8_t)((mask & MRC_CHANNEL_MASK) << PB3);
+    uint8_t port = PORTB & (uint8_t)~(COIL_PINS | COIL_RETURN);
+    if (ON == state) { port |= coils; }
+    else             { port |= COIL_RETURN | (COIL_PINS & (uint8_t)~coils); }
+    PORTB = port;
+}
+
+void MRC_relay_coils_release(void) { PORTB &= (uint8_t)~(COIL_PINS | COIL_RETURN); }
+void MRC_leds_set(uint8_t mask) { }
+#else
 void MRC_led_pin_set_high(void) { PORTB |=  (1 << PB1); }
 void MRC_led_pin_set_low(void)  { PORTB &= ~(1 << PB1); }
 void MRC_led_toggle(void)       { PORTB ^=  (1 << PB1); }
 
+// one write to PORTB: the outputs change on the same cycle
+void MRC_port_apply(uint8_t set, uint8_t clear)
+{
+    PORTB = (uint8_t)((PORTB & (uint8_t)~clear) | set);
+}
+
+#ifdef USE_MUTE
+void MRC_mute_pin_set_high(void) { PORTB |=  (1 << PB4); }
+void MRC_mute_pin_set_low(void)  { PORTB &= ~(1 << PB4); }
+#endif // USE_MUTE
+
 void MRC_relay_coil_pin1_set_high(void) { PORTB |=  (1 << PB3); } // PB3 == pin1
 void MRC_relay_coil_pin1_set_low(void)  { PORTB &= ~(1 << PB3); }
 void MRC_relay_coil_pin2_set_high(void) { PORTB |=  (1 << PB2); } // PB2 == pin2
 void MRC_relay_coil_pin2_set_low(void)  { PORTB &= ~(1 << PB2); }
 
-uint8_t MRC_switch_pin_get_state(void) { return 0 == (PINB & 0b1) ? LOW : HIGH; }
-void MRC_switch_pin_clear_int_flags(void) { }
+uint8_t MRC_switch_pin_get_state(void) { return 0 == (PINB & SWITCH_PINS) ? LOW : HIGH; }
+#endif // MRC_N_CHANNELS
+#endif // MRC_INLINE_HAL
+
+// out of line even with MRC_INLINE_HAL: called once per wake-up at most.
+// with USE_POWER_FAIL, PCIF is left alone (the interrupt takes it at once,
+// and clearing it could drop a power-good change), and the switch is
+// unmasked, so that its next change reaches the interrupt.  likewise with
+// USE_MIDI (a start bit), where the level is taken as well, and read again
+// once the switch is unmasked: a change in between made no interrupt
+void MRC_switch_pin_clear_int_flags(void)
+{
+#ifdef USE_POWER_FAIL
+    attiny_switch_edge = FALSE;
+    PCMSK = SWITCH_PINS | POWER_GOOD_PIN;
+#elif defined(USE_MIDI)
+    uint8_t sreg = SREG;
+    cli();
+    attiny_switch_edge = FALSE;
+    attiny_switch_level = PINB & SWITCH_PINS;
+    PCMSK |= SWITCH_PINS;
+    if ((PINB & SWITCH_PINS) != attiny_switch_level)
+    {
+        attiny_switch_edge = TRUE;
+        PCMSK &= ~SWITCH_PINS;
+    }
+    SREG = sreg;
+#else
+    GIFR = (1 << PCIF); // write one to clear
+    attiny_switch_edge = FALSE;
+#endif // USE_POWER_FAIL
+}
+
+#if MRC_N_CHANNELS == 1
+// cleared only if set: a change that comes between the test and the clear
+// is then one already counted, and the pin is read after the clear
+uint8_t MRC_switch_press_pending(void)
+{
+#if defined(USE_POWER_FAIL) || defined(USE_MIDI)
+    if (!attiny_switch_edge) { return FALSE; }
+#else
+    if (!attiny_switch_edge && !(GIFR & (1 << PCIF))) { return FALSE; }
+#endif // USE_POWER_FAIL || USE_MIDI
+    MRC_switch_pin_clear_int_flags();
+    return LOW == MRC_switch_pin_get_state();
+}
+#endif // MRC_N_CHANNELS
 
 
 // https://www.nongnu.org/avr-libc/user-manual/group__avr__interrupts.html
-// don't actually do anything in the ISR (except disable interrupts), we just
-// want to wake the mcu from sleep; actual work takes place in the main loop
+// don't actually do anything in the ISR (except record the pin change), we
+// just want to wake the mcu from sleep; actual work takes place in the main
+// loop
+#ifdef USE_MIDI
+// a start bit: the first thing PCINT0_vect does (see MIDI_START_CYCLES)
+static inline void midi_rx_start(void)
+{
+    TCNT0  = MIDI_TCNT_START;
+    TCCR0B = (1 << CS00); // clk/1, starts the timer
+    PCMSK &= ~MIDI_PIN;   // the byte's own edges are not start bits
+    attiny_midi_busy = TRUE;
+}
+
 ISR(PCINT0_vect)
 {
-    cli(); // disable interrupts
+    uint8_t pins = PINB;
+    if (PCMSK & MIDI_PIN)
+    {
+        if (attiny_midi_high && !(pins & MIDI_PIN)) { midi_rx_start(); }
+        else { attiny_midi_high = pins & MIDI_PIN; }
+    }
+    if ((PCMSK & SWITCH_PINS) && ((pins ^ attiny_switch_level) & SWITCH_PINS))
+    {
+        attiny_switch_edge = TRUE;
+        PCMSK &= ~SWITCH_PINS; // recorded: masked until cleared
+    }
+}
+
+// the middle of bit 7: DI is unmasked first, as the stop bit may be all
+// the time there is before the next start bit; a full ring drops the byte,
+// and MIDI_RX_LOST goes in ahead of the next one there is room for
+ISR(USI_OVF_vect)
+{
+    PCMSK |= MIDI_PIN;
+    TCCR0B = 0; // Timer0 stopped, and with it the USI clock
+    uint8_t raw = USIBR;
+    USISR = (1 << USIOIF) | (16 - MIDI_SAMPLES); // ready for the next byte
+    attiny_midi_high = raw & 1; // bit 7, on the line until the stop bit
+    attiny_midi_busy = FALSE;
+
+    uint8_t head = midi_rx_head;
+    uint8_t next = (head + 1) & (MIDI_RX_SIZE - 1);
+    if (midi_rx_lost && next != midi_rx_tail)
+    {
+        midi_rx[head] = MIDI_RX_LOST_RAW;
+        head = next;
+        next = (head + 1) & (MIDI_RX_SIZE - 1);
+        midi_rx_lost = FALSE;
+    }
+    if (next == midi_rx_tail) { midi_rx_lost = TRUE; }
+    else                      { midi_rx[head] = raw; head = next; }
+    midi_rx_head = head;
+}
+
+uint8_t MRC_midi_get(uint8_t* byte)
+{
+    uint8_t tail = midi_rx_tail;
+    if (tail == midi_rx_head) { return FALSE; }
+
+    uint8_t raw = midi_rx[tail];
+    uint8_t b = 0;
+    for (uint8_t i=0; i<8; ++i)
+    {
+        b = (uint8_t)((b << 1) | (raw & 1));
+        raw >>= 1;
+    }
+    midi_rx_tail = (tail + 1) & (MIDI_RX_SIZE - 1);
+    *byte = b;
+    return TRUE;
+}
+#else
+ISR(PCINT0_vect)
+{
+#ifdef USE_POWER_FAIL
+    if (!(PINB & POWER_GOOD_PIN)) { power_fail(); } // does not return
+#endif // USE_POWER_FAIL
+    attiny_switch_edge = TRUE;
+#ifdef USE_POWER_FAIL
+    PCMSK = POWER_GOOD_PIN; // recorded: masked until cleared
+#endif // USE_POWER_FAIL
+}
+#endif // USE_MIDI
+
+#ifdef USE_POWER_FAIL
+// interrupts are disabled in the service routine: spin until the supply
+// dies, or comes back after a dip, in which case the watchdog restarts the
+// firmware from reset, rather than resume a core that was preempted
+// anywhere
+void MRC_power_fail_halt(void)
+{
+    while (!(PINB & POWER_GOOD_PIN)) { }
+    wdt_enable(WDTO_15MS);
+    for (;;) { }
 }
+#endif // USE_POWER_FAIL
 
@@ -5,10 +5,98 @@
 #ifndef ATTINY_H__
 #define ATTINY_H__
 
+#include <avr/io.h>        // Defines register and bit names
 #include <util/delay.h>    // Defines _delay_ms
 
-#define MRC_sleep_millisecs(n) _delay_ms(n);
-#define MRC_sleep_microsecs(n) _delay_us(n);
+#ifdef USE_CLOCK_SCALING
+// - CLOCK_PROFILE_LOW divides the system clock by a further CLOCK_LOW_DIV
+//   (e.g. 1MHz => 125kHz); _delay_ms()/_delay_us() count cycles of F_CPU,
+//   so while it is active they are asked for 1/CLOCK_LOW_DIV of the time
+// - the arguments are compile-time constants, so both branches are plain
+//   cycle-counting loops
+#  define CLOCK_LOW_DIV   8
+#  define CLOCK_LOW_SHIFT 3 // log2(CLOCK_LOW_DIV), in CLKPR prescaler steps
+extern volatile uint8_t attiny_clock_low;
+#  define MRC_sleep_millisecs(n) do { if (attiny_clock_low) { _delay_ms((n) / (double)CLOCK_LOW_DIV); } else { _delay_ms(n); } } while(0);
+#  define MRC_sleep_microsecs(n) do { if (attiny_clock_low) { _delay_us((n) / (double)CLOCK_LOW_DIV); } else { _delay_us(n); } } while(0);
+#else
+#  define MRC_sleep_millisecs(n) _delay_ms(n);
+#  define MRC_sleep_microsecs(n) _delay_us(n);
+#endif // USE_CLOCK_SCALING
+
+// data EEPROM (USE_PERSIST)
+#ifdef ATTINY13
+#  define MRC_EEPROM_SIZE 64
+#else
+#  define MRC_EEPROM_SIZE 512
+#endif // ATTINY13
+
+// pin assignment (see attiny.c)
+#if MRC_N_CHANNELS > 1
+#  if MRC_N_CHANNELS != 2
+#    error "MRC_N_CHANNELS: the ATtiny multi-channel configuration has two channels"
+#  endif
+#  define COIL_PINS   ((1 << PB3) | (1 << PB4)) // channel n => PB3 + n
+#  define COIL_RETURN (1 << PB1)
+#  define DDRB_OUTPUTS   (COIL_PINS | COIL_RETURN)
+#  define SWITCH_PINS    ((1 << PB0) | (1 << PB2))
+#elif defined(USE_MUTE)
+#  define DDRB_OUTPUTS   0b00011110 // PB1-3, PB4 for the mute output
+#  define SWITCH_PINS    (1 << PB0)
+#elif defined(USE_MIDI)
+#  define DDRB_OUTPUTS   0b00001110 // PB1-3
+#  define SWITCH_PINS    (1 << PB4) // PB0 is the MIDI input
+#  define MIDI_PIN       (1 << PB0)
+#else
+#  define DDRB_OUTPUTS   0b00001110 // PB1-3
+#  define SWITCH_PINS    (1 << PB0)
+#endif // MRC_N_CHANNELS
+
+// outputs in PORTB, for MRC_port_apply()
+#define MRC_PORT_LED   (1 << PB1)
+#define MRC_PORT_MUTE  (1 << PB4)
+#define MRC_PORT_COIL1 (1 << PB3)
+#define MRC_PORT_COIL2 (1 << PB2)
+
+#ifdef MRC_INLINE_HAL
+// pin operations, one sbi/cbi (or in/sbic) each at the call site; with
+// constant masks, MRC_port_apply() is in, andi, ori, out
+#  if MRC_N_CHANNELS > 1
+// PB0 => bit 0, PB2 => bit 1
+static inline uint8_t attiny_switch_pins_get_state(void)
+{
+    uint8_t pins = PINB;
+    return (pins & 0b01) | ((pins >> 1) & 0b10);
+}
+
+// see MRC_relay_coils_drive() in attiny.c
+static inline void attiny_relay_coils_drive(uint8_t mask, uint8_t state)
+{
+    uint8_t coils = (uint8_t)((mask & MRC_CHANNEL_MASK) << PB3);
+    uint8_t port = PORTB & (uint8_t)~(COIL_PINS | COIL_RETURN);
+    if (ON == state) { port |= coils; }
+    else             { port |= COIL_RETURN | (COIL_PINS & (uint8_t)~coils); }
+    PORTB = port;
+}
+
+#    define MRC_switch_pins_get_state()   attiny_switch_pins_get_state()
+#    define MRC_relay_coils_drive(m, s)   attiny_relay_coils_drive((m), (s))
+#    define MRC_relay_coils_release()     do { PORTB &= (uint8_t)~(COIL_PINS | COIL_RETURN); } while(0)
+#    define MRC_leds_set(mask)            do { } while(0)
+#  else
+#    define MRC_led_pin_set_high()        do { PORTB |=  (1 << PB1); } while(0)
+#    define MRC_led_pin_set_low()         do { PORTB &= ~(1 << PB1); } while(0)
+#    define MRC_led_toggle()              do { PORTB ^=  (1 << PB1); } while(0)
+#    define MRC_mute_pin_set_high()       do { PORTB |=  (1 << PB4); } while(0)
+#    define MRC_mute_pin_set_low()        do { PORTB &= ~(1 << PB4); } while(0)
+#    define MRC_relay_coil_pin1_set_high() do { PORTB |=  (1 << PB3); } while(0)
+#    define MRC_relay_coil_pin1_set_low()  do { PORTB &= ~(1 << PB3); } while(0)
+#    define MRC_relay_coil_pin2_set_high() do { PORTB |=  (1 << PB2); } while(0)
+#    define MRC_relay_coil_pin2_set_low()  do { PORTB &= ~(1 << PB2); } while(0)
+#    define MRC_switch_pin_get_state()    (0 == (PINB & SWITCH_PINS) ? LOW : HIGH)
+#    define MRC_port_apply(set, clear)     do { PORTB = (uint8_t)((PORTB & (uint8_t)~(clear)) | (set)); } while(0)
+#  endif // MRC_N_CHANNELS
+#endif // MRC_INLINE_HAL
 
 #endif // ATTINY_H__
 
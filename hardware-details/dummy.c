@@ -10,22 +10,46 @@
  *    gcc -Wall -ggdb3 -Os mcu-relay-controller.c dummy.c
  */
 
-#include "dummy.h"
-
 #include "../mcu-relay-controller-iface.h"
 
+#include "dummy.h"
+
 void MRC_hardware_init(void) { }
-void MRC_disable_interrupts(void) { }
+void MRC_switch_wake_disarm(void) { }
 void MRC_disable_sleep(void) { }
-void MRC_enable_interrupts(void) { }
 void MRC_enter_sleep_mode(void) { }
+void MRC_sleep_lowpower_ms(uint16_t ms) { }
+void MRC_timer_start(void) { }
+void MRC_timer_stop(void) { }
+void MRC_enter_idle_mode(void) { }
+void MRC_set_clock_profile(uint8_t profile) { }
+uint16_t MRC_supply_millivolts(void) { return 5000; }
+uint8_t MRC_eeprom_read(uint16_t addr) { return 0xFF; }
+void MRC_eeprom_write_start(uint16_t addr, uint8_t value) { }
+void MRC_eeprom_wait(void) { }
+void MRC_power_fail_halt(void) { }
+void MRC_relay_hold_start(void) { }
+void MRC_relay_hold_stop(void) { }
+void MRC_led_dim_start(void) { }
+void MRC_led_dim_stop(void) { }
+uint8_t MRC_midi_get(uint8_t* byte) { return FALSE; }
+#ifndef MRC_INLINE_HAL // otherwise macros in dummy.h
 void MRC_led_pin_set_high(void) { }
 void MRC_led_pin_set_low(void) { }
 void MRC_led_toggle(void) { }
+void MRC_mute_pin_set_high(void) { }
+void MRC_mute_pin_set_low(void) { }
 void MRC_relay_coil_pin1_set_high(void) { }
 void MRC_relay_coil_pin1_set_low(void) { }
 void MRC_relay_coil_pin2_set_high(void) { }
 void MRC_relay_coil_pin2_set_low(void) { }
+void MRC_port_apply(uint8_t set, uint8_t clear) { }
 uint8_t MRC_switch_pin_get_state(void) { return HIGH; }
 void MRC_switch_pin_clear_int_flags(void) { }
+uint8_t MRC_switch_pins_get_state(void) { return 0xFF; }
+void MRC_relay_coils_drive(uint8_t mask, uint8_t state) { }
+void MRC_relay_coils_release(void) { }
+void MRC_leds_set(uint8_t mask) { }
+#endif // MRC_INLINE_HAL
+uint8_t MRC_switch_press_pending(void) { return FALSE; }
 
@@ -5,6 +5,33 @@
 #ifndef DUMMY_H__
 #define DUMMY_H__
 
+#define MRC_EEPROM_SIZE 64
+
 #define MRC_sleep_millisecs(n) do { } while(0)
+#define MRC_sleep_microsecs(n) do { } while(0)
+
+#define MRC_PORT_LED   (1 << 0)
+#define MRC_PORT_MUTE  (1 << 1)
+#define MRC_PORT_COIL1 (1 << 2)
+#define MRC_PORT_COIL2 (1 << 3)
+
+#ifdef MRC_INLINE_HAL
+#  define MRC_led_pin_set_high()         do { } while(0)
+#  define MRC_led_pin_set_low()          do { } while(0)
+#  define MRC_led_toggle()               do { } while(0)
+#  define MRC_mute_pin_set_high()        do { } while(0)
+#  define MRC_mute_pin_set_low()         do { } while(0)
+#  define MRC_relay_coil_pin1_set_high() do { } while(0)
+#  define MRC_relay_coil_pin1_set_low()  do { } while(0)
+#  define MRC_relay_coil_pin2_set_high() do { } while(0)
+#  define MRC_relay_coil_pin2_set_low()  do { } while(0)
+#  define MRC_port_apply(set, clear)     do { } while(0)
+#  define MRC_switch_pin_get_state()     HIGH
+#  define MRC_switch_pin_clear_int_flags() do { } while(0)
+#  define MRC_switch_pins_get_state()    0xFF
+#  define MRC_relay_coils_drive(m, s)    do { } while(0)
+#  define MRC_relay_coils_release()      do { } while(0)
+#  define MRC_leds_set(mask)             do { } while(0)
+#endif // MRC_INLINE_HAL
 
 #endif // DUMMY_H__
@@ -0,0 +1,876 @@
+// Copyright (c) Matthew Garman.  All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for
+// license information.
+
+
+/*
+ * host simulation implementation - runs the unmodified core on a PC against
+ * a virtual microsecond clock, so that firmware timing can be measured
+ * rather than guessed
+ *   - MRC_sleep_millisecs() advances the virtual clock instead of spinning
+ *   - MRC_switch_pin_get_state() replays a scripted waveform (bounce and all)
+ *   - every transition of the LED, mute and relay coil pins is logged with
+ *     its virtual timestamp, as is the movement of the relay contacts they
+ *     cause (see sim_relay_*)
+ *   - MRC_enter_sleep_mode() skips ahead to the next scripted switch edge,
+ *     i.e. the pin-change "interrupt" that wakes the mcu, or returns at once
+ *     for one recorded since MRC_switch_pin_clear_int_flags()
+ *   - with MRC_N_CHANNELS > 1, each channel has its own switch script and
+ *     logs its own LED and coil pins (see sim_event_t.channel)
+ *   - the data EEPROM keeps its contents (and wear counts) across
+ *     sim_reset(), i.e. power cycles; a write takes SIM_EEPROM_WRITE_US, and
+ *     one cut short by the power going away leaves a torn cell behind
+ *   - with USE_POWER_FAIL, a scripted fall of the power-good pin (see
+ *     sim_power_fail_at()) interrupts the core wherever it is, once
+ *     MRC_hardware_init() has armed it, and unless a HAL call has
+ *     interrupts masked (as MRC_eeprom_wait() does outside its sleep)
+ *   - with USE_NON_LATCHING, the relay model is a monostable one, and the
+ *     mcu idles rather than powers down while the hold PWM runs
+ *   - with USE_LED_DIM, the dimmed LED is logged (SIM_LED_DIM), but the mcu
+ *     still powers down: how each target waits meanwhile, and what that
+ *     costs, is up to the energy model (sim/energy.c)
+ *   - with USE_MIDI, scripted bytes on the MIDI input (see
+ *     sim_midi_add_byte()) are received as by the ATtiny85's USI: the
+ *     start bit wakes the mcu, which idles until the byte is in the buffer
+ *     (the receiver's interrupts take no cpu time here)
+ * interrupt semantics follow the ATtiny reference implementation: a switch
+ * edge while awake sets a pin-change flag (PCIF, or the interrupt service
+ * routine's own), which stays set until the core clears it
+ *
+ * the core's main() must be compiled as firmware_main(), see the Makefile
+ */
+
+#include "hostsim.h"
+
+#include "../mcu-relay-controller-iface.h"
+
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// ATtiny85 wake-up from power-down is 6 clocks at 1MHz, plus the interrupt
+// response and (empty) ISR; round up
+#define SIM_WAKE_LATENCY_US 10
+
+// an AVR ISR that calls into another translation unit saves and restores all
+// call-clobbered registers: roughly 80 cycles at 1MHz, including the work
+#define SIM_ISR_US 80
+
+// ATtiny PCINT0 service routine up to the port write in power_fail(): the
+// register saves of an ISR that calls into another translation unit, the
+// pin test, and the call, at 1MHz
+#define SIM_POWER_FAIL_ISR_US 50
+
+// ATtiny CLOCK_PROFILE_LOW: 1MHz => 125kHz
+#define SIM_CLOCK_LOW_DIV 8
+
+// Panasonic TQ2-L-5V: 3ms operate time, including bounce
+#define SIM_RELAY_OPERATE_MIN_US 1000
+#define SIM_RELAY_OPERATE_MAX_US 2000
+#define SIM_RELAY_TRANSFER_US     500
+#define SIM_RELAY_BOUNCE_US       500
+
+// a healthy 5V rail
+#define SIM_VCC_MV 5000
+
+// MRC_sleep_lowpower_ms(), as on the ATtiny: whole watchdog periods in
+// power-down, the rest in idle mode
+#define SIM_WDT_PERIOD_US 16000
+
+// ATtiny85 atomic erase and write (t_WD_EEPROM)
+#define SIM_EEPROM_WRITE_US 3400
+
+// MIDI byte, from its start bit to the USI overflow interrupt having put
+// it in the buffer: the middle of bit 7 (8.5 bits of 32us), and the
+// interrupt at 1MHz; the buffer holds as many bytes as the ATtiny85's
+#define SIM_MIDI_RX_US   290
+#define SIM_MIDI_RX_SIZE 15
+
+SIM_THREAD_LOCAL uint64_t sim_now_us;
+SIM_THREAD_LOCAL uint64_t sim_awake_us;
+SIM_THREAD_LOCAL uint64_t sim_active_us;
+SIM_THREAD_LOCAL uint64_t sim_sleep_us;
+SIM_THREAD_LOCAL uint32_t sim_wake_latency_us = SIM_WAKE_LATENCY_US;
+SIM_THREAD_LOCAL uint32_t sim_isr_us = SIM_ISR_US;
+SIM_THREAD_LOCAL uint32_t sim_power_fail_isr_us = SIM_POWER_FAIL_ISR_US;
+SIM_THREAD_LOCAL uint32_t sim_clock_low_div = SIM_CLOCK_LOW_DIV;
+SIM_THREAD_LOCAL uint16_t sim_vcc_mv = SIM_VCC_MV;
+SIM_THREAD_LOCAL uint32_t sim_startup_delay_us;
+SIM_THREAD_LOCAL uint32_t sim_relay_operate_min_us = SIM_RELAY_OPERATE_MIN_US;
+SIM_THREAD_LOCAL uint32_t sim_relay_operate_max_us = SIM_RELAY_OPERATE_MAX_US;
+SIM_THREAD_LOCAL uint32_t sim_relay_transfer_us = SIM_RELAY_TRANSFER_US;
+SIM_THREAD_LOCAL uint32_t sim_relay_bounce_us = SIM_RELAY_BOUNCE_US;
+SIM_THREAD_LOCAL uint64_t sim_hal_calls;
+SIM_THREAD_LOCAL uint64_t sim_pin_calls;
+SIM_THREAD_LOCAL void (*sim_hal_call_hook)(void);
+SIM_THREAD_LOCAL void (*sim_press_pending_hook)(void);
+SIM_THREAD_LOCAL uint8_t sim_eeprom[MRC_EEPROM_SIZE];
+SIM_THREAD_LOCAL uint32_t sim_eeprom_writes[MRC_EEPROM_SIZE];
+
+static SIM_THREAD_LOCAL sim_event_t* switch_script;
+static SIM_THREAD_LOCAL size_t n_switch_script;
+static SIM_THREAD_LOCAL size_t cap_switch_script;
+static SIM_THREAD_LOCAL size_t switch_pos; // first scripted edge not yet reached
+
+static SIM_THREAD_LOCAL sim_event_t* event_log;
+static SIM_THREAD_LOCAL size_t n_event_log;
+static SIM_THREAD_LOCAL size_t cap_event_log;
+
+static SIM_THREAD_LOCAL uint8_t pin_level[SIM_N_SIGNALS];
+static SIM_THREAD_LOCAL uint8_t irq_enabled;
+
+// a switch edge (any channel) since MRC_switch_pin_clear_int_flags()
+static SIM_THREAD_LOCAL uint8_t switch_edge;
+
+// switch, LED and coil pins of channels other than 0 (whose pins are the
+// ones in pin_level), and every channel's switch as one mask
+static SIM_THREAD_LOCAL uint8_t channel_level[SIM_MAX_CHANNELS][SIM_COIL2 + 1];
+static SIM_THREAD_LOCAL uint8_t switch_bits;
+
+// contact movement of the pulse in progress: break, make, end of bounce
+static SIM_THREAD_LOCAL sim_event_t contact_events[3];
+static SIM_THREAD_LOCAL uint8_t n_contact_events;
+static SIM_THREAD_LOCAL uint8_t contact_pos; // first event not yet reached
+static SIM_THREAD_LOCAL uint32_t relay_rng;
+
+// the EEPROM write in progress, if eeprom_busy
+static SIM_THREAD_LOCAL uint8_t eeprom_busy;
+static SIM_THREAD_LOCAL uint16_t eeprom_addr;
+static SIM_THREAD_LOCAL uint8_t eeprom_value;
+static SIM_THREAD_LOCAL uint64_t eeprom_start_us;
+static SIM_THREAD_LOCAL uint64_t eeprom_done_us;
+
+static SIM_THREAD_LOCAL uint8_t timer_on;
+static SIM_THREAD_LOCAL uint64_t timer_next_us;
+
+// interrupt service routines do not nest: one that falls due in another
+// waits for it to return
+static SIM_THREAD_LOCAL uint8_t in_isr;
+
+// scripted fall of the power-good pin, and whether its interrupt is armed,
+// and not masked (the global interrupt enable, as the ATtiny HAL leaves it)
+static SIM_THREAD_LOCAL uint64_t power_fail_us;
+static SIM_THREAD_LOCAL uint8_t power_fail_armed;
+static SIM_THREAD_LOCAL uint8_t irq_global;
+
+// MIDI input: the scripted bytes (level: the byte), the first one not yet
+// in the buffer, and the buffer
+static SIM_THREAD_LOCAL sim_event_t* midi_script;
+static SIM_THREAD_LOCAL size_t n_midi_script;
+static SIM_THREAD_LOCAL size_t cap_midi_script;
+static SIM_THREAD_LOCAL size_t midi_pos;
+static SIM_THREAD_LOCAL uint8_t midi_rx[SIM_MIDI_RX_SIZE];
+static SIM_THREAD_LOCAL uint8_t midi_rx_head;
+static SIM_THREAD_LOCAL uint8_t midi_rx_n;
+static SIM_THREAD_LOCAL uint8_t midi_rx_lost;
+
+static SIM_THREAD_LOCAL uint64_t run_until_us;
+static SIM_THREAD_LOCAL jmp_buf run_exit;
+
+
+static void append(sim_event_t** v, size_t* n, size_t* cap, sim_event_t e)
+{
+    if (*n == *cap)
+    {
+        *cap = *cap ? 2 * *cap : 1024;
+        *v = realloc(*v, *cap * sizeof(**v));
+        if (!*v) { perror("realloc"); exit(1); }
+    }
+    (*v)[(*n)++] = e;
+}
+
+static void set_pin(uint8_t signal, uint8_t level)
+{
+    if (pin_level[signal] == level) { return; }
+    pin_level[signal] = level;
+    append(&event_log, &n_event_log, &cap_event_log,
+           (sim_event_t){ sim_now_us, signal, level });
+}
+
+static uint32_t relay_rand_range(uint32_t lo, uint32_t hi)
+{
+    relay_rng ^= relay_rng << 13;
+    relay_rng ^= relay_rng >> 17;
+    relay_rng ^= relay_rng << 5;
+    return lo + relay_rng % (hi - lo + 1);
+}
+
+// log the contact movement up to t_us (which may be ahead of sim_now_us)
+static void sync_contacts(uint64_t t_us)
+{
+    while (contact_pos < n_contact_events &&
+           contact_events[contact_pos].t_us <= t_us)
+    {
+        sim_event_t e = contact_events[contact_pos++];
+        pin_level[e.signal] = e.level;
+        append(&event_log, &n_event_log, &cap_event_log, e);
+    }
+}
+
+// set the contacts in motion towards position, unless they are there
+// already
+static void relay_move(uint8_t position)
+{
+    if (pin_level[SIM_RELAY] == position && contact_pos == n_contact_events)
+    {
+        return;
+    }
+
+    uint64_t t_us = sim_now_us + relay_rand_range(sim_relay_operate_min_us,
+                                                  sim_relay_operate_max_us);
+    contact_events[0] = (sim_event_t){ t_us, SIM_CONTACTS_MOVING, HIGH };
+    t_us += sim_relay_transfer_us;
+    contact_events[1] = (sim_event_t){ t_us, SIM_RELAY, position };
+    t_us += relay_rand_range(0, sim_relay_bounce_us);
+    contact_events[2] = (sim_event_t){ t_us, SIM_CONTACTS_MOVING, LOW };
+    n_contact_events = 3;
+    contact_pos = 0;
+}
+
+#ifdef USE_NON_LATCHING
+// a coil pin or the hold changed (coil pin2 is not connected): the relay
+// is energized by either; when the hold takes over from coil pin1, or both
+// let go, before the contacts have started to move, they stay where they
+// are
+static void relay_coil(uint8_t signal, uint8_t level, uint8_t position)
+{
+    if (pin_level[signal] == level) { return; }
+    set_pin(signal, level);
+    if (SIM_COIL2 == signal) { return; }
+
+    uint8_t energized = pin_level[SIM_COIL1] || pin_level[SIM_COIL_HOLD];
+    if (SIM_COIL1 == signal && level)
+    {
+        relay_move(ON);
+    }
+    else if (0 == contact_pos && n_contact_events)
+    {
+        if (SIM_COIL_HOLD == signal || !energized) { n_contact_events = 0; }
+    }
+    else if (!energized)
+    {
+        relay_move(OFF);
+    }
+}
+#else
+// a coil pin changed: energizing a coil sets the contacts in motion towards
+// position, unless they are there already; de-energizing it before they
+// have started to move leaves them where they are
+static void relay_coil(uint8_t signal, uint8_t level, uint8_t position)
+{
+    if (pin_level[signal] == level) { return; }
+    set_pin(signal, level);
+
+    if (!level)
+    {
+        if (0 == contact_pos) { n_contact_events = 0; }
+        return;
+    }
+    relay_move(position);
+}
+#endif // USE_NON_LATCHING
+
+// a switch, LED or coil pin of channel ch changed
+static void set_channel_pin(uint8_t ch, uint8_t signal, uint8_t level)
+{
+    if (0 == ch)
+    {
+        if (SIM_COIL1 == signal)      { relay_coil(signal, level, ON);  }
+        else if (SIM_COIL2 == signal) { relay_coil(signal, level, OFF); }
+        else                          { set_pin(signal, level); }
+        return;
+    }
+    if (channel_level[ch][signal] == level) { return; }
+    channel_level[ch][signal] = level;
+    append(&event_log, &n_event_log, &cap_event_log,
+           (sim_event_t){ sim_now_us, signal, level, ch });
+}
+
+// bring the switch pins up to date with the virtual clock
+static void sync_switch(void)
+{
+    while (switch_pos < n_switch_script &&
+           switch_script[switch_pos].t_us <= sim_now_us)
+    {
+        sim_event_t e = switch_script[switch_pos++];
+        set_channel_pin(e.channel, SIM_SWITCH, e.level);
+        switch_edge = TRUE;
+        if (e.level) { switch_bits |= (uint8_t)(1U << e.channel); }
+        else         { switch_bits &= (uint8_t)~(1U << e.channel); }
+    }
+}
+
+// complete the EEPROM write in progress if it is done by t_us
+static void sync_eeprom(uint64_t t_us)
+{
+    if (!eeprom_busy || eeprom_done_us > t_us) { return; }
+    eeprom_busy = FALSE;
+    sim_eeprom[eeprom_addr] = eeprom_value;
+    append(&event_log, &n_event_log, &cap_event_log,
+           (sim_event_t){ eeprom_done_us, SIM_EEPROM_BUSY, LOW });
+    pin_level[SIM_EEPROM_BUSY] = LOW;
+}
+
+static void midi_rx_push(uint8_t byte)
+{
+    midi_rx[(midi_rx_head + midi_rx_n++) % SIM_MIDI_RX_SIZE] = byte;
+}
+
+// put the bytes received by t_us in the buffer; with it full, they are
+// lost, and MIDI_RX_LOST goes in ahead of the next one there is room for
+static void sync_midi(uint64_t t_us)
+{
+    while (midi_pos < n_midi_script &&
+           midi_script[midi_pos].t_us + SIM_MIDI_RX_US <= t_us)
+    {
+        uint8_t byte = midi_script[midi_pos++].level;
+        if (midi_rx_lost && midi_rx_n < SIM_MIDI_RX_SIZE)
+        {
+            midi_rx_push(MIDI_RX_LOST);
+            midi_rx_lost = FALSE;
+        }
+        if (midi_rx_n < SIM_MIDI_RX_SIZE) { midi_rx_push(byte); }
+        else                              { midi_rx_lost = TRUE; }
+    }
+}
+
+static void stop_run(void)
+{
+    sync_switch();
+    longjmp(run_exit, 1);
+}
+
+// every MRC_* call starts here, before it does anything
+static void hal_call(void)
+{
+    ++sim_hal_calls;
+    if (sim_hal_call_hook) { sim_hal_call_hook(); }
+}
+
+// move the virtual clock forward to t_us, attributing the elapsed time to
+// the current power state; ends the run at run_until_us
+static void advance_clock(uint64_t t_us)
+{
+    uint8_t stop = (t_us >= run_until_us);
+    if (stop) { t_us = run_until_us; }
+
+    uint64_t dt = t_us - sim_now_us;
+    if (pin_level[SIM_AWAKE]) { sim_awake_us += dt; }
+    else                      { sim_sleep_us += dt; }
+    if (pin_level[SIM_CPU])   { sim_active_us += dt; }
+    sync_contacts(t_us);
+    sync_eeprom(t_us);
+    sync_midi(t_us);
+    sim_now_us = t_us;
+    sync_switch();
+
+    if (stop) { stop_run(); }
+}
+
+// duration of something that takes us at the normal clock
+static uint32_t cycles_us(uint32_t us)
+{
+    return pin_level[SIM_CLOCK_LOW] ? us * sim_clock_low_div : us;
+}
+
+static uint8_t timer_pending(uint64_t t_us)
+{
+    return timer_on && irq_enabled && !in_isr && timer_next_us <= t_us;
+}
+
+// the power-fail interrupt, taken now: wakes the mcu if it is asleep, and
+// enters power_fail(), which ends the run in MRC_power_fail_halt()
+static void power_fail_isr(void)
+{
+    in_isr = TRUE;
+    if (!pin_level[SIM_AWAKE])
+    {
+        advance_clock(sim_now_us + cycles_us(sim_wake_latency_us));
+        set_pin(SIM_AWAKE, HIGH);
+    }
+    set_pin(SIM_CPU, HIGH);
+    advance_clock(sim_now_us + cycles_us(sim_power_fail_isr_us));
+#ifdef USE_POWER_FAIL
+    power_fail();
+#endif // USE_POWER_FAIL
+    stop_run();
+}
+
+// advance_clock(), but the power-good pin falls on the way, if scripted,
+// and its interrupt preempts the rest once it is armed, and not within
+// another interrupt
+static void advance_to(uint64_t t_us)
+{
+    if (pin_level[SIM_POWER_GOOD] && power_fail_us <= t_us)
+    {
+        advance_clock(power_fail_us > sim_now_us ? power_fail_us : sim_now_us);
+        set_pin(SIM_POWER_GOOD, LOW);
+    }
+    if (!pin_level[SIM_POWER_GOOD] && power_fail_armed && irq_global && !in_isr)
+    {
+        power_fail_isr();
+    }
+    advance_clock(t_us);
+}
+
+// service the timer interrupt that is due now
+static void timer_isr(void)
+{
+    uint8_t cpu = pin_level[SIM_CPU];
+
+    timer_next_us += (uint64_t)TIMER_TICK_MS * 1000;
+    set_pin(SIM_CPU, HIGH);
+    in_isr = TRUE;
+#ifdef USE_TIMER_TICK
+    timer_tick();
+#endif // USE_TIMER_TICK
+    advance_to(sim_now_us + cycles_us(sim_isr_us));
+    in_isr = FALSE;
+    set_pin(SIM_CPU, cpu);
+}
+
+void sim_reset(void)
+{
+    // a write cut short: the first half of the time erases the cell (to
+    // 0xFF), the second programs it, clearing some of the bits that should
+    // be clear
+    if (eeprom_busy)
+    {
+        eeprom_busy = FALSE;
+        uint8_t torn = 0xFF;
+        if (sim_now_us - eeprom_start_us >= SIM_EEPROM_WRITE_US / 2)
+        {
+            torn = eeprom_value | (uint8_t)relay_rand_range(0, 0xFF);
+        }
+        sim_eeprom[eeprom_addr] = torn;
+    }
+
+
+    n_switch_script = 0;
+    switch_pos = 0;
+    n_event_log = 0;
+    sim_now_us = 0;
+    sim_awake_us = 0;
+    sim_active_us = 0;
+    sim_sleep_us = 0;
+    sim_hal_calls = 0;
+    sim_pin_calls = 0;
+    irq_enabled = FALSE;
+    switch_edge = FALSE;
+    timer_on = FALSE;
+    in_isr = FALSE;
+    power_fail_us = UINT64_MAX;
+    power_fail_armed = FALSE;
+    irq_global = TRUE;
+    n_midi_script = 0;
+    midi_pos = 0;
+    midi_rx_head = 0;
+    midi_rx_n = 0;
+    midi_rx_lost = FALSE;
+    n_contact_events = 0;
+    contact_pos = 0;
+    relay_rng = 1;
+    for (uint8_t i=0; i<SIM_N_SIGNALS; ++i) { pin_level[i] = LOW; }
+    pin_level[SIM_SWITCH] = HIGH; // pulled up
+    pin_level[SIM_POWER_GOOD] = HIGH;
+    for (uint8_t ch=0; ch<SIM_MAX_CHANNELS; ++ch)
+    {
+        for (uint8_t i=0; i<=SIM_COIL2; ++i) { channel_level[ch][i] = LOW; }
+        channel_level[ch][SIM_SWITCH] = HIGH;
+    }
+    switch_bits = 0xFF;
+}
+
+void sim_switch_add_edge(uint64_t t_us, uint8_t level)
+{
+    sim_channel_switch_add_edge(0, t_us, level);
+}
+
+void sim_channel_switch_add_edge(uint8_t channel, uint64_t t_us, uint8_t level)
+{
+    append(&switch_script, &n_switch_script, &cap_switch_script,
+           (sim_event_t){ t_us, SIM_SWITCH, level, channel });
+}
+
+void sim_switch_insert_edge(uint64_t t_us, uint8_t level)
+{
+    append(&switch_script, &n_switch_script, &cap_switch_script,
+           (sim_event_t){ t_us, SIM_SWITCH, level, 0 });
+    size_t i = n_switch_script - 1;
+    for (; i > switch_pos && switch_script[i - 1].t_us > t_us; --i)
+    {
+        switch_script[i] = switch_script[i - 1];
+    }
+    switch_script[i] = (sim_event_t){ t_us, SIM_SWITCH, level, 0 };
+    sync_switch();
+}
+
+void sim_midi_add_byte(uint64_t t_us, uint8_t byte)
+{
+    append(&midi_script, &n_midi_script, &cap_midi_script,
+           (sim_event_t){ t_us, 0, byte });
+}
+
+static void run_firmware(void)
+{
+    firmware_main(0, NULL);
+}
+
+void sim_power_fail_at(uint64_t t_us)
+{
+    power_fail_us = t_us;
+}
+
+uint64_t sim_run(uint64_t until_us)
+{
+    return sim_call(until_us, run_firmware);
+}
+
+uint64_t sim_call(uint64_t until_us, void (*fn)(void))
+{
+    run_until_us = until_us;
+    if (0 == setjmp(run_exit))
+    {
+        set_pin(SIM_AWAKE, HIGH);
+        set_pin(SIM_CPU, HIGH);
+        fn();
+    }
+    return sim_now_us;
+}
+
+void sim_eeprom_erase(void)
+{
+    for (uint16_t i=0; i<MRC_EEPROM_SIZE; ++i)
+    {
+        sim_eeprom[i] = 0xFF;
+        sim_eeprom_writes[i] = 0;
+    }
+    eeprom_busy = FALSE;
+}
+
+const sim_event_t* sim_log(size_t* n)
+{
+    *n = n_event_log;
+    return event_log;
+}
+
+// a busy-wait: interrupts that fall due in the meantime preempt it, and
+// stretch it by the time they take
+void sim_advance_us(uint32_t us)
+{
+    uint64_t end_us = sim_now_us + us;
+    while (timer_pending(end_us))
+    {
+        advance_to(timer_next_us);
+        uint64_t before_us = sim_now_us;
+        timer_isr();
+        end_us += sim_now_us - before_us;
+    }
+    advance_to(end_us);
+}
+
+void sim_power_state(uint8_t state, uint8_t active)
+{
+    set_pin(SIM_POWER_STATE + state, active ? HIGH : LOW);
+}
+
+
+/*
+ * the hardware interface
+ */
+
+void MRC_hardware_init(void)
+{
+    hal_call();
+    sim_advance_us(sim_startup_delay_us);
+#ifdef USE_POWER_FAIL
+    power_fail_armed = TRUE;
+    advance_to(sim_now_us); // the pin may be low already
+#endif // USE_POWER_FAIL
+}
+void MRC_switch_wake_disarm(void) { hal_call(); irq_enabled = FALSE; }
+void MRC_disable_sleep(void) { hal_call(); }
+
+// power-down, or idle mode while the relay hold PWM needs the clock
+// (USE_NON_LATCHING, as on the ATtiny85)
+static void sleep_deepest(void)
+{
+    set_pin(SIM_CPU, LOW);
+    if (!pin_level[SIM_COIL_HOLD]) { set_pin(SIM_AWAKE, LOW); }
+}
+
+// power-down: only a pin change wakes the mcu, timers are stopped; the
+// switch is armed as the mcu goes to sleep, and an edge recorded already
+// keeps it awake; so does a MIDI byte in the buffer, and one on its way
+// keeps the mcu in idle mode until it is in (USE_MIDI)
+void MRC_enter_sleep_mode(void)
+{
+    hal_call();
+    advance_to(sim_now_us); // an interrupt pending is taken first
+    if (switch_edge || midi_rx_n) { return; }
+
+    uint64_t edge_us = UINT64_MAX;
+    if (switch_pos < n_switch_script) { edge_us = switch_script[switch_pos].t_us; }
+    if (power_fail_armed && power_fail_us < edge_us) { edge_us = power_fail_us; }
+
+    if (midi_pos < n_midi_script && midi_script[midi_pos].t_us < edge_us)
+    {
+        uint64_t start_us = midi_script[midi_pos].t_us;
+        if (start_us > sim_now_us)
+        {
+            sleep_deepest();
+            advance_to(start_us + cycles_us(sim_wake_latency_us));
+            set_pin(SIM_AWAKE, HIGH);
+        }
+        set_pin(SIM_CPU, LOW);
+        uint64_t in_us = start_us + SIM_MIDI_RX_US;
+        advance_to(in_us < edge_us ? in_us : edge_us);
+        set_pin(SIM_CPU, HIGH);
+        return;
+    }
+
+    // no wake source: on real hardware this sleeps forever
+    if (UINT64_MAX == edge_us) { stop_run(); }
+
+    sleep_deepest();
+    advance_to(edge_us + cycles_us(sim_wake_latency_us));
+    set_pin(SIM_AWAKE, HIGH);
+    set_pin(SIM_CPU, HIGH);
+}
+
+// the watchdog runs freely: the time spent waking up after each period does
+// not add up; pin changes do not end the wait
+void MRC_sleep_lowpower_ms(uint16_t ms)
+{
+    hal_call();
+    uint64_t start_us = sim_now_us;
+
+    for (uint16_t i=1; i<=ms/(SIM_WDT_PERIOD_US/1000); ++i)
+    {
+        sleep_deepest();
+        advance_to(start_us + (uint64_t)i * SIM_WDT_PERIOD_US);
+        set_pin(SIM_AWAKE, HIGH);
+        set_pin(SIM_CPU, HIGH);
+        advance_to(sim_now_us + cycles_us(sim_wake_latency_us));
+    }
+
+    uint64_t end_us = start_us + (uint64_t)ms * 1000;
+    if (end_us > sim_now_us)
+    {
+        set_pin(SIM_CPU, LOW);
+        advance_to(end_us);
+        set_pin(SIM_CPU, HIGH);
+        advance_to(sim_now_us + cycles_us(sim_isr_us));
+    }
+}
+
+void MRC_timer_start(void)
+{
+    hal_call();
+    timer_on = TRUE;
+    timer_next_us = sim_now_us + (uint64_t)TIMER_TICK_MS * 1000;
+    irq_enabled = TRUE;
+}
+
+void MRC_timer_stop(void) { hal_call(); timer_on = FALSE; }
+
+// idle: the timer keeps running, and any enabled interrupt wakes the cpu
+void MRC_enter_idle_mode(void)
+{
+    hal_call();
+    advance_to(sim_now_us); // an interrupt pending is taken first
+
+    uint64_t wake_us = UINT64_MAX;
+    if (irq_enabled)
+    {
+        if (switch_pos < n_switch_script) { wake_us = switch_script[switch_pos].t_us; }
+        if (timer_on && timer_next_us < wake_us) { wake_us = timer_next_us; }
+    }
+    if (power_fail_armed && power_fail_us < wake_us) { wake_us = power_fail_us; }
+    if (UINT64_MAX == wake_us) { stop_run(); }
+
+    set_pin(SIM_CPU, LOW);
+    advance_to(wake_us);
+    if (timer_pending(sim_now_us)) { timer_isr(); }
+    set_pin(SIM_CPU, HIGH);
+}
+
+// delays and timer ticks keep their length in either profile
+void MRC_set_clock_profile(uint8_t profile)
+{
+    hal_call();
+    set_pin(SIM_CLOCK_LOW, CLOCK_PROFILE_LOW == profile);
+}
+
+uint16_t MRC_supply_millivolts(void) { hal_call(); return sim_vcc_mv; }
+
+// the hold shows as SIM_COIL_HOLD, in place of coil pin1
+void MRC_relay_hold_start(void)
+{
+    hal_call();
+    relay_coil(SIM_COIL_HOLD, HIGH, ON);
+    relay_coil(SIM_COIL1, LOW, ON);
+}
+
+void MRC_relay_hold_stop(void)
+{
+    hal_call();
+    relay_coil(SIM_COIL_HOLD, LOW, ON);
+}
+
+void MRC_led_dim_start(void) { hal_call(); set_pin(SIM_LED_DIM, HIGH); }
+void MRC_led_dim_stop(void)  { hal_call(); set_pin(SIM_LED_DIM, LOW);  }
+
+// the supply does not come back in the simulation: the run ends here
+void MRC_power_fail_halt(void) { hal_call(); stop_run(); }
+
+// reads and new writes wait (busy) for a write in progress
+static void eeprom_wait_busy(void)
+{
+    if (eeprom_busy) { sim_advance_us((uint32_t)(eeprom_done_us - sim_now_us)); }
+}
+
+uint8_t MRC_eeprom_read(uint16_t addr)
+{
+    hal_call();
+    eeprom_wait_busy();
+    return sim_eeprom[addr];
+}
+
+void MRC_eeprom_write_start(uint16_t addr, uint8_t value)
+{
+    hal_call();
+    eeprom_wait_busy();
+    eeprom_busy = TRUE;
+    eeprom_addr = addr;
+    eeprom_value = value;
+    eeprom_start_us = sim_now_us;
+    eeprom_done_us = sim_now_us + SIM_EEPROM_WRITE_US;
+    ++sim_eeprom_writes[addr];
+    set_pin(SIM_EEPROM_BUSY, HIGH);
+}
+
+// idle until the EEPROM-ready interrupt; as on the ATtiny, interrupts are
+// masked but for the sleep, and left as they were on the way out (a
+// power-fail held off meanwhile is taken then)
+void MRC_eeprom_wait(void)
+{
+    hal_call();
+    uint8_t global = irq_global;
+    irq_global = FALSE;
+    if (eeprom_busy)
+    {
+        set_pin(SIM_CPU, LOW);
+        irq_global = TRUE;
+        advance_to(eeprom_done_us);
+        irq_global = FALSE;
+        set_pin(SIM_CPU, HIGH);
+    }
+    irq_global = global;
+    advance_to(sim_now_us);
+}
+
+void MRC_led_pin_set_high(void) { hal_call(); ++sim_pin_calls; set_pin(SIM_LED, HIGH); }
+void MRC_led_pin_set_low(void)  { hal_call(); ++sim_pin_calls; set_pin(SIM_LED, LOW);  }
+void MRC_led_toggle(void)       { hal_call(); ++sim_pin_calls; set_pin(SIM_LED, !pin_level[SIM_LED]); }
+
+void MRC_mute_pin_set_high(void) { hal_call(); ++sim_pin_calls; set_pin(SIM_MUTE, HIGH); }
+void MRC_mute_pin_set_low(void)  { hal_call(); ++sim_pin_calls; set_pin(SIM_MUTE, LOW);  }
+
+void MRC_relay_coil_pin1_set_high(void) { hal_call(); ++sim_pin_calls; relay_coil(SIM_COIL1, HIGH, ON);  }
+void MRC_relay_coil_pin1_set_low(void)  { hal_call(); ++sim_pin_calls; relay_coil(SIM_COIL1, LOW,  ON);  }
+void MRC_relay_coil_pin2_set_high(void) { hal_call(); ++sim_pin_calls; relay_coil(SIM_COIL2, HIGH, OFF); }
+void MRC_relay_coil_pin2_set_low(void)  { hal_call(); ++sim_pin_calls; relay_coil(SIM_COIL2, LOW,  OFF); }
+
+void MRC_port_apply(uint8_t set, uint8_t clear)
+{
+    hal_call();
+    ++sim_pin_calls;
+    if (clear & MRC_PORT_LED)   { set_pin(SIM_LED, LOW);  }
+    if (clear & MRC_PORT_MUTE)  { set_pin(SIM_MUTE, LOW); }
+    if (clear & MRC_PORT_COIL1) { relay_coil(SIM_COIL1, LOW, ON);  }
+    if (clear & MRC_PORT_COIL2) { relay_coil(SIM_COIL2, LOW, OFF); }
+    if (set & MRC_PORT_LED)     { set_pin(SIM_LED, HIGH);  }
+    if (set & MRC_PORT_MUTE)    { set_pin(SIM_MUTE, HIGH); }
+    if (set & MRC_PORT_COIL1)   { relay_coil(SIM_COIL1, HIGH, ON);  }
+    if (set & MRC_PORT_COIL2)   { relay_coil(SIM_COIL2, HIGH, OFF); }
+}
+
+uint8_t MRC_switch_pin_get_state(void)
+{
+    hal_call();
+    ++sim_pin_calls;
+    sync_switch();
+    return pin_level[SIM_SWITCH];
+}
+
+void MRC_switch_pin_clear_int_flags(void)
+{
+    hal_call();
+    ++sim_pin_calls;
+    sync_switch();
+    switch_edge = FALSE;
+}
+
+uint8_t MRC_switch_press_pending(void)
+{
+    hal_call();
+    sync_switch();
+    if (!switch_edge) { return FALSE; }
+    switch_edge = FALSE;
+    if (HIGH == pin_level[SIM_SWITCH]) { return FALSE; }
+    if (sim_press_pending_hook) { sim_press_pending_hook(); }
+    return TRUE;
+}
+
+uint8_t MRC_midi_get(uint8_t* byte)
+{
+    hal_call();
+    if (!midi_rx_n) { return FALSE; }
+    *byte = midi_rx[midi_rx_head];
+    midi_rx_head = (midi_rx_head + 1) % SIM_MIDI_RX_SIZE;
+    --midi_rx_n;
+    return TRUE;
+}
+
+uint8_t MRC_switch_pins_get_state(void)
+{
+    hal_call();
+    ++sim_pin_calls;
+    sync_switch();
+    return switch_bits;
+}
+
+void MRC_relay_coils_drive(uint8_t mask, uint8_t state)
+{
+    hal_call();
+    ++sim_pin_calls;
+    for (uint8_t ch=0; ch<SIM_MAX_CHANNELS; ++ch)
+    {
+        if (mask & (1U << ch))
+        {
+            set_channel_pin(ch, ON == state ? SIM_COIL1 : SIM_COIL2, HIGH);
+        }
+    }
+}
+
+void MRC_relay_coils_release(void)
+{
+    hal_call();
+    ++sim_pin_calls;
+    for (uint8_t ch=0; ch<SIM_MAX_CHANNELS; ++ch)
+    {
+        set_channel_pin(ch, SIM_COIL1, LOW);
+        set_channel_pin(ch, SIM_COIL2, LOW);
+    }
+}
+
+void MRC_leds_set(uint8_t mask)
+{
+    hal_call();
+    ++sim_pin_calls;
+    for (uint8_t ch=0; ch<SIM_MAX_CHANNELS; ++ch)
+    {
+        set_channel_pin(ch, SIM_LED, (mask >> ch) & 1);
+    }
+}
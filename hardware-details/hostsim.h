@@ -0,0 +1,206 @@
+// Copyright (c) Matthew Garman.  All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for
+// license information.
+
+#ifndef HOSTSIM_H__
+#define HOSTSIM_H__
+
+#include "../mcu-relay-controller-iface.h"
+
+#include <stdint.h>
+#include <stddef.h>
+
+// an ATtiny85's worth of data EEPROM
+#define MRC_EEPROM_SIZE 512
+
+// every thread has a simulation of its own: a harness may run several at
+// once, provided the code they drive keeps its state on the stack (e.g.
+// debounce_switch(), see sim_call()); the core's globals are shared
+#define SIM_THREAD_LOCAL _Thread_local
+
+// delays advance the virtual clock rather than spinning
+#define MRC_sleep_millisecs(n) sim_advance_us((uint32_t)(n) * 1000UL);
+#define MRC_sleep_microsecs(n) sim_advance_us((uint32_t)(n));
+
+// the core's POWER_STATE_* marks are recorded in the event log
+#define MRC_power_state(state, active) sim_power_state((state), (active))
+
+// outputs for MRC_port_apply(); the pins it changes are logged at the same
+// virtual time
+#define MRC_PORT_LED   (1 << 0)
+#define MRC_PORT_MUTE  (1 << 1)
+#define MRC_PORT_COIL1 (1 << 2)
+#define MRC_PORT_COIL2 (1 << 3)
+
+
+/*
+ * harness-facing interface
+ *   - used by the programs under sim/ to script the switch, run the
+ *     (unmodified) core, and inspect what it did
+ */
+
+// signals recorded in the event log
+enum
+{
+    SIM_SWITCH = 0, // momentary switch pin (scripted input)
+    SIM_LED,        // status indicator LED pin
+    SIM_COIL1,      // relay coil pin1 (set/activate)
+    SIM_COIL2,      // relay coil pin2 (reset/deactivate)
+    SIM_AWAKE,      // 0 while in (power-down) sleep mode, 1 otherwise
+    SIM_CPU,        // 1 while the cpu executes code, 0 in idle or sleep mode
+    SIM_CLOCK_LOW,  // 1 while CLOCK_PROFILE_LOW is selected
+    SIM_MUTE,       // mute output pin
+    SIM_RELAY,      // relay contact position (modelled): ON once set
+    SIM_CONTACTS_MOVING, // 1 from contact break until the bounce is over
+    SIM_EEPROM_BUSY, // 1 while an EEPROM write is in progress
+    SIM_POWER_GOOD,  // power-good pin (USE_POWER_FAIL): 1 until
+                     // sim_power_fail_at()
+    SIM_COIL_HOLD,   // 1 while the relay coil is held by the PWM, at
+                     // RELAY_HOLD_PERCENT (USE_NON_LATCHING); coil pin1 is
+                     // then 0
+    SIM_LED_DIM,     // 1 while the LED is dimmed (USE_LED_DIM); the LED pin
+                     // stays 1
+    SIM_POWER_STATE,                   // first of POWER_N_STATES signals: 1
+                                       // while the core marks that state
+    SIM_N_SIGNALS = SIM_POWER_STATE + POWER_N_STATES
+};
+
+// channels modelled when MRC_N_CHANNELS > 1
+#define SIM_MAX_CHANNELS 8
+
+typedef struct
+{
+    uint64_t t_us;   // virtual time of the transition
+    uint8_t signal;  // one of SIM_*
+    uint8_t level;   // new level: LOW/HIGH
+    uint8_t channel; // channel of a SIM_SWITCH, SIM_LED or SIM_COIL*
+                     // transition (MRC_N_CHANNELS > 1); 0 otherwise
+} sim_event_t;
+
+// current virtual time in microseconds
+extern SIM_THREAD_LOCAL uint64_t sim_now_us;
+
+// total virtual time spent awake/asleep since sim_reset(); active time is
+// the part of the awake time in which the cpu was running (i.e. not in idle
+// mode)
+extern SIM_THREAD_LOCAL uint64_t sim_awake_us;
+extern SIM_THREAD_LOCAL uint64_t sim_active_us;
+extern SIM_THREAD_LOCAL uint64_t sim_sleep_us;
+
+// time from a pin change to the first instruction after
+// MRC_enter_sleep_mode() returns; defaults to SIM_WAKE_LATENCY_US
+extern SIM_THREAD_LOCAL uint32_t sim_wake_latency_us;
+
+// cpu time taken by each timer interrupt; defaults to SIM_ISR_US
+extern SIM_THREAD_LOCAL uint32_t sim_isr_us;
+
+// time from the power-fail interrupt being taken (or, asleep, from the end
+// of the wake-up) to the port write in power_fail() (USE_POWER_FAIL);
+// defaults to SIM_POWER_FAIL_ISR_US
+extern SIM_THREAD_LOCAL uint32_t sim_power_fail_isr_us;
+
+// clock division of CLOCK_PROFILE_LOW (cycle counts, i.e. the interrupt
+// time above, take this much longer); defaults to SIM_CLOCK_LOW_DIV
+extern SIM_THREAD_LOCAL uint32_t sim_clock_low_div;
+
+// relay contact model: the contacts start to move a random operate time
+// (uniform in [min, max]) after a coil is energized, provided it is still
+// energized then; they reach the other side transfer time later, and
+// bounce there for up to bounce time; defaults to SIM_RELAY_* (a
+// Panasonic TQ2-L-5V: at rest within 3ms).  a non-latching relay
+// (USE_NON_LATCHING) is pulled to ON by coil pin1, kept there by it or the
+// hold (which cannot start contacts moving, or keep them from it, if they
+// have not started when it takes over), and drops out to OFF, in the same
+// times, once neither drives the coil
+extern SIM_THREAD_LOCAL uint32_t sim_relay_operate_min_us;
+extern SIM_THREAD_LOCAL uint32_t sim_relay_operate_max_us;
+extern SIM_THREAD_LOCAL uint32_t sim_relay_transfer_us;
+extern SIM_THREAD_LOCAL uint32_t sim_relay_bounce_us;
+
+// supply voltage returned by MRC_supply_millivolts(); defaults to
+// SIM_VCC_MV
+extern SIM_THREAD_LOCAL uint16_t sim_vcc_mv;
+
+// software start-up delay in MRC_hardware_init() (a target's
+// STARTUP_DELAY_MS); defaults to 0
+extern SIM_THREAD_LOCAL uint32_t sim_startup_delay_us;
+
+// number of MRC_* hardware calls made by the core since sim_reset(), and how
+// many of them were pin operations (the calls MRC_INLINE_HAL inlines on the
+// real targets)
+extern SIM_THREAD_LOCAL uint64_t sim_hal_calls;
+extern SIM_THREAD_LOCAL uint64_t sim_pin_calls;
+
+// if set, called at the start of every MRC_* hardware call, once
+// sim_hal_calls counts it, before the call does anything: a harness can
+// script a switch edge there (sim_switch_insert_edge()), i.e. between any
+// two calls of the core, even ones at the same virtual time; not cleared by
+// sim_reset()
+extern SIM_THREAD_LOCAL void (*sim_hal_call_hook)(void);
+
+// if set, called when MRC_switch_press_pending() finds a press, i.e. the
+// core goes round its main loop again without sleeping; not cleared by
+// sim_reset()
+extern SIM_THREAD_LOCAL void (*sim_press_pending_hook)(void);
+
+// data EEPROM contents, and the number of writes each cell has taken (its
+// wear); neither is cleared by sim_reset(), see sim_eeprom_erase()
+extern SIM_THREAD_LOCAL uint8_t sim_eeprom[MRC_EEPROM_SIZE];
+extern SIM_THREAD_LOCAL uint32_t sim_eeprom_writes[MRC_EEPROM_SIZE];
+
+// the core's main(), renamed at compile time (see Makefile)
+int firmware_main(int argc, char* argv[]);
+
+// clear the switch script, the event log and the virtual clock: a power
+// cycle, which tears an EEPROM write still in progress
+void sim_reset(void);
+
+// a factory-fresh EEPROM: every cell 0xFF, no wear
+void sim_eeprom_erase(void);
+
+// append a transition to the switch script; edges must be added in
+// non-decreasing time order, the switch idles HIGH before the first edge
+void sim_switch_add_edge(uint64_t t_us, uint8_t level);
+
+// the same for the switch of a channel (MRC_N_CHANNELS > 1); the time order
+// is across all channels.  only channel 0 drives the relay contact model:
+// the other channels log their coil pins, not SIM_RELAY
+void sim_channel_switch_add_edge(uint8_t channel, uint64_t t_us, uint8_t level);
+
+// add a transition to the switch script (channel 0) out of order, at or
+// after the current virtual time, e.g. from sim_hal_call_hook; one at the
+// current time takes effect at once
+void sim_switch_insert_edge(uint64_t t_us, uint8_t level);
+
+// the power-good pin falls at t_us (USE_POWER_FAIL), and stays low: the
+// interrupt preempts the core at the first point it can (not within another
+// interrupt), waking it if needed, and the run ends in
+// MRC_power_fail_halt(); one per run, cleared by sim_reset()
+void sim_power_fail_at(uint64_t t_us);
+
+// a byte on the MIDI input (USE_MIDI), whose start bit falls at t_us; it
+// takes SIM_MIDI_BYTE_US on the line, and must be added in time order, at
+// least that far after the previous one
+#define SIM_MIDI_BYTE_US 320 // start, 8 data and stop bits at 31250 baud
+void sim_midi_add_byte(uint64_t t_us, uint8_t byte);
+
+// run the core until the virtual clock reaches until_us, or until the core
+// goes to sleep with no further switch edges (or MIDI bytes) scripted;
+// returns the virtual time at which the run stopped
+uint64_t sim_run(uint64_t until_us);
+
+// the same for fn(), a part of the core (or a harness function that calls
+// into it) rather than its main(); the virtual clock carries on from where
+// it is
+uint64_t sim_call(uint64_t until_us, void (*fn)(void));
+
+// the recorded transitions, in time order
+const sim_event_t* sim_log(size_t* n);
+
+// advance the virtual clock (backs MRC_sleep_millisecs()/microsecs())
+void sim_advance_us(uint32_t us);
+
+// record a POWER_STATE_* mark (backs MRC_power_state())
+void sim_power_state(uint8_t state, uint8_t active);
+
+#endif // HOSTSIM_H__
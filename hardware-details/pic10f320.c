@@ -25,6 +25,13 @@
 // *** use pin4/RA1 for other side of relay coil
 // *** RA3 is read-only
 //
+// a non-latching relay (USE_NON_LATCHING) has its coil on pin4/RA1 alone,
+// the PWM2 output, through a transistor (and a flyback diode across the
+// coil); pin3/RA2 is unused
+//
+// a dimmed status LED (USE_LED_DIM) is driven by PWM1 on pin5/RA0 while the
+// mcu waits for a press
+//
 // Helpful series of blog posts on pic10f320 here:
 //     https://jamiestarling.com/pic10f322-xc8-code-wpua-weak-pull-ups/
 //
@@ -35,12 +42,75 @@
 
 #include "pic10f320.h"
 
-#define STARTUP_DELAY_MS 72 // startup delay - FIXME - where 72ms comes from?
+// start-up delay: 64ms is the nominal period of the power-up timer (TPWRT),
+// which the configuration (PWRTE = OFF) leaves disabled, i.e. it is done in
+// software instead, while the supply comes up; USE_FAST_BOOT enables the
+// power-up timer, which holds the mcu in reset for the same time, and drops
+// this
+#ifndef STARTUP_DELAY_MS
+#  ifdef USE_FAST_BOOT
+#    define STARTUP_DELAY_MS 0
+#  else
+#    define STARTUP_DELAY_MS 64
+#  endif
+#endif
+
+// TMR0 is clocked at Fosc/4 = 250kHz with no prescaler, i.e. 250 counts per
+// ms; it counts up and interrupts on overflow, so it is reloaded with
+// 256 - 250 on every tick
+#define TMR0_OPTION_PSA 0b00001000 // PSA = 1: prescaler not assigned to TMR0
+#define TMR0_RELOAD     ((uint8_t)(256 - 250 * TIMER_TICK_MS))
+
+#define OSCCON_1MHZ   0b00110000 // IRCF<2:0> = 011
+#define OSCCON_250KHZ 0b00010000 // IRCF<2:0> = 001
+
+// at the low clock TMR0 counts 62.5 times per ms: the tick is 0.8% short
+#ifdef USE_CLOCK_SCALING
+#  define TMR0_RELOAD_LOW ((uint8_t)(256 - 250 * TIMER_TICK_MS / CLOCK_LOW_DIV))
+#  define TMR0_RELOAD_NOW (pic10f320_clock_low ? TMR0_RELOAD_LOW : TMR0_RELOAD)
+volatile uint8_t pic10f320_clock_low = FALSE;
+#else
+#  define TMR0_RELOAD_NOW TMR0_RELOAD
+#endif // USE_CLOCK_SCALING
+
+
+// PWMs, from Timer2 at Fosc/4 with no prescaler: a period of (PR2 + 1)
+// instruction cycles, and a 10-bit duty cycle in quarters of one; ~20kHz at
+// either clock
+//   - non-latching relay hold (USE_NON_LATCHING): PWM2 (the CWG, which
+//     stays off, only has outputs on RA0/RA1 as a complementary pair)
+//   - dimmed status LED (USE_LED_DIM): PWM1, which shares Timer2 with the
+//     hold; only while the mcu waits for a press, at the normal clock
+#if defined(USE_NON_LATCHING) || defined(USE_LED_DIM)
+#  define PWM_PR2          12 // 52us at 1MHz: 19.2kHz
+#  define PWM_PR2_LOW       2 // 48us at 250kHz: 20.8kHz
+#  define PWM_DC(pct, pr2) ((uint16_t)(((pct) * 4U * ((pr2) + 1U) + 99U) / 100U)) // rounded up
+#endif
+#ifdef USE_NON_LATCHING
+static volatile uint8_t pic10f320_relay_hold = FALSE;
+#  define HOLD_PWM_RUNNING pic10f320_relay_hold
+#else
+#  define HOLD_PWM_RUNNING FALSE
+#endif // USE_NON_LATCHING
+#ifdef USE_LED_DIM
+#  if LED_DIM_METHOD != LED_DIM_PWM
+#    error "USE_LED_DIM: LED_DIM_WDT is only implemented for the ATtiny"
+#  endif
+static volatile uint8_t pic10f320_led_dim = FALSE;
+#  define LED_PWM_RUNNING pic10f320_led_dim
+#else
+#  define LED_PWM_RUNNING FALSE
+#endif // USE_LED_DIM
 
 
 void MRC_hardware_init(void)
 {
+    // the delays count cycles of _XTAL_FREQ: switch from the 8MHz reset
+    // clock first
+    OSCCON = OSCCON_1MHZ; // OSCCON (oscillator control register), IRCF<2:0> 011 = 1 MHz
+#if STARTUP_DELAY_MS
     __delay_ms(STARTUP_DELAY_MS);
+#endif
 
     // option register
     // 7     6      5    4    3   2   1   0
@@ -63,26 +133,205 @@ void MRC_hardware_init(void)
     WPUA = 0b00001000; // enable weak pull-up register for WPUA3/RA3
     IOCAP = 0; // disable interrupt-on-change (IOC) PORTA positive edge resistors for all pins
     IOCAN = 0b00001000; // IOCAN3 (RA3) OC PORTA negative edge resistor
-    OSCCON = 0b00110000; // OSCCON (oscillator control register), IRCF<2:0> 011 = 1 MHz
 }
 
-#define pic10f320_enable_interrupts() do { IOCAP=0; IOCAN=0b00001000; INTCON=0b10001000; } while(0)
+void MRC_switch_wake_disarm(void) {  }
+void MRC_disable_sleep(void) { }
 
+// the switch is armed and the mcu put to sleep as one operation, with GIE
+// clear: interrupt-on-change (IOCAN3, from MRC_hardware_init()) then wakes
+// the mcu from SLEEP without a jump to the interrupt service routine, and a
+// falling edge already recorded in IOCAF makes SLEEP a NOP, so one since
+// MRC_switch_pin_clear_int_flags() cannot be slept through.  (enabling the
+// interrupt with GIE set, as this used to, let an edge already recorded be
+// taken before SLEEP, by a service routine that cleared IOCIE: the mcu then
+// slept for good.)  Timer2 stops in SLEEP, and the PWMs with it, at
+// whatever level they were (and there is no idle mode): while one runs
+// (USE_NON_LATCHING, USE_LED_DIM), wait awake for the flag instead
+void MRC_enter_sleep_mode(void)
+{
+    INTCONbits.GIE = 0;
+    INTCONbits.IOCIE = 1;
+    if (HOLD_PWM_RUNNING || LED_PWM_RUNNING)
+    {
+        while (!INTCONbits.IOCIF) { }
+    }
+    else
+    {
+        SLEEP();
+        NOP();
+    }
+    INTCONbits.IOCIE = 0;
+}
 
-void MRC_disable_interrupts(void) {  }
-void MRC_disable_sleep(void) { }
-void MRC_enable_interrupts(void) {  } // use ei() instead?
+#ifdef USE_TIMER_TICK
+void MRC_timer_start(void)
+{
+    OPTION_REG = TMR0_OPTION_PSA; // T0CS = 0: internal instruction clock
+    TMR0 = TMR0_RELOAD_NOW;
+    INTCON = 0b10100000; // GIE and TMR0IE only: no interrupt-on-change
+}
+
+void MRC_timer_stop(void) { INTCON = 0; OPTION_REG = 0; }
+
+// TMR0 does not run during SLEEP on this device, and there is no idle mode:
+// the core polls while the interrupt takes the samples
+void MRC_enter_idle_mode(void) { }
+#endif // USE_TIMER_TICK
+
+#ifdef USE_LOWPOWER_SLEEP
+// WDTCON: WDTPS<4:0> in bits 5:1 select a period of 2^WDTPS ms (1:32 of the
+// 31kHz LFINTOSC upwards), SWDTEN in bit 0 runs the watchdog (WDTE =
+// SWDTEN); a time-out in SLEEP wakes the mcu rather than resetting it
+#define WDTCON_OFF 0b00010110 // reset value: 2s, off
+
+// one SLEEP per set bit of ms, with the matching period; only the watchdog
+// wakes the mcu (interrupt-on-change still sets IOCAF)
+void MRC_sleep_lowpower_ms(uint16_t ms)
+{
+#ifdef USE_NON_LATCHING
+    // no SLEEP while the hold PWM runs, see MRC_enter_sleep_mode()
+    if (pic10f320_relay_hold) { while (ms--) { MRC_sleep_millisecs(1); } return; }
+#endif // USE_NON_LATCHING
+
+    uint8_t intcon = INTCON;
+    INTCON = 0;
+    for (uint8_t wdtps=0; ms; ++wdtps, ms >>= 1)
+    {
+        if (ms & 1)
+        {
+            WDTCON = (uint8_t)(wdtps << 1) | 0b1; // SLEEP clears the count
+            SLEEP();
+            NOP();
+        }
+    }
+    WDTCON = WDTCON_OFF;
+    INTCON = intcon;
+}
+#endif // USE_LOWPOWER_SLEEP
+
+#if MRC_N_CHANNELS > 1
+#  error "MRC_N_CHANNELS: multi-channel is only implemented for the ATtiny"
+#endif
+
+#ifdef USE_VCC_COMPENSATION
+#  error "USE_VCC_COMPENSATION is only implemented for the ATtiny85"
+#endif // USE_VCC_COMPENSATION
+
+#ifdef USE_MUTE
+#  error "USE_MUTE: the pic10f320 has no spare pin for the mute output"
+#endif // USE_MUTE
+
+#ifdef USE_PERSIST
+#  error "USE_PERSIST: the pic10f320 has no data EEPROM"
+#endif // USE_PERSIST
+
+#ifdef USE_TRACE
+#  error "USE_TRACE: the pic10f320's switch read follows the pin-change flag, and cannot see a held switch"
+#endif // USE_TRACE
 
-void MRC_enter_sleep_mode(void) { pic10f320_enable_interrupts(); SLEEP(); }
+#ifdef USE_POWER_FAIL
+#  error "USE_POWER_FAIL: the pic10f320 has no pin left for power-good, and its brown-out detector can only reset it"
+#endif // USE_POWER_FAIL
 
-void MRC_led_pin_set_high(void) { RA0 = ON;   }
-void MRC_led_pin_set_low(void)  { RA0 = OFF;  }
-void MRC_led_toggle(void)       { RA0 = !RA0; }
+#ifdef USE_MIDI
+#  error "USE_MIDI: the pic10f320 has no serial input (USI or UART) for MIDI"
+#endif // USE_MIDI
 
-void MRC_relay_coil_pin1_set_high(void) { RA2 = 1; } // RA2 == pin1
-void MRC_relay_coil_pin1_set_low(void)  { RA2 = 0; }
-void MRC_relay_coil_pin2_set_high(void) { RA1 = 1; } // RA1 == pin2
-void MRC_relay_coil_pin2_set_low(void)  { RA1 = 0; }
+#ifdef USE_NON_LATCHING
+// the period for the clock in use: the same frequency at the low clock,
+// with fewer steps of duty
+static void hold_pwm_set(void)
+{
+    uint8_t pr2 = PWM_PR2;
+    uint16_t dc = PWM_DC(RELAY_HOLD_PERCENT, PWM_PR2);
+#ifdef USE_CLOCK_SCALING
+    if (pic10f320_clock_low) { pr2 = PWM_PR2_LOW; dc = PWM_DC(RELAY_HOLD_PERCENT, PWM_PR2_LOW); }
+#endif // USE_CLOCK_SCALING
+    PR2 = pr2;
+    PWM2DCH = (uint8_t)(dc >> 2);
+    PWM2DCL = (uint8_t)(dc << 6);
+}
+
+void MRC_relay_hold_start(void)
+{
+    hold_pwm_set();
+    TMR2 = 0;
+    T2CON = 0b00000100;   // TMR2ON, 1:1 prescaler and postscaler
+    PWM2CON = 0b11000000; // PWM2EN, PWM2OE: PWM2 takes over RA1 from LATA1
+    pic10f320_relay_hold = TRUE;
+}
+
+// LATA1 is cleared while PWM2 still overrides it, so that the pin goes
+// straight from the PWM to low; the LED is never dimmed at the same time
+// (the relay is reset awake)
+void MRC_relay_hold_stop(void)
+{
+    LATA &= (uint8_t)~MRC_PORT_COIL1;
+    PWM2CON = 0;
+    T2CON = 0;
+    pic10f320_relay_hold = FALSE;
+}
+#endif // USE_NON_LATCHING
+
+#ifdef USE_LED_DIM
+// Timer2 may be running for the hold already, with the same period (the
+// mcu sleeps at the normal clock)
+void MRC_led_dim_start(void)
+{
+    uint16_t dc = PWM_DC(LED_DIM_PERCENT, PWM_PR2);
+    PWM1DCH = (uint8_t)(dc >> 2);
+    PWM1DCL = (uint8_t)(dc << 6);
+    if (!HOLD_PWM_RUNNING)
+    {
+        PR2 = PWM_PR2;
+        TMR2 = 0;
+        T2CON = 0b00000100; // TMR2ON, 1:1 prescaler and postscaler
+    }
+    PWM1CON = 0b11000000; // PWM1EN, PWM1OE: PWM1 takes over RA0 from LATA0
+    pic10f320_led_dim = TRUE;
+}
+
+// LATA0 is still set: the pin goes straight from the PWM to lit
+void MRC_led_dim_stop(void)
+{
+    if (!pic10f320_led_dim) { return; }
+    PWM1CON = 0;
+    if (!HOLD_PWM_RUNNING) { T2CON = 0; }
+    pic10f320_led_dim = FALSE;
+}
+#endif // USE_LED_DIM
+
+#ifdef USE_CLOCK_SCALING
+// the HFINTOSC keeps running, only its postscaler changes: the switch is
+// immediate (HFIOFS stays set)
+void MRC_set_clock_profile(uint8_t profile)
+{
+    pic10f320_clock_low = (CLOCK_PROFILE_LOW == profile);
+    OSCCON = pic10f320_clock_low ? OSCCON_250KHZ : OSCCON_1MHZ;
+#ifdef USE_NON_LATCHING
+    if (pic10f320_relay_hold) { hold_pwm_set(); }
+#endif // USE_NON_LATCHING
+}
+#endif // USE_CLOCK_SCALING
+
+#ifndef MRC_INLINE_HAL // otherwise macros in pic10f320.h
+void MRC_led_pin_set_high(void) { LATAbits.LATA0 = ON;  }
+void MRC_led_pin_set_low(void)  { LATAbits.LATA0 = OFF; }
+void MRC_led_toggle(void)       { LATA ^= MRC_PORT_LED; }
+
+// RA2 == pin1, RA1 == pin2 (USE_NON_LATCHING: RA1 == pin1, see pic10f320.h)
+void MRC_relay_coil_pin1_set_high(void) { LATA |= MRC_PORT_COIL1; }
+void MRC_relay_coil_pin1_set_low(void)  { LATA &= (uint8_t)~MRC_PORT_COIL1; }
+void MRC_relay_coil_pin2_set_high(void) { LATA |= MRC_PORT_COIL2; }
+void MRC_relay_coil_pin2_set_low(void)  { LATA &= (uint8_t)~MRC_PORT_COIL2; }
+
+// one write to LATA: the outputs change on the same instruction
+void MRC_port_apply(uint8_t set, uint8_t clear)
+{
+    LATA = (uint8_t)((LATA & (uint8_t)~clear) | set);
+}
+#endif // MRC_INLINE_HAL
 
 uint8_t MRC_switch_pin_get_state(void)
 { 
@@ -90,10 +339,33 @@ uint8_t MRC_switch_pin_get_state(void)
         ((INTCON & 0b1) && (IOCAF & 0b00001000) && (0 == RA3)) ? LOW : HIGH;
 }
 
+#ifndef MRC_INLINE_HAL
 void MRC_switch_pin_clear_int_flags(void) { IOCAF = 0; }
+#endif // MRC_INLINE_HAL
+
+// IOCAF3 records falling edges only, and the switch read needs it: left set
+// for a press; cleared only if set, and RA3 read again after the clear, in
+// case a press came between the two (if not, its bounce sets IOCAF3 again)
+uint8_t MRC_switch_press_pending(void)
+{
+    if (!(IOCAF & 0b00001000)) { return FALSE; }
+    if (0 == RA3) { return TRUE; }
+    IOCAF = 0;
+    return 0 == RA3 ? TRUE : FALSE;
+}
 
 void __interrupt() ISR(void)
 {
+#ifdef USE_TIMER_TICK
+    if (INTCONbits.TMR0IE && INTCONbits.TMR0IF)
+    {
+        TMR0 += TMR0_RELOAD_NOW; // keep the time already elapsed in this tick
+        INTCONbits.TMR0IF = 0;
+        timer_tick();
+        return;
+    }
+#endif // USE_TIMER_TICK
+
     INTCON = 0;
 }
 
@@ -13,8 +13,16 @@
  */
 #pragma config FOSC = INTOSC // Oscillator Selection bits (INTOSC oscillator: CLKIN function disabled)
 #pragma config BOREN = OFF   // Brown-out Reset Enable (Brown-out Reset disabled)
+#ifdef USE_LOWPOWER_SLEEP
+#pragma config WDTE = SWDTEN // Watchdog Timer Enable (WDT controlled by the SWDTEN bit, see MRC_sleep_lowpower_ms())
+#else
 #pragma config WDTE = OFF    // Watchdog Timer Enable (WDT disabled)
+#endif
+#ifdef USE_FAST_BOOT
+#pragma config PWRTE = ON    // Power-up Timer Enable bit (PWRT enabled, replaces STARTUP_DELAY_MS)
+#else
 #pragma config PWRTE = OFF   // Power-up Timer Enable bit (PWRT disabled)
+#endif
 #pragma config MCLRE = OFF   // MCLR Pin Function Select bit (MCLR pin function is digital input, MCLR internally tied to VDD)
 #pragma config CP = OFF      // Code Protection bit (Program memory code protection is disabled)
 #pragma config LVP = OFF     // Low-Voltage Programming Disable (Low-voltage programming enabled)
@@ -33,7 +41,50 @@
 // - Note: default frequency after reset is 8MHz
 #define _XTAL_FREQ 1000000  // OSCCON = 0b00110000; // 1 MHz
 
-#define MRC_sleep_millisecs(n) __delay_ms(n);
+#ifdef USE_CLOCK_SCALING
+// - CLOCK_PROFILE_LOW runs the HFINTOSC at 250kHz (IRCF = 001) instead of
+//   1MHz; the 31kHz LFINTOSC would leave fewer than eight instructions per
+//   ms, too few for the 1ms debounce sampling
+// - __delay_ms()/__delay_us() count instruction cycles at _XTAL_FREQ, so
+//   while the low clock is active they are asked for 1/CLOCK_LOW_DIV of the
+//   time
+#  define CLOCK_LOW_DIV 4
+extern volatile uint8_t pic10f320_clock_low;
+#  define MRC_sleep_millisecs(n) do { if (pic10f320_clock_low) { __delay_us((n) * 1000UL / CLOCK_LOW_DIV); } else { __delay_ms(n); } } while(0);
+#  define MRC_sleep_microsecs(n) do { if (pic10f320_clock_low) { __delay_us((n) / CLOCK_LOW_DIV); } else { __delay_us(n); } } while(0);
+#else
+#  define MRC_sleep_millisecs(n) __delay_ms(n);
+#  define MRC_sleep_microsecs(n) __delay_us(n);
+#endif // USE_CLOCK_SCALING
+
+// outputs in LATA, for MRC_port_apply(); the outputs are written through
+// the latch, never PORTA, whose reads return the levels at the pins (a
+// bsf/bcf there can write back an output that has not yet reached its level
+// as the wrong one)
+#define MRC_PORT_LED   (1 << 0) // RA0
+#define MRC_PORT_MUTE  0        // no spare pin
+#ifdef USE_NON_LATCHING
+#  define MRC_PORT_COIL1 (1 << 1) // RA1, the PWM2 output (see pic10f320.c)
+#  define MRC_PORT_COIL2 0        // not used
+#else
+#  define MRC_PORT_COIL1 (1 << 2) // RA2
+#  define MRC_PORT_COIL2 (1 << 1) // RA1
+#endif // USE_NON_LATCHING
+
+#ifdef MRC_INLINE_HAL
+// pin operations, one bsf/bcf each at the call site, instead of a call and
+// a return (see pic10f320.c); the switch read stays a function: it is
+// several tests, and only called from the debounce loop
+#  define MRC_led_pin_set_high()         do { LATAbits.LATA0 = ON;  } while(0)
+#  define MRC_led_pin_set_low()          do { LATAbits.LATA0 = OFF; } while(0)
+#  define MRC_led_toggle()               do { LATA ^= MRC_PORT_LED; } while(0)
+#  define MRC_relay_coil_pin1_set_high() do { LATA |= MRC_PORT_COIL1; } while(0)
+#  define MRC_relay_coil_pin1_set_low()  do { LATA &= (uint8_t)~MRC_PORT_COIL1; } while(0)
+#  define MRC_relay_coil_pin2_set_high() do { LATA |= MRC_PORT_COIL2; } while(0)
+#  define MRC_relay_coil_pin2_set_low()  do { LATA &= (uint8_t)~MRC_PORT_COIL2; } while(0)
+#  define MRC_port_apply(set, clear)     do { LATA = (uint8_t)((LATA & (uint8_t)~(clear)) | (set)); } while(0)
+#  define MRC_switch_pin_clear_int_flags() do { IOCAF = 0; } while(0)
+#endif // MRC_INLINE_HAL
 
 #endif // PIC10F320_H__
 
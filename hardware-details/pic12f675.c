@@ -12,10 +12,13 @@
 // GPIO.3 pin4-|    |-pin5 GPIO.2
 //             +----+
 //
-// pin2/GP5 and pin3/GP4 => to relay coil
+// pin2/GP5 and pin3/GP4 => to relay coil (a non-latching relay,
+//             USE_NON_LATCHING: GP5 only)
 // pin7/GP0 => to LED anode (go high when effect on)
 // pin6/GP1 => to switch, pulled high, switch closed = pulled to 0v
-// pin4, pin5 = NC
+// pin5/GP2 => mute output, high = muted (USE_MUTE; otherwise NC)
+// pin4/GP3 => power-good input, low = supply failing (USE_POWER_FAIL;
+//             otherwise NC)
 //
 // https://embeddedlaboratory.blogspot.com/2016/10/how-to-solve-target-device-has-invalid.html
 // How to solve "Target Device has Invalid Calibration Data (0x00)"
@@ -36,12 +39,56 @@
 #include "pic12f675.h"
 
 
-#define STARTUP_DELAY_MS 72 // startup delay - FIXME - where 72ms comes from?
+// start-up delay: 72ms is the nominal period of the power-up timer (TPWRT),
+// which the configuration (PWRTE = OFF) leaves disabled, i.e. it is done in
+// software instead, while the supply comes up; USE_FAST_BOOT enables the
+// power-up timer, which holds the mcu in reset for the same time, and drops
+// this
+#ifndef STARTUP_DELAY_MS
+#  ifdef USE_FAST_BOOT
+#    define STARTUP_DELAY_MS 0
+#  else
+#    define STARTUP_DELAY_MS 72
+#  endif
+#endif
+
+// TMR0 is clocked at Fosc/4 = 1MHz through a 1:4 prescaler, i.e. 250 counts
+// per ms; it counts up and interrupts on overflow, so it is reloaded with
+// 256 - 250 on every tick
+#define TMR0_OPTION_PS 0b001 // PS<2:0> = 1:4 (PSA = 0, prescaler on TMR0)
+#define TMR0_RELOAD    ((uint8_t)(256 - 250 * TIMER_TICK_MS))
+
+// power-good input (USE_POWER_FAIL): GP3 (input only, MCLRE = OFF), a
+// divider from the unregulated supply or a supervisor's output, on its own
+// interrupt-on-change; INTCON keeps GIE and GPIE set throughout (but in
+// SLEEP), and IOC drops the switch once a change of it is recorded, instead
+// of the port change interrupt being disabled
+#ifdef USE_POWER_FAIL
+#  define IOC_ASLEEP    0b00001010 // IOC1 (switch), IOC3 (power-good)
+#  define IOC_AWAKE     0b00001000
+#  define INTCON_ARMED  0b10001000 // GIE, GPIE
+#endif // USE_POWER_FAIL
+
+// the switch's changes since MRC_switch_pin_clear_int_flags(): GPIF, which
+// a change sets whether or not GPIE is, and which stays set; with
+// USE_POWER_FAIL, the interrupt service routine takes GPIF, and records the
+// change here instead
+#ifdef USE_POWER_FAIL
+static volatile uint8_t pic12f675_switch_edge;
+#  define SWITCH_EDGE pic12f675_switch_edge
+#else
+#  define SWITCH_EDGE INTCONbits.GPIF
+#endif // USE_POWER_FAIL
+
+// shadow of the outputs in GPIO (see pic12f675.h)
+uint8_t pic12f675_gpio;
 
 
 void MRC_hardware_init(void)
 {
+#if STARTUP_DELAY_MS
     __delay_ms(STARTUP_DELAY_MS);
+#endif
 
     // option register
     // 7     6      5    4    3   2   1   0
@@ -56,8 +103,12 @@ void MRC_hardware_init(void)
     TRISIO0 = 0; // GPIO 0 is an output ("0" like "Output")
     TRISIO4 = 0;
     TRISIO5 = 0;
+#ifdef USE_MUTE
+    TRISIO2 = 0; // mute output
+#endif // USE_MUTE
     TRISIO1 = 1; // GPIO 1 is an input (1 like "Input") 
-    GPIO = 0; // Initially, all GPIOs are in a low state
+    pic12f675_gpio = 0;
+    GPIO = pic12f675_gpio; // Initially, all GPIOs are in a low state
 
     // interrupt control register
     // 7   6    5    4    3    2    1    0
@@ -77,39 +128,242 @@ void MRC_hardware_init(void)
     // enable interrupts
     // https://ww1.microchip.com/downloads/en/DeviceDoc/50002737C%20XC8%20C%20Compiler%20UG%20for%20PIC.pdf
     //ei();
+
+#ifdef USE_POWER_FAIL
+    // armed from here on; reading GPIO ends any mismatch left from before,
+    // and a pin that is low already makes no change
+    IOC = IOC_AWAKE;
+    (void)GPIO;
+    INTCON = INTCON_ARMED;
+    if (!GP3) { power_fail(); }
+#endif // USE_POWER_FAIL
 }
 
 
-void MRC_disable_interrupts(void) { }
+void MRC_switch_wake_disarm(void) { }
 void MRC_disable_sleep(void) { }
-void MRC_enable_interrupts(void) { INTCON = 0b10001000; } // use ei() instead?
-
-// this is a bit of a hack - even though the main function does
-//    MRC_enable_interrupts()
-//    MRC_enter_sleep_mode()
-// something was happening that would result in the mcu working as expected a
-// few times, then get "stuck" in sleep mode; my hunch is that code was being
-// re-ordered, and the interrupt wasn't truly being enabled before going to
-// sleep
-void MRC_enter_sleep_mode(void) { INTCON = 0b10001000; SLEEP(); }
-
-void MRC_led_pin_set_high(void) { GP0 = ON;   }
-void MRC_led_pin_set_low(void)  { GP0 = OFF;  }
-void MRC_led_toggle(void)       { GP0 = !GP0; }
-
-void MRC_relay_coil_pin1_set_high(void) { GP5 = 1; } // GP5 == pin1
-void MRC_relay_coil_pin1_set_low(void)  { GP5 = 0; }
-void MRC_relay_coil_pin2_set_high(void) { GP4 = 1; } // GP4 == pin2
-void MRC_relay_coil_pin2_set_low(void)  { GP4 = 0; }
+
+// the switch is armed and the mcu put to sleep as one operation, with GIE
+// clear: a port change then wakes the mcu from SLEEP without a jump to the
+// interrupt service routine, and one already recorded in GPIF makes SLEEP a
+// NOP, so a change since MRC_switch_pin_clear_int_flags() cannot be slept
+// through.  (this replaces re-enabling INTCON right before SLEEP, which
+// made the mcu get "stuck" less often, but not never: a port change
+// interrupt taken between the two cleared GPIE in the service routine,
+// leaving nothing to wake the mcu.)  with USE_POWER_FAIL, a power-good
+// change in SLEEP wakes the mcu the same way, and the service routine runs
+// once GIE is set again
+void MRC_enter_sleep_mode(void)
+{
+#ifdef USE_POWER_FAIL
+    INTCONbits.GIE = 0;
+    if (!pic12f675_switch_edge) // otherwise taken by the interrupt already
+    {
+        IOC = IOC_ASLEEP;
+        SLEEP();
+        NOP();
+    }
+    INTCONbits.GIE = 1;
+#else
+    INTCONbits.GPIE = 1; // bit by bit: an INTCON write would clear GPIF
+    SLEEP();
+    NOP();
+    INTCONbits.GPIE = 0;
+#endif // USE_POWER_FAIL
+}
+
+#ifdef USE_TIMER_TICK
+// INTCON bit by bit, so as not to clear a switch change in GPIF; no port
+// change interrupts, but for power-good (USE_POWER_FAIL)
+void MRC_timer_start(void)
+{
+    OPTION_REG = TMR0_OPTION_PS; // T0CS = 0: internal instruction clock
+    TMR0 = TMR0_RELOAD;
+    INTCONbits.T0IF = 0;
+    INTCONbits.T0IE = 1;
+    INTCONbits.GIE = 1;
+}
+
+void MRC_timer_stop(void)
+{
+    INTCONbits.T0IE = 0;
+#ifndef USE_POWER_FAIL
+    INTCONbits.GIE = 0;
+#endif // USE_POWER_FAIL
+    OPTION_REG = 0;
+}
+
+// TMR0 does not run during SLEEP on this device, and there is no idle mode:
+// the core polls while the interrupt takes the samples
+void MRC_enter_idle_mode(void) { }
+#endif // USE_TIMER_TICK
+
+#ifdef USE_LOWPOWER_SLEEP
+// the watchdog is the only wake source that runs in SLEEP, and it can only
+// be enabled by the configuration word (WDTE), i.e. for good: it would then
+// reset the mcu out of every busy-wait, and wake it from power-down every
+// 18ms (times the prescaler it would take from TMR0); spin instead
+void MRC_sleep_lowpower_ms(uint16_t ms)
+{
+    while (ms--) { __delay_ms(1); }
+}
+#endif // USE_LOWPOWER_SLEEP
+
+#if MRC_N_CHANNELS > 1
+#  error "MRC_N_CHANNELS: multi-channel is only implemented for the ATtiny"
+#endif
+
+#ifdef USE_VCC_COMPENSATION
+#  error "USE_VCC_COMPENSATION is only implemented for the ATtiny85"
+#endif // USE_VCC_COMPENSATION
+
+#ifdef USE_CLOCK_SCALING
+// the internal oscillator is fixed at 4MHz (see pic12f675.h)
+void MRC_set_clock_profile(uint8_t profile) { }
+#endif // USE_CLOCK_SCALING
+
+#ifdef USE_NON_LATCHING
+// no PWM on this device (its timers have no output compare): the coil is
+// held at full current, with the pin left high, which SLEEP keeps driven
+void MRC_relay_hold_start(void) { }
+void MRC_relay_hold_stop(void) { PIC12F675_GPIO_CLEAR(MRC_PORT_COIL1); }
+#endif // USE_NON_LATCHING
+
+#ifdef USE_LED_DIM
+#  error "USE_LED_DIM: the pic12f675 has no PWM for the LED"
+#endif // USE_LED_DIM
+
+#ifdef USE_MIDI
+#  error "USE_MIDI: the pic12f675 has no serial input (USI or UART) for MIDI"
+#endif // USE_MIDI
+
+#ifdef USE_PERSIST
+uint8_t MRC_eeprom_read(uint16_t addr)
+{
+    while (EECON1bits.WR) { } // no reads while a write is in progress
+    EEADR = (uint8_t)addr;
+    EECON1bits.RD = 1;
+    return EEDATA;
+}
+
+void MRC_eeprom_write_start(uint16_t addr, uint8_t value)
+{
+    while (EECON1bits.WR) { }
+    EEADR = (uint8_t)addr;
+    EEDATA = value;
+    EECON1bits.WREN = 1;
+
+    // the unlock sequence must not be interrupted
+    uint8_t gie = INTCONbits.GIE;
+    INTCONbits.GIE = 0;
+    EECON2 = 0x55;
+    EECON2 = 0xAA;
+    EECON1bits.WR = 1;
+    INTCONbits.GIE = gie;
+
+    EECON1bits.WREN = 0; // the write in progress carries on
+}
+
+// the write carries on in sleep, and EEIF wakes the mcu; GIE is clear here,
+// so execution simply resumes after SLEEP (which is a NOP if the write has
+// already completed); with USE_POWER_FAIL, GIE is set, and the interrupt
+// service routine clears EEIF on the way
+void MRC_eeprom_wait(void)
+{
+    PIR1bits.EEIF = 0; // stale from an earlier write
+    PIE1bits.EEIE = 1;
+    INTCONbits.PEIE = 1;
+    while (EECON1bits.WR) { SLEEP(); NOP(); }
+    INTCONbits.PEIE = 0;
+    PIE1bits.EEIE = 0;
+    PIR1bits.EEIF = 0;
+}
+#endif // USE_PERSIST
+
+#ifndef MRC_INLINE_HAL // otherwise macros in pic12f675.h
+void MRC_led_pin_set_high(void) { PIC12F675_GPIO_SET(MRC_PORT_LED);    }
+void MRC_led_pin_set_low(void)  { PIC12F675_GPIO_CLEAR(MRC_PORT_LED);  }
+void MRC_led_toggle(void)       { PIC12F675_GPIO_TOGGLE(MRC_PORT_LED); }
+
+#ifdef USE_MUTE
+void MRC_mute_pin_set_high(void) { PIC12F675_GPIO_SET(MRC_PORT_MUTE);   }
+void MRC_mute_pin_set_low(void)  { PIC12F675_GPIO_CLEAR(MRC_PORT_MUTE); }
+#endif // USE_MUTE
+
+void MRC_relay_coil_pin1_set_high(void) { PIC12F675_GPIO_SET(MRC_PORT_COIL1);   } // GP5 == pin1
+void MRC_relay_coil_pin1_set_low(void)  { PIC12F675_GPIO_CLEAR(MRC_PORT_COIL1); }
+void MRC_relay_coil_pin2_set_high(void) { PIC12F675_GPIO_SET(MRC_PORT_COIL2);   } // GP4 == pin2
+void MRC_relay_coil_pin2_set_low(void)  { PIC12F675_GPIO_CLEAR(MRC_PORT_COIL2); }
+
+void MRC_port_apply(uint8_t set, uint8_t clear) { PIC12F675_GPIO_APPLY(set, clear); }
 
 uint8_t MRC_switch_pin_get_state(void) { return 0 == GP1 ? LOW : HIGH; }
-void MRC_switch_pin_clear_int_flags(void) { }
+#endif // MRC_INLINE_HAL
+
+// out of line even with MRC_INLINE_HAL: called once per wake-up at most.
+// reading GPIO ends the mismatch, so that GPIF records only the changes
+// from here on; with USE_POWER_FAIL, the switch is unmasked for them
+void MRC_switch_pin_clear_int_flags(void)
+{
+    (void)GPIO;
+#ifdef USE_POWER_FAIL
+    pic12f675_switch_edge = FALSE;
+    IOC = IOC_ASLEEP;
+#else
+    INTCONbits.GPIF = 0;
+#endif // USE_POWER_FAIL
+}
+
+// cleared only if set: a change that comes between the test and the clear
+// is then one already counted, and the pin is read after the clear
+uint8_t MRC_switch_press_pending(void)
+{
+    if (!SWITCH_EDGE) { return FALSE; }
+    MRC_switch_pin_clear_int_flags();
+    return 0 == GP1 ? TRUE : FALSE;
+}
 
 // https://www.microforum.cc/topic/38-help-with-this-error-error-variable-has-incomplete-type-void/
 // http://picforum.ric323.com/viewtopic.php?f=44&t=701
 void __interrupt() ISR(void)
 {
-    INTCON = 0; // disable interrupts and clear interrupt flags - should we
-                // use di() instead?
+#ifdef USE_TIMER_TICK
+    if (INTCONbits.T0IE && INTCONbits.T0IF)
+    {
+        TMR0 += TMR0_RELOAD; // keep the time already elapsed in this tick
+        INTCONbits.T0IF = 0;
+        timer_tick();
+        return;
+    }
+#endif // USE_TIMER_TICK
+
+#ifdef USE_POWER_FAIL
+    if (INTCONbits.GPIF)
+    {
+        (void)GPIO; // ends the mismatch
+        INTCONbits.GPIF = 0;
+        if (!GP3) { power_fail(); } // does not return
+        pic12f675_switch_edge = TRUE;
+        IOC = IOC_AWAKE; // recorded: masked until cleared, or asleep
+        return;
+    }
+    PIR1bits.EEIF = 0; // MRC_eeprom_wait()
+#endif // USE_POWER_FAIL
+
+    // otherwise nothing else is enabled: port changes wake the mcu with GIE
+    // clear (see MRC_enter_sleep_mode()), and GPIF is left for the core
+}
+
+#ifdef USE_POWER_FAIL
+// interrupts are disabled in the service routine: spin until the supply
+// dies, or comes back after a dip; the watchdog can only be enabled by the
+// configuration word (see MRC_sleep_lowpower_ms()), so the restart is a
+// jump to the reset vector, where the runtime start-up re-initializes the
+// variables, and MRC_hardware_init() the registers
+void MRC_power_fail_halt(void)
+{
+    while (!GP3) { }
+    asm("ljmp 0");
 }
+#endif // USE_POWER_FAIL
 
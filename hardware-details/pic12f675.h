@@ -10,7 +10,11 @@
 // configuration bits
 #pragma config FOSC = INTRCIO
 #pragma config WDTE = OFF
+#ifdef USE_FAST_BOOT
+#pragma config PWRTE = ON // replaces STARTUP_DELAY_MS
+#else
 #pragma config PWRTE = OFF
+#endif
 #pragma config MCLRE = OFF
 #pragma config BOREN = OFF
 #pragma config CP = OFF
@@ -24,8 +28,45 @@
 // https://forum.microchip.com/s/topic/a5C3l000000BoWVEA0/t390718?comment=P-2919727
 #define _XTAL_FREQ 4000000
 
+// data EEPROM (USE_PERSIST)
+#define MRC_EEPROM_SIZE 128
 
 #define MRC_sleep_millisecs(n) __delay_ms(n);
+#define MRC_sleep_microsecs(n) __delay_us(n);
+
+// outputs in GPIO, for MRC_port_apply()
+#define MRC_PORT_LED   (1 << 0) // GP0
+#define MRC_PORT_MUTE  (1 << 2) // GP2
+#define MRC_PORT_COIL1 (1 << 5) // GP5
+#define MRC_PORT_COIL2 (1 << 4) // GP4
+
+// - the outputs are written from a shadow copy of GPIO: the pic12f675 has
+//   no output latch register, and reading GPIO returns the levels at the
+//   pins, so a bsf/bcf (read-modify-write) on it can write back an output
+//   that has not yet reached its level (e.g. into the coil or LED load) as
+//   the wrong one
+// - every output change is one movf/movwf of the shadow to GPIO
+extern uint8_t pic12f675_gpio;
+#define PIC12F675_GPIO_SET(m)    do { GPIO = (pic12f675_gpio |= (uint8_t)(m)); } while(0)
+#define PIC12F675_GPIO_CLEAR(m)  do { GPIO = (pic12f675_gpio &= (uint8_t)~(m)); } while(0)
+#define PIC12F675_GPIO_TOGGLE(m) do { GPIO = (pic12f675_gpio ^= (uint8_t)(m)); } while(0)
+#define PIC12F675_GPIO_APPLY(set, clear) do { GPIO = (pic12f675_gpio = (uint8_t)((pic12f675_gpio & (uint8_t)~(clear)) | (set))); } while(0)
+
+#ifdef MRC_INLINE_HAL
+// pin operations, a few instructions each at the call site, instead of a
+// call, the bank select and a return (see pic12f675.c)
+#  define MRC_led_pin_set_high()         PIC12F675_GPIO_SET(MRC_PORT_LED)
+#  define MRC_led_pin_set_low()          PIC12F675_GPIO_CLEAR(MRC_PORT_LED)
+#  define MRC_led_toggle()               PIC12F675_GPIO_TOGGLE(MRC_PORT_LED)
+#  define MRC_mute_pin_set_high()        PIC12F675_GPIO_SET(MRC_PORT_MUTE)
+#  define MRC_mute_pin_set_low()         PIC12F675_GPIO_CLEAR(MRC_PORT_MUTE)
+#  define MRC_relay_coil_pin1_set_high() PIC12F675_GPIO_SET(MRC_PORT_COIL1)
+#  define MRC_relay_coil_pin1_set_low()  PIC12F675_GPIO_CLEAR(MRC_PORT_COIL1)
+#  define MRC_relay_coil_pin2_set_high() PIC12F675_GPIO_SET(MRC_PORT_COIL2)
+#  define MRC_relay_coil_pin2_set_low()  PIC12F675_GPIO_CLEAR(MRC_PORT_COIL2)
+#  define MRC_port_apply(set, clear)     PIC12F675_GPIO_APPLY((set), (clear))
+#  define MRC_switch_pin_get_state()     (0 == GP1 ? LOW : HIGH)
+#endif // MRC_INLINE_HAL
 
 #endif // PIC12F657_H__
 
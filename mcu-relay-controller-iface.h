@@ -27,7 +27,65 @@
 // - read of the Kemet EC2-3TNU (which has very similar specs as Panasonic
 //   TQ2-L-5V) datasheet suggests a current pulse time of at least 10ms to
 //   account for relay bounce time
-#define RELAY_SETTLE_TIME_MS 15
+// - RELAY_PROFILE selects the relay at build time (e.g.
+//   MRC_FLAGS=-DRELAY_PROFILE=RELAY_PROFILE_TQ2); each profile defines
+//     RELAY_SET_PULSE_MS, RELAY_RESET_PULSE_MS: coil pulse widths, enough at
+//       the relay's must-operate voltage
+//     RELAY_OPERATE_MS: the shortest pulse that still switches the relay
+//       reliably; the floor for USE_VCC_COMPENSATION
+//     RELAY_MIN_OPERATE_MV: the must-operate (set/reset) voltage; 0 if not
+//       known, which leaves the pulse widths uncompensated
+// - the default profile is the original one-size-fits-all 15ms
+#define RELAY_PROFILE_GENERIC 0 // any relay of the supported kinds
+#define RELAY_PROFILE_TQ2     1 // Panasonic TQ2-L-5V, Takamisawa AL5WN-K (5V)
+#define RELAY_PROFILE_EC2     2 // Kemet EC2-3TNU (3V)
+#ifndef RELAY_PROFILE
+#  define RELAY_PROFILE RELAY_PROFILE_GENERIC
+#endif
+#if RELAY_PROFILE == RELAY_PROFILE_GENERIC
+#  define RELAY_SET_PULSE_MS   15
+#  define RELAY_RESET_PULSE_MS 15
+#  define RELAY_OPERATE_MS     15
+#  define RELAY_MIN_OPERATE_MV 0
+#elif RELAY_PROFILE == RELAY_PROFILE_TQ2
+#  define RELAY_SET_PULSE_MS   5    // 3ms set/reset time, plus margin
+#  define RELAY_RESET_PULSE_MS 5
+#  define RELAY_OPERATE_MS     3
+#  define RELAY_MIN_OPERATE_MV 3750 // 75% of nominal
+#elif RELAY_PROFILE == RELAY_PROFILE_EC2
+#  define RELAY_SET_PULSE_MS   12   // 10ms to cover contact bounce, plus margin
+#  define RELAY_RESET_PULSE_MS 12
+#  define RELAY_OPERATE_MS     10
+#  define RELAY_MIN_OPERATE_MV 2250 // 75% of nominal
+#else
+#  error "unknown RELAY_PROFILE"
+#endif
+
+#if (RELAY_SET_PULSE_MS < RELAY_OPERATE_MS) || (RELAY_RESET_PULSE_MS < RELAY_OPERATE_MS)
+#  error "RELAY_PROFILE: coil pulses must be at least RELAY_OPERATE_MS"
+#endif
+
+// - the longest coil pulse the firmware may use; USE_VCC_COMPENSATION
+//   lengthens the pulse on a supply below the must-operate voltage, up to
+//   twice the profile's width
+#define RELAY_PULSE_MAX_OF(a, b) ((a) > (b) ? (a) : (b))
+#ifdef USE_VCC_COMPENSATION
+#  define RELAY_SETTLE_TIME_MS (2 * RELAY_PULSE_MAX_OF(RELAY_SET_PULSE_MS, RELAY_RESET_PULSE_MS))
+#else
+#  define RELAY_SETTLE_TIME_MS RELAY_PULSE_MAX_OF(RELAY_SET_PULSE_MS, RELAY_RESET_PULSE_MS)
+#endif
+
+// - non-latching relay (see USE_NON_LATCHING below): once the set pulse
+//   (now the pull-in) is over, the coil is held at RELAY_HOLD_PERCENT of
+//   the full coil current, by PWM; it must keep the average coil voltage
+//   above the relay's must-hold voltage (a datasheet minimum, well above
+//   the must-release voltage) with some margin for a sagging supply
+#ifndef RELAY_HOLD_PERCENT
+#  define RELAY_HOLD_PERCENT 50
+#endif
+#if (RELAY_HOLD_PERCENT < 1) || (RELAY_HOLD_PERCENT > 100)
+#  error "RELAY_HOLD_PERCENT: 1..100"
+#endif
 
 // - the reference implementation circuit includes an RF filter on the wire
 //   between MCU and momentary switch, which should help eliminate spurious
@@ -37,9 +95,24 @@
 //   confirmed (i.e. debounced) switch press
 #define SWITCH_DEBOUNCE_TIME_MS 100
 
+// - during that delay, the switch is still polled every LOCKOUT_POLL_MS for
+//   its release: a press that follows one is acted on as soon as the delay
+//   is over, while bounce and noise on a switch still held are ignored
+#define LOCKOUT_POLL_MS 20
+#if (SWITCH_DEBOUNCE_TIME_MS % LOCKOUT_POLL_MS) != 0
+#  error "SWITCH_DEBOUNCE_TIME_MS: a multiple of LOCKOUT_POLL_MS"
+#endif
+
 // - how many times we'll poll the switch's state during the debounce routine
 // - note the debounce routine 
-#define MAX_N_SWITCH_DEBOUNCE_READS 80
+// - sim/bench-debounce sweeps this and SWITCH_DEBOUNCE_TARGET against a
+//   corpus of switch traces (make debounce-sweep)
+#ifndef MAX_N_SWITCH_DEBOUNCE_READS
+#  define MAX_N_SWITCH_DEBOUNCE_READS 80
+#endif
+#if (MAX_N_SWITCH_DEBOUNCE_READS < 1) || (MAX_N_SWITCH_DEBOUNCE_READS > 255)
+#  error "MAX_N_SWITCH_DEBOUNCE_READS: 1..255 (counted in a uint8_t)"
+#endif
 
 // - this number is used in the switch debounce routine; it defines how many
 //   consecutive desired state reads we need from the switch to consider it
@@ -47,7 +120,254 @@
 // - 0xFF is hex, corresponding binary (uint8_t) is: 0b11111111
 //   in other words, we want eight consecutive, consistent reads of the switch
 //   state to consider it pressed and de-bounced
-#define SWITCH_DEBOUNCE_TARGET 0xFF
+// - fewer ones (e.g. 0x3F, six reads) detect a press sooner, but let longer
+//   noise through
+#ifndef SWITCH_DEBOUNCE_TARGET
+#  define SWITCH_DEBOUNCE_TARGET 0xFF
+#endif
+#if (SWITCH_DEBOUNCE_TARGET < 1) || (SWITCH_DEBOUNCE_TARGET > 0xFF) || \
+    (SWITCH_DEBOUNCE_TARGET & (SWITCH_DEBOUNCE_TARGET + 1))
+#  error "SWITCH_DEBOUNCE_TARGET: 0x01, 0x03, ... 0xFF (n consecutive reads)"
+#endif
+#define SWITCH_DEBOUNCE_READS \
+    ((SWITCH_DEBOUNCE_TARGET >> 7) + ((SWITCH_DEBOUNCE_TARGET >> 6) & 1) + \
+     ((SWITCH_DEBOUNCE_TARGET >> 5) & 1) + ((SWITCH_DEBOUNCE_TARGET >> 4) & 1) + \
+     ((SWITCH_DEBOUNCE_TARGET >> 3) & 1) + ((SWITCH_DEBOUNCE_TARGET >> 2) & 1) + \
+     ((SWITCH_DEBOUNCE_TARGET >> 1) & 1) + (SWITCH_DEBOUNCE_TARGET & 1))
+
+// - adaptive debounce (see USE_ADAPTIVE_DEBOUNCE below): a press needs
+//   DEBOUNCE_ADAPT_MARGIN_READS more consecutive low reads than the longest
+//   low stretch seen within a bounce, and no fewer than
+//   DEBOUNCE_ADAPT_MIN_READS (against noise on the footswitch wire, which
+//   lasts up to ~2ms; the wake-up read and the first after it are all but
+//   simultaneous); the lockout lasts DEBOUNCE_ADAPT_LOCKOUT_FACTOR
+//   times the longest bounce seen, in LOCKOUT_POLL_MS steps; the fixed
+//   SWITCH_DEBOUNCE_TARGET and SWITCH_DEBOUNCE_TIME_MS are the most either
+//   gets
+// - each comes down one step after DEBOUNCE_ADAPT_RELAX presses in a row
+//   that would have done with less
+#ifndef DEBOUNCE_ADAPT_MIN_READS
+#  define DEBOUNCE_ADAPT_MIN_READS 5
+#endif
+#ifndef DEBOUNCE_ADAPT_MARGIN_READS
+#  define DEBOUNCE_ADAPT_MARGIN_READS 3
+#endif
+#ifndef DEBOUNCE_ADAPT_LOCKOUT_FACTOR
+#  define DEBOUNCE_ADAPT_LOCKOUT_FACTOR 4
+#endif
+#ifndef DEBOUNCE_ADAPT_RELAX
+#  define DEBOUNCE_ADAPT_RELAX 32
+#endif
+#if (DEBOUNCE_ADAPT_MIN_READS < 1) || (DEBOUNCE_ADAPT_MIN_READS > SWITCH_DEBOUNCE_READS)
+#  error "DEBOUNCE_ADAPT_MIN_READS: 1 up to the reads of SWITCH_DEBOUNCE_TARGET"
+#endif
+#if (DEBOUNCE_ADAPT_RELAX < 1) || (DEBOUNCE_ADAPT_RELAX > 255)
+#  error "DEBOUNCE_ADAPT_RELAX: 1..255"
+#endif
+#if defined(USE_ADAPTIVE_DEBOUNCE) && defined(USE_PERSIST) && \
+    (SWITCH_DEBOUNCE_TIME_MS > 8 * LOCKOUT_POLL_MS)
+#  error "USE_ADAPTIVE_DEBOUNCE: the EEPROM record holds up to 8 lockout polls"
+#endif
+
+// - leading-edge debounce strategies (see DEBOUNCE_STRATEGY below) accept a
+//   press when the switch reads low on wake-up and still reads low this many
+//   microseconds later; this rejects RF spikes shorter than that
+// - after a wake-up that does not pass that check (typically the switch
+//   release), the pin is ignored for DEBOUNCE_RELEASE_LOCKOUT_MS to let
+//   bounce die out, then read once more; contact bounce of a healthy
+//   footswitch lasts well under 5ms
+#define DEBOUNCE_CONFIRM_US 100
+#define DEBOUNCE_RELEASE_LOCKOUT_MS 10
+
+// - DEBOUNCE_INTEGRATOR (see below) first reads the switch
+//   DEBOUNCE_QUICK_READS times, DEBOUNCE_QUICK_GAP_US apart, on wake-up;
+//   unless at least half of those read low, the wake-up is rejected there
+//   and then, and the mcu goes back to sleep: an RF spike is over within
+//   tens of microseconds, while a press holds the pin low most of the time
+//   even as it bounces
+// - a press rejected that way is not lost: its bounce ends in an edge,
+//   which wakes the mcu again; it is then debounced from that later
+//   wake-up (with a short bounce, up to ~2ms later)
+#ifndef DEBOUNCE_QUICK_READS
+#  define DEBOUNCE_QUICK_READS 4
+#endif
+#ifndef DEBOUNCE_QUICK_GAP_US
+#  define DEBOUNCE_QUICK_GAP_US 25
+#endif
+#if (DEBOUNCE_QUICK_READS < 1) || (DEBOUNCE_QUICK_READS > 255)
+#  error "DEBOUNCE_QUICK_READS: 1..255"
+#endif
+
+// - audio mute around relay transitions (see USE_MUTE below): the mute is
+//   asserted MUTE_PRE_US before the coil is energized (time for the mute
+//   switch to turn on), and released MUTE_POST_US after the contacts have
+//   come to rest, RELAY_OPERATE_MS after the coil was energized
+// - MUTE_POST_US must be less than 1000
+#ifndef MUTE_PRE_US
+#  define MUTE_PRE_US 100
+#endif
+#ifndef MUTE_POST_US
+#  define MUTE_POST_US 200
+#endif
+
+// - gestures (see USE_GESTURES below): a press held longer than
+//   GESTURE_LONG_PRESS_MS is a long press; a second press that starts within
+//   GESTURE_DOUBLE_TAP_MS of the release of a tap makes a double tap (if
+//   GESTURE_DOUBLE_TAP_ACTION() is defined)
+// - both are measured between debounced edges, i.e. ~8ms after the real
+//   ones
+#ifndef GESTURE_LONG_PRESS_MS
+#  define GESTURE_LONG_PRESS_MS 500
+#endif
+#ifndef GESTURE_DOUBLE_TAP_MS
+#  define GESTURE_DOUBLE_TAP_MS 300
+#endif
+
+// - event trace (see USE_TRACE below): the ring holds the last
+//   TRACE_RING_SIZE records, two bytes each (a power of two, at most 64; the
+//   ATtiny13 has 64 bytes of RAM in all); a press held for
+//   TRACE_DUMP_HOLD_MS sends them out on the LED pin, as 8N1 serial at
+//   TRACE_BAUD
+// - TRACE_BAUD is kept low so that the overhead of the bit loop (a few
+//   instructions per bit, not accounted for in the bit delay) stays a small
+//   part of a bit time at 1MHz; sim/trace-decode measures the actual bit
+//   time from the first byte of each dump anyway
+#ifndef TRACE_RING_SIZE
+#  define TRACE_RING_SIZE 8
+#endif
+#ifndef TRACE_BAUD
+#  define TRACE_BAUD 1200
+#endif
+#ifndef TRACE_DUMP_HOLD_MS
+#  define TRACE_DUMP_HOLD_MS 3000
+#endif
+#define TRACE_BIT_US (1000000UL / TRACE_BAUD)
+
+// - trace record: [event:3 | time:5] [argument], time in TRACE_TIME_MS units
+//   since the wake-up (saturating: 31 is 248ms or later)
+// - dump: TRACE_SYNC (0x55, alternating bits, to measure the bit time
+//   from), TRACE_MAGIC, the number of records, the records oldest first,
+//   and the xor of the count and record bytes
+#define TRACE_EV_WAKE        0 // argument: wake-up count (mod 256)
+#define TRACE_EV_ACCEPT      1 // press accepted; argument: integrator reads
+                               // (0: accepted on the leading edge)
+#define TRACE_EV_REJECT      2 // no press; argument: integrator reads
+#define TRACE_EV_SET         3 // relay coil pulse; argument: its width in ms
+#define TRACE_EV_RESET       4 // likewise
+#define TRACE_EV_LOCKOUT_END 5 // post-press lockout over
+#define TRACE_TIME_MS        8
+#define TRACE_SYNC           0x55
+#define TRACE_MAGIC          0xA5
+
+// - LED greeting: the LED blinks four times (2s) at power-up; presses are
+//   not seen until it is over
+// - on by default, off with USE_FAST_BOOT (see below), where it runs, if
+//   enabled, after the relay has been set
+#ifndef LED_GREETING
+#  ifdef USE_FAST_BOOT
+#    define LED_GREETING 0
+#  else
+#    define LED_GREETING 1
+#  endif
+#endif
+
+// - dimmed status LED (see USE_LED_DIM below): while the mcu sleeps with
+//   the relay ON, the LED is lit for LED_DIM_PERCENT of the time, by one
+//   of the LED_DIM_METHODs: a hardware PWM on the LED pin (LED_DIM_PWM,
+//   the default), or a pulse from each watchdog wake-up (LED_DIM_WDT)
+#define LED_DIM_PWM 0
+#define LED_DIM_WDT 1
+#ifndef LED_DIM_METHOD
+#  define LED_DIM_METHOD LED_DIM_PWM
+#endif
+#ifndef LED_DIM_PERCENT
+#  define LED_DIM_PERCENT 10
+#endif
+#if (LED_DIM_PERCENT < 1) || (LED_DIM_PERCENT > 100)
+#  error "LED_DIM_PERCENT: 1..100"
+#endif
+#if (LED_DIM_METHOD != LED_DIM_PWM) && (LED_DIM_METHOD != LED_DIM_WDT)
+#  error "unknown LED_DIM_METHOD"
+#endif
+
+// - remote commands (see USE_MIDI below): the MIDI channel listened to
+//   (1..16, or 0 for all of them), the controller whose value sets the
+//   relay (ON at 64 and above, OFF below), and the programs that switch it
+//   OFF, ON, or toggle it; controller and program numbers are as sent, i.e.
+//   0..127 (pedalboards often show programs as 1..128), and any larger
+//   value leaves that command out
+#ifndef MIDI_CHANNEL
+#  define MIDI_CHANNEL 1
+#endif
+#ifndef MIDI_CC
+#  define MIDI_CC 80 // general purpose controller 5
+#endif
+#ifndef MIDI_PROGRAM_OFF
+#  define MIDI_PROGRAM_OFF 0
+#endif
+#ifndef MIDI_PROGRAM_ON
+#  define MIDI_PROGRAM_ON 1
+#endif
+#ifndef MIDI_PROGRAM_TOGGLE
+#  define MIDI_PROGRAM_TOGGLE 255
+#endif
+#if (MIDI_CHANNEL < 0) || (MIDI_CHANNEL > 16)
+#  error "MIDI_CHANNEL: 1..16, or 0 for all"
+#endif
+#if (MIDI_CC >= 120) && (MIDI_CC <= 127)
+#  error "MIDI_CC: 120..127 are channel mode messages"
+#endif
+
+// - number of switch/relay channels driven by the mcu (see MRC_N_CHANNELS
+//   below); channel n is bit n of relay_state and of the multi-channel HAL
+//   masks
+// - with more than one, every channel is debounced at once, from one read
+//   of all the switch pins per ms (vertical counters); the optional
+//   features that follow a single switch (USE_GESTURES, USE_SCHEDULER,
+//   USE_TIMER_DEBOUNCE, USE_MUTE, USE_PERSIST, USE_TRACE, USE_WAKE_STATS,
+//   USE_POWER_FAIL, USE_NON_LATCHING, USE_LED_DIM, USE_MIDI,
+//   USE_ADAPTIVE_DEBOUNCE, the leading-edge DEBOUNCE_STRATEGYs)
+//   are not available
+#ifndef MRC_N_CHANNELS
+#  define MRC_N_CHANNELS 1
+#endif
+#define MRC_CHANNEL_MASK ((uint8_t)((1U << MRC_N_CHANNELS) - 1))
+
+// - multi-channel coil pulses: the relays that change at once (presses
+//   debounced in the same read, and the start-up reset of every channel)
+//   are pulsed in rounds, each round the coils of one direction whose
+//   currents add up to RELAY_PEAK_MA or less; the fewer rounds, the sooner
+//   the last relay is there
+// - RELAY_PEAK_MA: the most coil current the board may supply at once,
+//   i.e. the least of what the regulator can spare, and what a pin the
+//   coils share can carry (the ATtiny's shared coil return carries the sum
+//   of the set coils: 40mA absolute maximum per pin); the default, one
+//   coil's worth, pulses one relay at a time
+// - RELAY_COIL_MA: the coil current of each relay at the supply voltage
+//   (e.g. a TQ2-L-5V at 5V: 28mA); RELAY_CHANNEL_COIL_MA(ch) is that of
+//   channel ch, where the relays differ, e.g.
+//   -D'RELAY_CHANNEL_COIL_MA(ch)=((ch) ? 17 : 28)'
+// - a coil that draws more than RELAY_PEAK_MA on its own is still pulsed,
+//   alone
+// - sim/bench-coils checks the schedules against the budget, and compares
+//   their length with one coil at a time
+#ifndef RELAY_COIL_MA
+#  define RELAY_COIL_MA 28
+#endif
+#ifndef RELAY_CHANNEL_COIL_MA
+#  define RELAY_CHANNEL_COIL_MA(ch) RELAY_COIL_MA
+#endif
+#ifndef RELAY_PEAK_MA
+#  define RELAY_PEAK_MA RELAY_COIL_MA
+#endif
+#if (RELAY_COIL_MA < 1) || (RELAY_COIL_MA > 255) || (RELAY_PEAK_MA < 1) || (RELAY_PEAK_MA > 65535)
+#  error "RELAY_COIL_MA: 1..255, RELAY_PEAK_MA: 1..65535 (added up in a uint16_t)"
+#endif
+
+// - period of the timer interrupt used by the interrupt-driven debounce (see
+//   USE_TIMER_DEBOUNCE below), i.e. the spacing of the switch reads
+// - 1ms is the same spacing as the busy-wait debounce loop
+#define TIMER_TICK_MS 1
 
 // hopefully these are self-explanatory :)
 #define OFF (0)
@@ -61,6 +381,327 @@
 #  define TRUE (!FALSE)
 #endif
 
+/*
+ * optional features, enabled at build time by defining the macro (e.g.
+ * make attiny85 MRC_FLAGS=-DUSE_TIMER_DEBOUNCE)
+ *
+ * USE_TIMER_DEBOUNCE
+ *   - switch reads for the debounce are taken by a periodic timer interrupt
+ *     (every TIMER_TICK_MS), while the core waits in idle sleep, instead of
+ *     the core busy-waiting between reads
+ *   - requires MRC_timer_start(), MRC_timer_stop() and MRC_enter_idle_mode()
+ *
+ * USE_SCHEDULER
+ *   - the end of the relay coil pulse and the end of the post-press lockout
+ *     become deadlines in a small table counted down by the timer interrupt
+ *     (one byte per task, plus a due flag); the core sleeps in idle mode
+ *     between deadlines instead of busy-waiting, and the LED flips at the
+ *     start of the coil pulse rather than after it
+ *   - deadlines are at most 255 ticks away
+ *   - requires the same functions as USE_TIMER_DEBOUNCE, which it pairs
+ *     well with (otherwise the debounce itself still busy-waits)
+ *
+ * USE_CLOCK_SCALING
+ *   - the core runs the mcu from a slower clock while it debounces and
+ *     during the post-press lockout, where it only waits, and from the
+ *     normal clock otherwise
+ *   - requires MRC_set_clock_profile()
+ *
+ * USE_VCC_COMPENSATION
+ *   - the supply voltage is measured before each relay coil pulse, and the
+ *     pulse width scaled to it: RELAY_*_PULSE_MS is enough at
+ *     RELAY_MIN_OPERATE_MV, a healthy supply drives more current through
+ *     the coil and switches it sooner (down to RELAY_OPERATE_MS), a sagging
+ *     one gets a longer pulse (up to twice as long)
+ *   - requires MRC_supply_millivolts(); ATtiny85 only
+ *
+ * USE_MUTE
+ *   - a mute output (e.g. the gates of a pair of BS170 MOSFETs shunting the
+ *     signal to ground, as on the BYOC relay bypass board) is asserted
+ *     around every relay transition, see MUTE_PRE_US/MUTE_POST_US
+ *   - the window is timed in microseconds, except with USE_SCHEDULER, where
+ *     the release is a scheduler deadline (up to one TIMER_TICK_MS later)
+ *   - requires MRC_mute_pin_set_high() and MRC_mute_pin_set_low(); needs a
+ *     spare pin, so not on the PIC10F320
+ *
+ * USE_GESTURES
+ *   - every press toggles the relay as soon as it is debounced, as without
+ *     gestures (no waiting to see whether a double tap follows); the core
+ *     then stays awake, sampling the switch every 1ms, until the gesture is
+ *     complete, and corrects the relay if it turns out not to be a tap:
+ *       tap:        relay toggled (latching)
+ *       long press: momentary, the relay is toggled back on release
+ *       double tap: only if GESTURE_DOUBLE_TAP_ACTION() is defined (e.g.
+ *                   as a call to a function of your own): the first tap
+ *                   is undone on the second press, and the action runs;
+ *                   otherwise a second press is just another tap
+ *   - no RAM beyond a few bytes of stack; costs the whole hold of a long
+ *     press in awake time, and, with GESTURE_DOUBLE_TAP_ACTION(), a further
+ *     ~GESTURE_DOUBLE_TAP_MS after each tap
+ *
+ * USE_PERSIST
+ *   - the relay comes back in the state it was left in at power-up, rather
+ *     than always OFF
+ *   - each change of state appends a one-byte record to a ring spanning the
+ *     whole data EEPROM (but its last cell, with USE_ADAPTIVE_DEBOUNCE), so
+ *     every cell is written once per MRC_EEPROM_SIZE changes; the write is
+ *     started once the coil pulse is over, and runs
+ *     while the core waits out the lockout (or sleeps)
+ *   - requires MRC_eeprom_read(), MRC_eeprom_write_start(),
+ *     MRC_eeprom_wait() and MRC_EEPROM_SIZE; not on the PIC10F320, which
+ *     has no data EEPROM
+ *
+ * USE_LOWPOWER_SLEEP
+ *   - the delays that need no better than 1ms accuracy (coil pulse,
+ *     post-press lockout, LED greeting) sleep in the deepest mode that keeps
+ *     the outputs driven, rather than spinning; the 1ms switch sampling and
+ *     the microsecond mute timing still spin
+ *   - requires MRC_sleep_lowpower_ms()
+ *
+ * USE_FAST_BOOT
+ *   - the relay and LED are put in their defined state first thing after
+ *     MRC_hardware_init(), and the LED greeting is dropped (see
+ *     LED_GREETING); without it, the relay is left alone until the 2s
+ *     greeting is over
+ *   - the targets drop their software start-up delay in favour of the
+ *     hardware one that holds the mcu in reset (see STARTUP_DELAY_MS in
+ *     hardware-details/), so the relay is set within one coil pulse of the
+ *     first instruction
+ *
+ * USE_TRACE
+ *   - the core records what it does in a ring of TRACE_RING_SIZE two-byte
+ *     records (see TRACE_EV_*): every wake-up, debounce verdicts with their
+ *     read count, relay set/reset with the coil pulse width, and the end of
+ *     the post-press lockout, each with the time since the wake-up (in
+ *     TRACE_TIME_MS steps, counted from the core's own delays, or from the
+ *     timer interrupt with USE_SCHEDULER)
+ *   - a press held down for TRACE_DUMP_HOLD_MS (the relay toggles as
+ *     usual) sends the ring, oldest record first, as 8N1 serial at
+ *     TRACE_BAUD on the LED pin, and empties it; the LED is back in step
+ *     with the relay afterwards; decode a logic-analyzer capture of the pin
+ *     with sim/trace-decode
+ *   - without USE_TRACE, none of it is compiled in
+ *   - not with USE_GESTURES (a hold is a long press there), or on the
+ *     pic10f320 (whose switch read cannot see a switch that is held down)
+ *
+ * USE_WAKE_STATS
+ *   - the core counts its wake-ups (stats_wakes), those rejected by the
+ *     quick check (stats_rejected, see DEBOUNCE_QUICK_READS) and the
+ *     presses accepted (stats_presses), in 16-bit counters that wrap
+ *     around; the rest were rejected by the debounce proper
+ *   - for the host simulation (sim/bench-press-stats), or a debugger:
+ *     there is no way to read them out otherwise
+ *
+ * USE_POWER_FAIL
+ *   - a power-good input (a divider from the unregulated supply, ahead of
+ *     the regulator, or a supervisor's open-drain output) warns of the
+ *     supply going away while the bulk capacitor still holds the mcu's
+ *     rail; its interrupt preempts whatever the core is doing (debounce,
+ *     coil pulse, lockout, EEPROM write, sleep), and calls power_fail(),
+ *     which drives the relay to OFF (bypass) with a full
+ *     RELAY_RESET_PULSE_MS pulse and never returns: the relay is in bypass
+ *     while the pedal is unpowered
+ *   - the interrupt stays armed while the core is awake
+ *     (MRC_switch_wake_disarm() only disarms the switch), so the worst-case
+ *     latency is the wake-up from power-down, or the longest other
+ *     interrupt service routine, plus the entry into power_fail(); see
+ *     sim/bench-powerfail for each target's
+ *   - the bulk capacitor must hold the coil's must-operate voltage for that
+ *     latency plus RELAY_RESET_PULSE_MS: C >= I_coil * t / (V_good - V_min),
+ *     e.g. a TQ2-L-5V (28mA) from 5V down to 3.75V over 16ms: 360uF
+ *   - the saved state (USE_PERSIST) is not touched: there is no time for an
+ *     EEPROM write, and the relay still comes back in it at power-up
+ *   - requires MRC_power_fail_halt() and a power-good pin: the ATtiny's PB4
+ *     (so not with USE_MUTE there), the pic12f675's GP3; not on the
+ *     pic10f320, which has neither a free pin nor a low-voltage detect
+ *     interrupt (its brown-out detector can only reset it)
+ *
+ * USE_NON_LATCHING
+ *   - drives a non-latching (monostable) relay, energized while ON: the set
+ *     pulse is the pull-in, at full current for RELAY_SET_PULSE_MS, after
+ *     which the coil is held at RELAY_HOLD_PERCENT duty by a hardware PWM
+ *     until the relay is reset; the reset unpowers the coil, and waits
+ *     RELAY_RESET_PULSE_MS for the contacts to drop out (the mute, if any,
+ *     still covers them)
+ *   - the coil needs a flyback diode across it, which the PWM relies on:
+ *     the coil current freewheels through it while the pin is low, so the
+ *     supply only delivers it for the duty cycle; the saving is about
+ *     (100 - RELAY_HOLD_PERCENT)% of the coil current for as long as the
+ *     relay is ON (e.g. 14mA of a TQ2-5V's 28mA at 50%), less what the
+ *     mcu draws for not sleeping as deeply: the PWM needs its clock (see
+ *     sim/bench-energy-hold for each target)
+ *   - the PWM is ~20kHz, above the audio band, at either clock profile
+ *     (USE_CLOCK_SCALING)
+ *   - with USE_POWER_FAIL, power_fail() just unpowers the coil: the relay
+ *     drops out to OFF (bypass) by itself, and needs no bulk capacitor
+ *   - coil pin2 is not used
+ *   - requires MRC_relay_hold_start() and MRC_relay_hold_stop(); the
+ *     ATtiny85 uses Timer1 on ~OC1B (PB3, coil pin1), so not with USE_MUTE
+ *     there (OC1B is PB4); the pic10f320 uses PWM2, on RA1, which becomes
+ *     the coil pin; the pic12f675 has no PWM, and holds the coil at full
+ *     current; not on the ATtiny13 (Timer0 is its only timer, and its
+ *     outputs are the switch and LED pins)
+ *
+ * USE_LED_DIM
+ *   - the status LED, which is otherwise lit steadily for as long as the
+ *     relay is ON, is dimmed to LED_DIM_PERCENT while the mcu sleeps, i.e.
+ *     nearly all of that time; a lit LED (~2mA) draws thousands of times
+ *     what the mcu does in power-down, and is the bulk of the average
+ *     current with the relay ON (a latching one).  it is at full brightness
+ *     while the mcu is awake (a press and its lockout), so the core keeps
+ *     driving it as before
+ *   - LED_DIM_PWM: a timer drives the LED pin; the timer needs its clock,
+ *     so the mcu sleeps in idle mode rather than power-down (or stays
+ *     awake, where there is no idle mode)
+ *   - LED_DIM_WDT: the mcu stays in power-down, and the watchdog wakes it
+ *     every period (16ms on the ATtiny) to light the LED for
+ *     LED_DIM_PERCENT of one; the cpu runs for the pulse, so it is the
+ *     cheaper of the two at low brightness only, and the LED flickers at
+ *     the watchdog's rate (~60Hz)
+ *   - sim/bench-energy-dim compares both against the LED at full
+ *     brightness, for each target, at a few brightness settings
+ *   - requires MRC_led_dim_start() and MRC_led_dim_stop(); the ATtiny
+ *     uses Timer0 on OC0B (PB1, the LED pin), which is free while the mcu
+ *     sleeps, or the watchdog; the pic10f320 uses PWM1 (RA0, the LED pin),
+ *     and stays awake while it runs (Timer2 stops in SLEEP), LED_DIM_PWM
+ *     only; not on the pic12f675, which has no PWM
+ *
+ * MRC_INLINE_HAL
+ *   - not a feature but a build form: the target's header provides the pin
+ *     operations (LED, mute, relay coil and switch pins) as macros, so each
+ *     compiles to the one or two instructions it takes at the call site,
+ *     instead of a call into the target's .c file; the rest of the HAL stays
+ *     out of line
+ *   - on the ATtiny, a call and return costs 7 cycles (rcall, ret), plus the
+ *     registers the caller must assume clobbered; make LTO=1 (whole-program
+ *     build, see the Makefile) gets most of the same from avr-gcc without
+ *     it, but not from xc8, where this is the only way
+ *   - estimated, from the instruction set rather than measured: the core's
+ *     20 pin-operation call sites and the 11 bodies they call come to
+ *     roughly 50 bytes less of the ATtiny13's 1KB inline, and
+ *     sim/bench-press's ~84 pin operations per press to ~588 cycles of
+ *     call/return saved (0.6ms at 1MHz); make sizes measures the ATtiny
+ *     builds where avr-gcc is installed
+ *   - targets without an inline form (hostsim) ignore it
+ *
+ * USE_MIDI
+ *   - remote control from a MIDI input (31250 baud, through the usual
+ *     optocoupler): Program Change and Control Change messages on
+ *     MIDI_CHANNEL switch the relay OFF, ON, or toggle it (see MIDI_CC,
+ *     MIDI_PROGRAM_OFF and the like), running status included; anything
+ *     else (other channels and messages, System Exclusive, real-time bytes
+ *     such as MIDI clock) is ignored
+ *   - a command goes through the same relay_toggle() as a press, so the
+ *     LED, mute and saved state (USE_PERSIST) follow it alike; ON while the
+ *     relay is ON (OFF while OFF) does nothing
+ *   - the first byte of a message wakes the mcu, and a wake-up by the MIDI
+ *     input alone skips the debounce; while a press keeps the core awake
+ *     (debounce, lockout), it takes the received bytes every ms, so neither
+ *     waits for the other: in the lockout, a command is acted on within a
+ *     ms or so, or once the coil pulse in progress is over; while the
+ *     debounce reads the switch, commands are only noted, and acted on
+ *     (what they add up to) right after the press's own coil pulse, which
+ *     they do not delay (sim/bench-midi measures both, from the command's
+ *     last byte to its coil edge, and from the press to its own)
+ *   - requires MRC_midi_get() and a MIDI input: the ATtiny85 receives with
+ *     its USI on DI (PB0), clocked by Timer0, at 8MHz (F_CPU=8000000UL,
+ *     the CKDIV8 fuse unprogrammed), and the switch moves to PB4;
+ *     so not with USE_MUTE or USE_POWER_FAIL (PB4), USE_LOWPOWER_SLEEP or
+ *     USE_LED_DIM (Timer0), USE_CLOCK_SCALING (the bit timing) or USE_TRACE
+ *     (the receiver's interrupts would stretch the dump's bits) there; not
+ *     on the ATtiny13 (no USI), or the pics (no serial input)
+ *   - not with USE_SCHEDULER or USE_TIMER_DEBOUNCE (the receiver is served
+ *     from the busy-wait loops), or USE_GESTURES (whose undo of a tap would
+ *     undo a command in between instead)
+ *
+ * USE_ADAPTIVE_DEBOUNCE
+ *   - the debounce learns the footswitch, rather than assuming the worst
+ *     one: on every wake-up, the integrator notes the longest stretch of
+ *     low reads a high read broke off (bounce, or noise) and, for a press,
+ *     the last read it found high (how long the press bounced); the low
+ *     reads a press needs, and the post-press lockout, follow from those
+ *     (see DEBOUNCE_ADAPT_MIN_READS)
+ *   - both start at the fixed values, grow at once to whatever a wake-up
+ *     shows the switch needs, and come down one step at a time while the
+ *     switch does better: a clean switch gets a press through in
+ *     DEBOUNCE_ADAPT_MIN_READS ms rather than eight, and a lockout of one
+ *     LOCKOUT_POLL_MS takes a fast double press the fixed 100ms would
+ *     drop; as it wears, they grow back
+ *   - a few bytes of RAM; with USE_PERSIST, what was learned is kept in
+ *     the last cell of the data EEPROM (the relay state ring gets one cell
+ *     fewer), written when it changes, and read back at power-up
+ *   - the busy-wait integrator only: not with USE_TIMER_DEBOUNCE,
+ *     USE_SCHEDULER or DEBOUNCE_LEADING_EDGE (sim/bench-adapt replays an
+ *     ageing switch against the fixed debounce)
+ */
+
+/*
+ * DEBOUNCE_STRATEGY, one of:
+ *
+ * DEBOUNCE_INTEGRATOR (default)
+ *   - shift-register integrator: the press is accepted after eight
+ *     consecutive low reads, 1ms apart (i.e. at least ~7ms after the press)
+ *   - a wake-up that fails the quick check (see DEBOUNCE_QUICK_READS) does
+ *     not get that far, so a glitch costs microseconds awake, rather than
+ *     up to MAX_N_SWITCH_DEBOUNCE_READS ms
+ * DEBOUNCE_LEADING_EDGE
+ *   - act on the first edge: the press is accepted if the switch reads low
+ *     on wake-up and again DEBOUNCE_CONFIRM_US later, then the pin is
+ *     ignored for SWITCH_DEBOUNCE_TIME_MS
+ *   - lowest latency, but a glitch longer than DEBOUNCE_CONFIRM_US toggles
+ *     the relay
+ * DEBOUNCE_HYBRID
+ *   - act on the first edge like DEBOUNCE_LEADING_EDGE, then run the
+ *     integrator; if it does not confirm the press, the relay is toggled
+ *     back (a glitch costs two coil pulses, rather than a wrong state)
+ *   - no quick check: a wake-up that fails the leading-edge check runs the
+ *     integrator, which sits out the bounce of a release; with the mcu back
+ *     asleep at once, a later bounce edge would pass the leading-edge check
+ */
+#define DEBOUNCE_INTEGRATOR   0
+#define DEBOUNCE_LEADING_EDGE 1
+#define DEBOUNCE_HYBRID       2
+#ifndef DEBOUNCE_STRATEGY
+#  define DEBOUNCE_STRATEGY DEBOUNCE_INTEGRATOR
+#endif
+#if defined(USE_TIMER_DEBOUNCE) && (DEBOUNCE_STRATEGY == DEBOUNCE_LEADING_EDGE)
+#  error "USE_TIMER_DEBOUNCE requires an integrating DEBOUNCE_STRATEGY"
+#endif
+
+#if defined(USE_TRACE) && defined(USE_GESTURES)
+#  error "USE_TRACE: not with USE_GESTURES, where the dump's hold is a long press"
+#endif
+#if defined(USE_TRACE) && \
+    ((TRACE_RING_SIZE < 1) || (TRACE_RING_SIZE > 64) || (TRACE_RING_SIZE & (TRACE_RING_SIZE - 1)))
+#  error "USE_TRACE: TRACE_RING_SIZE must be a power of two, 1..64"
+#endif
+
+#if defined(USE_MIDI) && \
+    (defined(USE_SCHEDULER) || defined(USE_TIMER_DEBOUNCE) || defined(USE_GESTURES))
+#  error "USE_MIDI: not with USE_SCHEDULER, USE_TIMER_DEBOUNCE or USE_GESTURES"
+#endif
+
+#if defined(USE_ADAPTIVE_DEBOUNCE) && \
+    (defined(USE_SCHEDULER) || defined(USE_TIMER_DEBOUNCE) || \
+     (DEBOUNCE_STRATEGY == DEBOUNCE_LEADING_EDGE))
+#  error "USE_ADAPTIVE_DEBOUNCE: the busy-wait integrator only, not with USE_SCHEDULER, USE_TIMER_DEBOUNCE or DEBOUNCE_LEADING_EDGE"
+#endif
+
+#if defined(USE_MUTE) && (MUTE_POST_US >= 1000)
+#  error "USE_MUTE: MUTE_POST_US must be less than 1000"
+#endif
+
+// features that need the periodic timer interrupt
+#if defined(USE_TIMER_DEBOUNCE) || defined(USE_SCHEDULER)
+#  define USE_TIMER_TICK
+#endif
+
+#if defined(USE_SCHEDULER) && \
+    ((RELAY_SETTLE_TIME_MS + SWITCH_DEBOUNCE_TIME_MS) / TIMER_TICK_MS + 1 > 255)
+#  error "USE_SCHEDULER: lockout deadline does not fit in the deadline table"
+#endif
+
+
 /*
  * abstractions for hardware-specific functionality
  *
@@ -69,7 +710,7 @@
 
 // called at program startup
 // generally, this should do things such as:
-//    - any startup delay
+//    - any startup delay (STARTUP_DELAY_MS, see USE_FAST_BOOT)
 //    - setup IO pins
 //    - set initial state of device (currently assumed to be OFF)
 //    - set appropriate wake-on-pin-change interrupts
@@ -77,12 +718,121 @@
 void MRC_hardware_init(void);
 
 // sleep and interrupt related
-// note that MRC_sleep_millisecs() is a macro, rather than a function
-void MRC_disable_interrupts(void);
+// note that MRC_sleep_millisecs() and MRC_sleep_microsecs() are macros,
+// rather than functions
+//   - MRC_switch_wake_disarm(): on wake-up, before the debounce (and after
+//     the timer's debounce wait): the switch's changes while awake do no
+//     more than get recorded (see MRC_switch_pin_clear_int_flags()); other
+//     interrupts (the power-good pin, the MIDI input) may stay enabled
+//   - MRC_enter_sleep_mode(): arm the switch's wake-up and sleep, as one
+//     operation: a switch change at any point since the last
+//     MRC_switch_pin_clear_int_flags(), including one that comes while this
+//     is getting ready to sleep, wakes the mcu at once (or keeps it from
+//     sleeping); returns once awake
+void MRC_switch_wake_disarm(void);
 void MRC_disable_sleep(void);
-void MRC_enable_interrupts(void);
 void MRC_enter_sleep_mode(void);
 #undef MRC_sleep_millisecs
+#undef MRC_sleep_microsecs
+
+// low-power delay (USE_LOWPOWER_SLEEP)
+//   - MRC_sleep_lowpower_ms(): wait ms (a run-time value) in the deepest
+//     sleep mode that keeps the outputs as they are and a wake source
+//     running; as with MRC_sleep_millisecs(), a switch edge does not end the
+//     wait, and is still pending afterwards
+//   - not called while the periodic timer runs
+//   - mcus without a suitable wake source may simply spin
+void MRC_sleep_lowpower_ms(uint16_t ms);
+
+// periodic timer (USE_TIMER_TICK)
+//   - MRC_timer_start(): start an interrupt every TIMER_TICK_MS, and enable
+//     interrupts; the interrupt service routine must call timer_tick()
+//   - MRC_timer_stop(): stop the periodic interrupt
+//   - MRC_enter_idle_mode(): lightest sleep mode, in which the timer keeps
+//     running; returns after the next interrupt has been serviced (on mcus
+//     without such a sleep mode, this may simply return)
+void MRC_timer_start(void);
+void MRC_timer_stop(void);
+void MRC_enter_idle_mode(void);
+
+// clock scaling (USE_CLOCK_SCALING)
+//   - MRC_set_clock_profile(CLOCK_PROFILE_LOW): switch to the slowest clock
+//     that still keeps up with the core (1ms switch sampling)
+//   - MRC_set_clock_profile(CLOCK_PROFILE_NORMAL): back to the clock the
+//     firmware was built for
+//   - MRC_sleep_millisecs()/MRC_sleep_microsecs() and the periodic timer
+//     must keep their timing in either profile
+//   - mcus that cannot change their clock at run time implement this as a
+//     no-op
+#define CLOCK_PROFILE_NORMAL 0
+#define CLOCK_PROFILE_LOW    1
+void MRC_set_clock_profile(uint8_t profile);
+
+// supply voltage (USE_VCC_COMPENSATION)
+//   - MRC_supply_millivolts(): measure the supply voltage (e.g. against the
+//     mcu's internal bandgap reference); called just before each relay coil
+//     pulse
+uint16_t MRC_supply_millivolts(void);
+
+// data EEPROM (USE_PERSIST), MRC_EEPROM_SIZE bytes (a macro in the target's
+// header)
+//   - MRC_eeprom_read(): read a byte (waits for a write in progress)
+//   - MRC_eeprom_write_start(): start writing a byte, and return without
+//     waiting for the write to complete
+//   - MRC_eeprom_wait(): sleep until a write started earlier is complete;
+//     called before power-down sleep (an AVR that enters power-down with an
+//     EEPROM write in progress keeps its oscillator running), and returns
+//     with interrupts as they were (USE_POWER_FAIL: the core may run on
+//     for a while after it)
+uint8_t MRC_eeprom_read(uint16_t addr);
+void MRC_eeprom_write_start(uint16_t addr, uint8_t value);
+void MRC_eeprom_wait(void);
+
+// power-fail early warning (USE_POWER_FAIL)
+//   - MRC_hardware_init() arms an interrupt on the power-good pin going low,
+//     which stays enabled from then on, whatever the other functions here
+//     do with the switch interrupt; its service routine calls power_fail()
+//     (also at arming, if the pin is low already)
+//   - MRC_power_fail_halt(): called by power_fail() once the relay is in
+//     bypass, from the interrupt; never returns: waits for the supply to
+//     die, or, if it was only a dip and the power-good pin comes back,
+//     restarts the firmware from reset
+void MRC_power_fail_halt(void);
+
+// non-latching relay hold (USE_NON_LATCHING)
+//   - MRC_relay_hold_start(): coil pin1 is high (the pull-in is over):
+//     switch it to a PWM at RELAY_HOLD_PERCENT duty, which keeps running in
+//     MRC_enter_sleep_mode() and MRC_sleep_lowpower_ms() (these sleep less
+//     deeply while it does, if they must) and across clock profile changes
+//   - MRC_relay_hold_stop(): stop the PWM, with coil pin1 low; does nothing
+//     if it is not running
+//   - mcus without a PWM on the coil pin may leave the pin high, i.e. hold
+//     at full current
+void MRC_relay_hold_start(void);
+void MRC_relay_hold_stop(void);
+
+// dimmed status LED (USE_LED_DIM)
+//   - MRC_led_dim_start(): the LED pin is high (lit): dim it to
+//     LED_DIM_PERCENT by LED_DIM_METHOD; called just before
+//     MRC_enter_sleep_mode(), which sleeps less deeply while a PWM runs, if
+//     it must
+//   - MRC_led_dim_stop(): back to the LED pin's own level (high); does
+//     nothing if the LED is not dimmed; also called from power_fail()
+void MRC_led_dim_start(void);
+void MRC_led_dim_stop(void);
+
+// MIDI input (USE_MIDI)
+//   - MRC_midi_get(): take the oldest byte received, if any: returns TRUE
+//     with it in *byte, FALSE if there is none; bytes are buffered from the
+//     line in the background, whatever the core is doing, and a byte
+//     arriving (or on the way) wakes MRC_enter_sleep_mode() (but not
+//     MRC_sleep_millisecs())
+//   - if bytes were lost to a full buffer, MIDI_RX_LOST is handed over in
+//     their place, before the bytes that follow; it is a status byte
+//     (System Common, undefined), so the parser drops the message it was
+//     in the middle of, instead of taking the next one's bytes for it
+#define MIDI_RX_LOST 0xF4
+uint8_t MRC_midi_get(uint8_t* byte);
 
 // status indicator LED functionality, toggle state of the pin connected to
 // the status LED; convention used here:
@@ -92,18 +842,39 @@ void MRC_led_pin_set_high(void); // i.e. turn LED on
 void MRC_led_pin_set_low(void);  // i.e. turn LED off
 void MRC_led_toggle(void); // flip state (typically can be done with a single NOR expression)
 
+// audio mute (USE_MUTE): the mute output is active high
+//   high => signal muted
+//   low  => signal passes
+void MRC_mute_pin_set_high(void);
+void MRC_mute_pin_set_low(void);
+
 // relay control: two pins are used for relay coil control of a *latching*
 // relay (this could be a single-coil latching relay, or a dual-coil latching
 // relay); call these pins "pin1" and "pin2", then:
-//   activate   => pin1 held high for RELAY_SETTLE_TIME_MS, then set low
+//   activate   => pin1 held high for RELAY_SET_PULSE_MS, then set low
 //                 pin2 kept low
 //   deactivate => pin1 kept low
-//                 pin2 held high for RELAY_SETTLE_TIME_MS, then set low
+//                 pin2 held high for RELAY_RESET_PULSE_MS, then set low
+// (a non-latching relay, USE_NON_LATCHING, uses pin1 only)
 void MRC_relay_coil_pin1_set_high(void);
 void MRC_relay_coil_pin1_set_low(void);
 void MRC_relay_coil_pin2_set_high(void);
 void MRC_relay_coil_pin2_set_low(void);
 
+// combined output update: set the outputs in set and clear the ones in
+// clear (which must not overlap), all in one write of the output port, so
+// that they change on the same instruction; the masks are made of
+// MRC_PORT_LED, MRC_PORT_MUTE, MRC_PORT_COIL1 and MRC_PORT_COIL2 (macros in
+// the target's header, the outputs' bits in its port; 0 for an output the
+// target does not have)
+//   - the single-pin functions above must keep to the same port image,
+//     e.g. a shadow register on mcus whose port reads return the pin levels
+//     (pic12f675), so that a combined update does not write back a stale or
+//     misread level of another output
+//   - single channel only (the multi-channel functions below already take
+//     masks)
+void MRC_port_apply(uint8_t set, uint8_t clear);
+
 // momentary-switch connected pin: is it high or low?
 // convention used here: the momentary switch pin will normally be kept high
 // (e.g. via pullup resistor); with the switch is pressed, it will force the
@@ -113,7 +884,63 @@ uint8_t MRC_switch_pin_get_state(void);
 
 // some micro-controllers (e.g. pic10f320) set a flag when an interrupt is
 // triggered, and that flag needs to be cleared after it is read.
+//   - more generally, the switch pin's changes are recorded from here on
+//     (a pin-change flag, or the interrupt service routine's own), whether
+//     or not the switch interrupt is enabled, until the next call; with a
+//     single channel, the core calls this at the end of a lockout in which
+//     the switch stayed down, and otherwise leaves it to
+//     MRC_switch_press_pending()
+//   - the pic10f320 records falling edges only
 void MRC_switch_pin_clear_int_flags(void);
 
+// pending-press check, before sleep (single channel only): the switch has
+// changed since the record was last cleared, and reads LOW now, i.e. a
+// press came during the lockout or a rejected debounce (and is still held),
+// which no further edge may wake the mcu for; clears the record, unless the
+// switch read depends on it (pic10f320)
+//   - race-free: the record is cleared only if it was set, and the pin is
+//     read after that, so a change at any point is either seen here or left
+//     recorded for MRC_enter_sleep_mode()
+uint8_t MRC_switch_press_pending(void);
+
+// multi-channel (MRC_N_CHANNELS > 1), used instead of the switch, relay coil
+// and LED functions above; bit n of each mask is channel n
+//   - MRC_switch_pins_get_state(): all switch pins in one read, bit set =
+//     HIGH (released)
+//   - MRC_relay_coils_drive(): energize the coils of the channels in mask,
+//     towards state (ON: set/activate, OFF: reset/deactivate); the coils of
+//     the other channels stay unpowered
+//   - MRC_relay_coils_release(): de-energize all coils
+//   - MRC_leds_set(): status LEDs, bit set = lit (may be empty, e.g. where
+//     the LEDs are switched by a spare relay pole)
+uint8_t MRC_switch_pins_get_state(void);
+void MRC_relay_coils_drive(uint8_t mask, uint8_t state);
+void MRC_relay_coils_release(void);
+void MRC_leds_set(uint8_t mask);
+
+// power accounting (optional, for measurement only)
+// - the core marks the start and end of each of the activities below by
+//   calling MRC_power_state(state, TRUE/FALSE); spans may nest (e.g. the
+//   coil pulse within the lockout)
+// - a target that wants to attribute time and energy to them defines
+//   MRC_power_state() as a macro in its header; when it is not defined (all
+//   real mcus), the marks compile to nothing
+// - sleep, and the LED being lit, are visible at the pins and need no marks
+#define POWER_STATE_DEBOUNCE 0 // awake, deciding whether a wake-up is a press
+#define POWER_STATE_COIL     1 // relay coil energized
+#define POWER_STATE_LOCKOUT  2 // post-press lockout
+#define POWER_N_STATES       3
+
+
+/*
+ * implemented by the core, called from hardware interrupt service routines
+ */
+
+// periodic timer interrupt (USE_TIMER_TICK)
+void timer_tick(void);
+
+// power-good pin gone low (USE_POWER_FAIL); never returns
+void power_fail(void);
+
 #endif // MCU_RELAY_CONTROLLER_IFACE_H__
 
@@ -19,6 +19,9 @@
 #ifdef IMPL_DUMMY
 #  include "hardware-details/dummy.h"
 #endif
+#ifdef IMPL_HOSTSIM
+#  include "hardware-details/hostsim.h"
+#endif
 #ifdef IMPL_ATTINY
 #  include "hardware-details/attiny.h"
 #endif
@@ -29,23 +32,301 @@
 #  include "hardware-details/pic10f320.h"
 #endif
 
+// power accounting: mark the span of each POWER_STATE_* activity; these
+// compile to nothing unless the target provides MRC_power_state()
+#ifdef MRC_power_state
+#  define POWER_STATE_BEGIN(s) MRC_power_state((s), TRUE)
+#  define POWER_STATE_END(s)   MRC_power_state((s), FALSE)
+#else
+#  define POWER_STATE_BEGIN(s) do { } while(0)
+#  define POWER_STATE_END(s)   do { } while(0)
+#endif
+
+// clock scaling: slow clock while only waiting (USE_CLOCK_SCALING)
+#ifdef USE_CLOCK_SCALING
+#  define CLOCK_LOW()    MRC_set_clock_profile(CLOCK_PROFILE_LOW)
+#  define CLOCK_NORMAL() MRC_set_clock_profile(CLOCK_PROFILE_NORMAL)
+#else
+#  define CLOCK_LOW()    do { } while(0)
+#  define CLOCK_NORMAL() do { } while(0)
+#endif
+
+// delays that need no better than 1ms accuracy: sleep through them
+// (USE_LOWPOWER_SLEEP)
+#ifdef USE_LOWPOWER_SLEEP
+#  define SLEEP_LOWPOWER_MS(n) MRC_sleep_lowpower_ms(n)
+#else
+#  define SLEEP_LOWPOWER_MS(n) MRC_sleep_millisecs(n)
+#endif
+
+// the status LED, lit while the relay is ON, is dimmed while the mcu sleeps
+// (USE_LED_DIM)
+#ifdef USE_LED_DIM
+#  define LED_DIM_START() do { if (ON == relay_state) { MRC_led_dim_start(); } } while(0)
+#  define LED_DIM_STOP()  MRC_led_dim_stop()
+#else
+#  define LED_DIM_START() do { } while(0)
+#  define LED_DIM_STOP()  do { } while(0)
+#endif // USE_LED_DIM
+
 
-// the relay has two states, which we'll call ON or OFF
+// the relay has two states, which we'll call ON or OFF; with more than one
+// channel, bit n is the state of channel n (ON == bit 0 set)
 volatile uint8_t relay_state = OFF;
 
+#ifdef USE_VCC_COMPENSATION
+// width of the next coil pulse, set by relay_pulse_measure()
+uint8_t relay_pulse_ms;
+
+// scale a profile pulse width (enough at RELAY_MIN_OPERATE_MV) to the
+// supply: coil current, and so the force on the armature, is proportional
+// to the voltage across the coil
+void relay_pulse_measure(uint8_t nominal_ms)
+{
+    uint16_t mv = MRC_supply_millivolts();
+    if (0 == mv) { mv = 1; }
+
+    // rounded up: a pulse that is too short leaves the relay where it was
+    uint32_t ms = ((uint32_t)nominal_ms * RELAY_MIN_OPERATE_MV + mv - 1) / mv;
+
+    if (ms < RELAY_OPERATE_MS) { ms = RELAY_OPERATE_MS; }
+    if (ms > 2 * nominal_ms)   { ms = 2 * nominal_ms;   }
+    relay_pulse_ms = (uint8_t)ms;
+}
+
+// the width is only known at run time, so wait in 1ms steps
+void relay_pulse_wait(void)
+{
+#ifdef USE_LOWPOWER_SLEEP
+    MRC_sleep_lowpower_ms(relay_pulse_ms);
+#else
+    for (uint8_t i=relay_pulse_ms; i; --i) { MRC_sleep_millisecs(1); }
+#endif // USE_LOWPOWER_SLEEP
+}
+
+#  define relay_pulse_width(nominal_ms) (relay_pulse_ms)
+#  define RELAY_PULSE_WAIT(nominal_ms)  relay_pulse_wait()
+#else
+#  define relay_pulse_measure(nominal_ms) do { } while(0)
+#  define relay_pulse_width(nominal_ms) (nominal_ms)
+#  define RELAY_PULSE_WAIT(nominal_ms)  SLEEP_LOWPOWER_MS(nominal_ms)
+#endif // USE_VCC_COMPENSATION
+
+#if MRC_N_CHANNELS == 1
+
+#ifdef USE_TRACE
+
+// event trace (see USE_TRACE): a ring of two-byte records, the newest at
+// trace_head - 1
+uint8_t trace_ring[2 * TRACE_RING_SIZE];
+uint8_t trace_head;
+uint8_t trace_count;
+uint8_t trace_wakes;
+uint8_t trace_reads;       // integrator reads of this wake-up
+volatile uint8_t trace_ms; // since the wake-up, saturating at 255
+
+void trace_event(uint8_t event, uint8_t arg)
+{
+    uint8_t* rec = &trace_ring[2 * trace_head];
+    rec[0] = (uint8_t)(event << 5) | (trace_ms / TRACE_TIME_MS);
+    rec[1] = arg;
+    trace_head = (trace_head + 1) & (TRACE_RING_SIZE - 1);
+    if (trace_count < TRACE_RING_SIZE) { ++trace_count; }
+}
+
+void trace_wake(void)
+{
+    trace_ms = 0;
+    trace_reads = 0;
+    trace_event(TRACE_EV_WAKE, ++trace_wakes);
+}
+
+// account for a wait of ms that has just ended
+void trace_wait_ms(uint8_t ms)
+{
+    uint16_t t = trace_ms + ms;
+    trace_ms = t > 255 ? 255 : (uint8_t)t;
+}
+
+// one 8N1 frame on the LED pin, least significant bit first
+void trace_tx_byte(uint8_t b)
+{
+    MRC_led_pin_set_low(); // start bit
+    MRC_sleep_microsecs(TRACE_BIT_US);
+    for (uint8_t i=0; i<8; ++i)
+    {
+        if (b & 1) { MRC_led_pin_set_high(); }
+        else       { MRC_led_pin_set_low();  }
+        MRC_sleep_microsecs(TRACE_BIT_US);
+        b >>= 1;
+    }
+    MRC_led_pin_set_high(); // stop bit
+    MRC_sleep_microsecs(TRACE_BIT_US);
+}
+
+// send the ring, oldest record first, and empty it
+void trace_dump(void)
+{
+    // the line idles high: give the receiver a frame of it first
+    MRC_led_pin_set_high();
+    for (uint8_t i=0; i<10; ++i) { MRC_sleep_microsecs(TRACE_BIT_US); }
+
+    trace_tx_byte(TRACE_SYNC);
+    trace_tx_byte(TRACE_MAGIC);
+    trace_tx_byte(trace_count);
+    uint8_t check = trace_count;
+    uint8_t pos = (trace_head - trace_count) & (TRACE_RING_SIZE - 1);
+    for (uint8_t n=trace_count; n; --n)
+    {
+        uint8_t* rec = &trace_ring[2 * pos];
+        trace_tx_byte(rec[0]);
+        trace_tx_byte(rec[1]);
+        check ^= rec[0] ^ rec[1];
+        pos = (pos + 1) & (TRACE_RING_SIZE - 1);
+    }
+    trace_tx_byte(check);
+    trace_count = 0;
+
+    if (ON == relay_state) { MRC_led_pin_set_high(); }
+    else                   { MRC_led_pin_set_low();  }
+}
+
+// a press still held down TRACE_DUMP_HOLD_MS after it started dumps the
+// ring (the debounce, coil pulse and lockout count towards the hold)
+#define TRACE_HOLD_POLL_MS 10
+void trace_dump_if_held(void)
+{
+    for (uint16_t ms=trace_ms; ms<TRACE_DUMP_HOLD_MS; ms+=TRACE_HOLD_POLL_MS)
+    {
+        if (LOW != MRC_switch_pin_get_state()) { return; }
+        SLEEP_LOWPOWER_MS(TRACE_HOLD_POLL_MS);
+    }
+    trace_dump();
+}
+
+#  define TRACE(event, arg)  trace_event((event), (arg))
+#  define TRACE_WAKE()       trace_wake()
+#  define TRACE_DUMP_IF_HELD(pressed) do { if (pressed) { trace_dump_if_held(); } } while(0)
+#  ifdef USE_SCHEDULER
+// the timer runs whenever the core is awake, and counts the time instead
+#    define TRACE_WAIT_MS(ms) do { } while(0)
+#  else
+#    define TRACE_WAIT_MS(ms) trace_wait_ms(ms)
+#  endif // USE_SCHEDULER
+#  define TRACE_READS(n)     do { trace_reads = (n); TRACE_WAIT_MS(n); } while(0)
+#else
+#  define TRACE(event, arg)  do { } while(0)
+#  define TRACE_WAKE()       do { } while(0)
+#  define TRACE_DUMP_IF_HELD(pressed) do { } while(0)
+#  define TRACE_WAIT_MS(ms)  do { } while(0)
+#  define TRACE_READS(n)     do { } while(0)
+#endif // USE_TRACE
+
+#ifdef USE_WAKE_STATS
+// wake-up counters (see USE_WAKE_STATS)
+uint16_t stats_wakes;
+uint16_t stats_rejected;
+uint16_t stats_presses;
+#  define STATS_WAKE()            (++stats_wakes)
+#  define STATS_QUICK_REJECT()    (++stats_rejected)
+#  define STATS_PRESS_IF(pressed) do { if (pressed) { ++stats_presses; } } while(0)
+#else
+#  define STATS_WAKE()            do { } while(0)
+#  define STATS_QUICK_REJECT()    do { } while(0)
+#  define STATS_PRESS_IF(pressed) do { } while(0)
+#endif // USE_WAKE_STATS
+
+#ifdef USE_MUTE
+// set when the coil pulse ended before the mute could be released
+uint8_t mute_pending;
+
+void mute_begin(void)
+{
+    MRC_mute_pin_set_high();
+    MRC_sleep_microsecs(MUTE_PRE_US);
+}
+
+// hold a coil pulse of pulse_ms (at least RELAY_OPERATE_MS) that has just
+// started: the contacts are at rest RELAY_OPERATE_MS into it, and the mute
+// is released MUTE_POST_US after that, if the pulse is still running then
+// (otherwise by mute_end(), right after the pulse)
+void relay_pulse_hold_muted(uint8_t pulse_ms)
+{
+    MRC_sleep_millisecs(RELAY_OPERATE_MS);
+    uint8_t extra_ms = pulse_ms - RELAY_OPERATE_MS;
+    mute_pending = (0 == extra_ms);
+    if (mute_pending) { return; }
+
+    MRC_sleep_microsecs(MUTE_POST_US);
+    MRC_mute_pin_set_low();
+    MRC_sleep_microsecs(1000 - MUTE_POST_US);
+#ifdef USE_LOWPOWER_SLEEP
+    MRC_sleep_lowpower_ms(extra_ms - 1);
+#else
+    while (--extra_ms) { MRC_sleep_millisecs(1); }
+#endif // USE_LOWPOWER_SLEEP
+}
+
+void mute_end(void)
+{
+    if (!mute_pending) { return; }
+    MRC_sleep_microsecs(MUTE_POST_US);
+    MRC_mute_pin_set_low();
+}
+
+#  define MUTE_BEGIN() mute_begin()
+#  define MUTE_END()   mute_end()
+#  undef RELAY_PULSE_WAIT
+#  define RELAY_PULSE_WAIT(nominal_ms) relay_pulse_hold_muted(relay_pulse_width(nominal_ms))
+#else
+#  define MUTE_BEGIN() do { } while(0)
+#  define MUTE_END()   do { } while(0)
+#endif // USE_MUTE
+
+// the end of the set pulse, and the reset pulse: a latching relay's coil is
+// unpowered after the set pulse, a non-latching relay's is switched to the
+// hold current; a non-latching relay is reset by unpowering its coil (with
+// the LED in the same port write, as the reset pulse; the hold may not have
+// started yet), and it drops out in the time of the reset pulse
+#ifdef USE_NON_LATCHING
+#  define RELAY_SET_END()     MRC_relay_hold_start()
+#  define RELAY_RESET_START() do { MRC_relay_hold_stop(); MRC_port_apply(0, MRC_PORT_COIL1 | MRC_PORT_LED); } while(0)
+#  define RELAY_RESET_END()   do { } while(0)
+#else
+#  define RELAY_SET_END()     MRC_relay_coil_pin1_set_low()
+#  define RELAY_RESET_START() MRC_port_apply(MRC_PORT_COIL2, MRC_PORT_LED)
+#  define RELAY_RESET_END()   MRC_relay_coil_pin2_set_low()
+#endif // USE_NON_LATCHING
+
+// the status LED follows the relay: it is switched in the same port write
+// that starts the coil pulse
 void relay_activate(void) // aka "set"
 {
-    MRC_relay_coil_pin1_set_high();
-    MRC_sleep_millisecs(RELAY_SETTLE_TIME_MS);
-    MRC_relay_coil_pin1_set_low();
+    relay_pulse_measure(RELAY_SET_PULSE_MS);
+    MUTE_BEGIN();
+    POWER_STATE_BEGIN(POWER_STATE_COIL);
+    MRC_port_apply(MRC_PORT_COIL1 | MRC_PORT_LED, 0);
+    TRACE(TRACE_EV_SET, relay_pulse_width(RELAY_SET_PULSE_MS));
+    RELAY_PULSE_WAIT(RELAY_SET_PULSE_MS);
+    RELAY_SET_END();
+    TRACE_WAIT_MS(relay_pulse_width(RELAY_SET_PULSE_MS));
+    POWER_STATE_END(POWER_STATE_COIL);
+    MUTE_END();
     relay_state = ON;
 }
 
 void relay_deactivate(void) // aka "reset"
 {
-    MRC_relay_coil_pin2_set_high();
-    MRC_sleep_millisecs(RELAY_SETTLE_TIME_MS);
-    MRC_relay_coil_pin2_set_low();
+    relay_pulse_measure(RELAY_RESET_PULSE_MS);
+    MUTE_BEGIN();
+    POWER_STATE_BEGIN(POWER_STATE_COIL);
+    RELAY_RESET_START();
+    TRACE(TRACE_EV_RESET, relay_pulse_width(RELAY_RESET_PULSE_MS));
+    RELAY_PULSE_WAIT(RELAY_RESET_PULSE_MS);
+    RELAY_RESET_END();
+    TRACE_WAIT_MS(relay_pulse_width(RELAY_RESET_PULSE_MS));
+    POWER_STATE_END(POWER_STATE_COIL);
+    MUTE_END();
     relay_state = OFF;
 }
 
@@ -55,68 +336,1153 @@ void relay_toggle(void)
     else                    { relay_deactivate(); }
 }
 
-uint8_t debounce_switch(void)
+#ifdef USE_POWER_FAIL
+// the supply is going away (see USE_POWER_FAIL): called from the power-good
+// interrupt, wherever the core was; a set pulse in progress is cut short in
+// the same port write that starts the reset pulse, which gets its full
+// nominal width (USE_VCC_COMPENSATION would only measure the rail the bulk
+// capacitor still holds up); the mute output is left as it is; a
+// non-latching relay (USE_NON_LATCHING) only has to be unpowered; a dimmed
+// LED (USE_LED_DIM) is handed back to its pin first, so that it goes out
+void power_fail(void)
+{
+    LED_DIM_STOP();
+#ifdef USE_NON_LATCHING
+    MRC_relay_hold_stop();
+    MRC_port_apply(0, MRC_PORT_COIL1 | MRC_PORT_LED);
+#else
+    MRC_port_apply(MRC_PORT_COIL2, MRC_PORT_COIL1 | MRC_PORT_LED);
+    MRC_sleep_millisecs(RELAY_RESET_PULSE_MS);
+    MRC_relay_coil_pin2_set_low();
+#endif // USE_NON_LATCHING
+    relay_state = OFF;
+    MRC_power_fail_halt();
+}
+#endif // USE_POWER_FAIL
+
+#ifdef USE_MIDI
+
+// remote commands (see USE_MIDI)
+#define MIDI_CMD_NONE   0
+#define MIDI_CMD_OFF    1
+#define MIDI_CMD_ON     2
+#define MIDI_CMD_TOGGLE 3
+
+// parser state: the status byte in force (running status), if it is a
+// message we act on (0 otherwise), and the first data byte of a
+// Control Change
+uint8_t midi_status;
+uint8_t midi_controller;
+uint8_t midi_n_data;
+
+uint8_t midi_program_command(uint8_t program)
+{
+    if (MIDI_PROGRAM_OFF == program)    { return MIDI_CMD_OFF; }
+    if (MIDI_PROGRAM_ON == program)     { return MIDI_CMD_ON; }
+    if (MIDI_PROGRAM_TOGGLE == program) { return MIDI_CMD_TOGGLE; }
+    return MIDI_CMD_NONE;
+}
+
+// feed one byte to the parser; returns the command it completes, if any
+uint8_t midi_parse(uint8_t byte)
+{
+    if (byte >= 0xF8) { return MIDI_CMD_NONE; } // real-time: anywhere, no effect
+
+    if (byte & 0x80) // status: a new message
+    {
+        uint8_t type = byte & 0xF0;
+        midi_status = 0; // anything but ours: skip its data bytes
+        midi_n_data = 0;
+        if (((0xB0 == type) || (0xC0 == type)) &&
+            ((0 == MIDI_CHANNEL) || ((byte & 0x0F) == MIDI_CHANNEL - 1)))
+        {
+            midi_status = type;
+        }
+        return MIDI_CMD_NONE;
+    }
+
+    if (0xC0 == midi_status) { return midi_program_command(byte); }
+    if (0xB0 != midi_status) { return MIDI_CMD_NONE; }
+
+    if (0 == midi_n_data) // Control Change: controller, then value
+    {
+        midi_controller = byte;
+        midi_n_data = 1;
+        return MIDI_CMD_NONE;
+    }
+    midi_n_data = 0;
+    if (MIDI_CC != midi_controller) { return MIDI_CMD_NONE; }
+    return byte >= 64 ? MIDI_CMD_ON : MIDI_CMD_OFF;
+}
+
+void midi_act(uint8_t cmd)
+{
+    if ((MIDI_CMD_NONE == cmd) ||
+        ((MIDI_CMD_ON == cmd) && (ON == relay_state)) ||
+        ((MIDI_CMD_OFF == cmd) && (OFF == relay_state)))
+    {
+        return;
+    }
+    relay_toggle(); // as a press would: the LED changes with the coil
+}
+
+// act on the bytes received so far; returns whether there were any
+uint8_t midi_service(void)
+{
+    uint8_t byte;
+    uint8_t received = FALSE;
+
+    while (MRC_midi_get(&byte))
+    {
+        received = TRUE;
+        midi_act(midi_parse(byte));
+    }
+    return received;
+}
+
+// while the integrator reads the switch, a coil pulse would hold up its
+// reads: the bytes are taken in (the receive buffer is small), and what
+// their commands add up to is acted on once the press is (see
+// midi_run_pending())
+uint8_t midi_pending;
+
+void midi_take(void)
+{
+    uint8_t byte;
+
+    while (MRC_midi_get(&byte))
+    {
+        uint8_t cmd = midi_parse(byte);
+        if (MIDI_CMD_TOGGLE != cmd)
+        {
+            if (MIDI_CMD_NONE != cmd) { midi_pending = cmd; }
+        }
+        else if (MIDI_CMD_NONE == midi_pending) { midi_pending = MIDI_CMD_TOGGLE; }
+        else if (MIDI_CMD_TOGGLE == midi_pending) { midi_pending = MIDI_CMD_NONE; }
+        else if (MIDI_CMD_ON == midi_pending) { midi_pending = MIDI_CMD_OFF; }
+        else { midi_pending = MIDI_CMD_ON; }
+    }
+}
+
+void midi_run_pending(void)
+{
+    uint8_t cmd = midi_pending;
+    midi_pending = MIDI_CMD_NONE;
+    midi_act(cmd);
+}
+
+// a delay that serves the MIDI input every ms; it runs on the low clock
+// (USE_CLOCK_SCALING), the coil pulse of a command on the normal one
+void midi_wait_ms(uint8_t ms)
+{
+    for (uint8_t i=0; i<ms; ++i)
+    {
+        MRC_sleep_millisecs(1);
+        midi_take();
+        if (MIDI_CMD_NONE != midi_pending)
+        {
+            CLOCK_NORMAL();
+            midi_run_pending();
+            CLOCK_LOW();
+        }
+    }
+}
+
+#  define MIDI_POLL()  midi_take()
+#  define MIDI_RUN_PENDING() midi_run_pending()
+// the lockout's waits serve it too
+#  define LOCKOUT_WAIT_MS(ms) midi_wait_ms(ms)
+#else
+#  define MIDI_POLL()  do { } while(0)
+#  define MIDI_RUN_PENDING() do { } while(0)
+#  define LOCKOUT_WAIT_MS(ms) SLEEP_LOWPOWER_MS(ms)
+#endif // USE_MIDI
+
+#ifdef USE_ADAPTIVE_DEBOUNCE
+
+// what the integrator saw on this wake-up: the longest stretch of low reads
+// a high read broke off, and how long the press bounced, from its first low
+// read to its last high one (SWITCH_DEBOUNCE_READS highs in a row have the
+// switch settled up, e.g. after the release that woke us: the press, if
+// any, starts over); reset at its start, and once learned from
+#define ADAPT_NO_LOW 0xFF
+uint8_t adapt_stretch;
+uint8_t adapt_highs;
+uint8_t adapt_run;
+uint8_t adapt_first_low;
+uint8_t adapt_bounce_ms;
+
+// learned: the integrator's target (as SWITCH_DEBOUNCE_TARGET), the
+// lockout's polls, and over the current window of DEBOUNCE_ADAPT_RELAX
+// presses, which of the two a press has needed as they are
+#define ADAPT_NEED_READS 0b01
+#define ADAPT_NEED_POLLS 0b10
+#define ADAPT_MIN_TARGET ((uint8_t)((1U << DEBOUNCE_ADAPT_MIN_READS) - 1))
+#define ADAPT_MAX_POLLS  (SWITCH_DEBOUNCE_TIME_MS / LOCKOUT_POLL_MS)
+uint8_t debounce_target = SWITCH_DEBOUNCE_TARGET;
+uint8_t lockout_polls = ADAPT_MAX_POLLS;
+uint8_t adapt_presses;
+uint8_t adapt_need;
+
+// the wake-up read is read 0, the integrator's i-th is read i+1
+#  define DEBOUNCE_TARGET debounce_target
+#  define LOCKOUT_POLLS   lockout_polls
+#  define ADAPT_BEGIN(low) \
+    do { \
+        adapt_stretch = (low); \
+        adapt_highs = 0; \
+        adapt_first_low = (low) ? 0 : ADAPT_NO_LOW; \
+        adapt_run = 0; \
+        adapt_bounce_ms = 0; \
+    } while(0)
+#  define ADAPT_READ(low, i) \
+    do { \
+        if (low) \
+        { \
+            ++adapt_stretch; \
+            adapt_highs = 0; \
+            if (ADAPT_NO_LOW == adapt_first_low) { adapt_first_low = (uint8_t)((i) + 1); } \
+        } \
+        else \
+        { \
+            if (adapt_stretch > adapt_run) { adapt_run = adapt_stretch; } \
+            adapt_stretch = 0; \
+            if (++adapt_highs >= SWITCH_DEBOUNCE_READS) \
+            { \
+                adapt_first_low = ADAPT_NO_LOW; \
+                adapt_bounce_ms = 0; \
+            } \
+            else if (ADAPT_NO_LOW != adapt_first_low) \
+            { \
+                adapt_bounce_ms = (uint8_t)((i) + 1 - adapt_first_low); \
+            } \
+        } \
+    } while(0)
+
+// after each wake-up: grow at once to what the integrator showed the
+// switch needs (nothing, if the quick check turned it away); every
+// DEBOUNCE_ADAPT_RELAX presses, come down a step where none of them needed
+// the value as it is
+void adapt_learn(uint8_t pressed)
+{
+    // at most SWITCH_DEBOUNCE_READS: a longer stretch completes the target
+    uint8_t reads = adapt_run + DEBOUNCE_ADAPT_MARGIN_READS;
+    uint8_t bounce_ms = adapt_bounce_ms;
+    adapt_run = 0;
+    adapt_bounce_ms = 0;
+    if (reads < DEBOUNCE_ADAPT_MIN_READS) { reads = DEBOUNCE_ADAPT_MIN_READS; }
+    uint8_t target = reads >= SWITCH_DEBOUNCE_READS ? SWITCH_DEBOUNCE_TARGET
+                                                    : (uint8_t)((1U << reads) - 1);
+    if (target >= debounce_target)
+    {
+        debounce_target = target;
+        adapt_need |= ADAPT_NEED_READS;
+    }
+    if (!pressed) { return; }
+
+    uint16_t ms = (uint16_t)bounce_ms * DEBOUNCE_ADAPT_LOCKOUT_FACTOR;
+    uint8_t polls = (uint8_t)((ms + LOCKOUT_POLL_MS - 1) / LOCKOUT_POLL_MS);
+    if (polls < 1)               { polls = 1;               }
+    if (polls > ADAPT_MAX_POLLS) { polls = ADAPT_MAX_POLLS; }
+    if (polls >= lockout_polls)
+    {
+        lockout_polls = polls;
+        adapt_need |= ADAPT_NEED_POLLS;
+    }
+
+    if (++adapt_presses < DEBOUNCE_ADAPT_RELAX) { return; }
+    if (!(adapt_need & ADAPT_NEED_READS) && (debounce_target > ADAPT_MIN_TARGET))
+    {
+        debounce_target >>= 1;
+    }
+    if (!(adapt_need & ADAPT_NEED_POLLS) && (lockout_polls > 1))
+    {
+        --lockout_polls;
+    }
+    adapt_presses = 0;
+    adapt_need = 0;
+}
+
+#  define ADAPT_LEARN(pressed) adapt_learn(pressed)
+
+#  ifdef USE_PERSIST
+// what was learned, in the last cell of the data EEPROM (the relay state
+// ring stops short of it):
+//   bits 7-5: reads the target needs, less one
+//   bits 4-2: lockout polls, less one
+//   bits 1-0: 0b00, marks a record: erased cells read 0xFF, and relay state
+//             records (left there by a build without this feature) end in
+//             0b01 or 0b10
+#define ADAPT_CELL    (MRC_EEPROM_SIZE - 1)
+#define ADAPT_MAGIC   0b00
+uint8_t adapt_saved; // the record in the EEPROM
+
+uint8_t adapt_record(void)
+{
+    uint8_t reads = 0;
+    for (uint8_t t=debounce_target; t; t >>= 1) { ++reads; }
+    return (uint8_t)(((reads - 1) << 5) | ((lockout_polls - 1) << 2) | ADAPT_MAGIC);
+}
+
+// at power-up: a record whose values are out of bounds (torn, or from a
+// build with other bounds) is ignored, and the fixed values kept
+void adapt_load(void)
+{
+    uint8_t rec = MRC_eeprom_read(ADAPT_CELL);
+    uint8_t reads = (uint8_t)((rec >> 5) + 1);
+    uint8_t polls = (uint8_t)(((rec >> 2) & 0b111) + 1);
+    adapt_saved = rec;
+    if ((ADAPT_MAGIC != (rec & 0b11)) ||
+        (reads < DEBOUNCE_ADAPT_MIN_READS) || (reads > SWITCH_DEBOUNCE_READS) ||
+        (polls > ADAPT_MAX_POLLS))
+    {
+        return;
+    }
+    debounce_target = (uint8_t)((1U << reads) - 1);
+    lockout_polls = polls;
+}
+
+// once the lockout is over (the relay state's write, started at its
+// beginning, is done by then): write the record if it has changed
+void adapt_save(void)
+{
+    uint8_t rec = adapt_record();
+    if (rec == adapt_saved) { return; }
+    adapt_saved = rec;
+    MRC_eeprom_wait();
+    MRC_eeprom_write_start(ADAPT_CELL, rec);
+}
+
+#    define ADAPT_LOAD()    adapt_load()
+#    define ADAPT_SAVE()    adapt_save()
+#    define PERSIST_CELLS   (MRC_EEPROM_SIZE - 1)
+#  else
+#    define ADAPT_LOAD()    do { } while(0)
+#    define ADAPT_SAVE()    do { } while(0)
+#  endif // USE_PERSIST
+#else
+#  define DEBOUNCE_TARGET        SWITCH_DEBOUNCE_TARGET
+#  define LOCKOUT_POLLS          (SWITCH_DEBOUNCE_TIME_MS / LOCKOUT_POLL_MS)
+#  define ADAPT_BEGIN(low)       do { } while(0)
+#  define ADAPT_READ(low, i)     do { } while(0)
+#  define ADAPT_LEARN(pressed)   do { } while(0)
+#  define ADAPT_LOAD()           do { } while(0)
+#  define ADAPT_SAVE()           do { } while(0)
+#endif // USE_ADAPTIVE_DEBOUNCE
+
+#ifndef PERSIST_CELLS
+#  define PERSIST_CELLS MRC_EEPROM_SIZE
+#endif
+
+// the post-press lockout: the switch is ignored, but polled every
+// LOCKOUT_POLL_MS for its release.  the pin-change flags are left as the
+// press set them (on the pic10f320, switch reads depend on them), and
+// record the lockout's changes too: if the switch was seen released, they
+// are left for MRC_switch_press_pending() to find a new press by; if not,
+// they are cleared at the end, as bounce and noise on a switch still held
+// are not a new press
+uint8_t lockout_released;
+
+void lockout_poll(void)
+{
+    if (HIGH == MRC_switch_pin_get_state()) { lockout_released = TRUE; }
+}
+
+void lockout_end(void)
+{
+    if (!lockout_released) { MRC_switch_pin_clear_int_flags(); }
+}
+
+#ifndef USE_SCHEDULER
+void lockout_sleep(void)
+{
+    lockout_released = FALSE;
+    for (uint8_t i=0; i<LOCKOUT_POLLS; ++i)
+    {
+        LOCKOUT_WAIT_MS(LOCKOUT_POLL_MS);
+        lockout_poll();
+    }
+    lockout_end();
+}
+#endif // USE_SCHEDULER
+
+#ifdef USE_SCHEDULER
+
+// cooperative scheduler: a deadline table with one slot per task, counted
+// down by the timer interrupt; the core sleeps (idle) until a task is due,
+// rather than busy-waiting
+#define TASK_COIL_RELEASE 0 // end of the relay coil pulse
+#define TASK_LOCKOUT_END  1 // end of the post-press switch lockout
+#define TASK_LOCKOUT_POLL 2 // switch release poll, during the lockout
+#ifdef USE_MUTE
+#  define TASK_MUTE_RELEASE 3 // contacts at rest, release the mute
+#  define SCHED_N_TASKS     4
+#else
+#  define SCHED_N_TASKS     3
+#endif // USE_MUTE
+
+// ticks until each task is due (0 = not scheduled), and whether it is due;
+// each is a single byte, written by one side only while the other reads it
+volatile uint8_t sched_ticks[SCHED_N_TASKS];
+volatile uint8_t sched_due[SCHED_N_TASKS];
+
+// the task is due at least ms from now: the first tick comes anywhere
+// within one period, so count one more
+void sched_at(uint8_t task, uint8_t ms)
+{
+    sched_ticks[task] = ms / TIMER_TICK_MS + 1;
+}
+
+void sched_tick(void)
+{
+    for (uint8_t i=0; i<SCHED_N_TASKS; ++i)
+    {
+        if (sched_ticks[i] && (0 == --sched_ticks[i])) { sched_due[i] = TRUE; }
+    }
+}
+
+uint8_t sched_pending(void)
+{
+    for (uint8_t i=0; i<SCHED_N_TASKS; ++i)
+    {
+        if (sched_ticks[i] || sched_due[i]) { return TRUE; }
+    }
+    return FALSE;
+}
+
+// the outputs released by the tasks that are due together change in one
+// port write; at the end of a set pulse, a non-latching relay's coil is
+// switched to the hold current instead (USE_NON_LATCHING)
+void sched_run_due(void)
+{
+    uint8_t clear = 0;
+    if (sched_due[TASK_COIL_RELEASE])
+    {
+        sched_due[TASK_COIL_RELEASE] = FALSE;
+#ifdef USE_NON_LATCHING
+        if (ON == relay_state) { MRC_relay_hold_start(); }
+#else
+        clear = MRC_PORT_COIL1 | MRC_PORT_COIL2;
+#endif // USE_NON_LATCHING
+        POWER_STATE_END(POWER_STATE_COIL);
+    }
+
+#ifdef USE_MUTE
+    if (sched_due[TASK_MUTE_RELEASE])
+    {
+        sched_due[TASK_MUTE_RELEASE] = FALSE;
+        clear |= MRC_PORT_MUTE;
+    }
+#endif // USE_MUTE
+
+    if (clear) { MRC_port_apply(0, clear); }
+
+    if (sched_due[TASK_LOCKOUT_POLL])
+    {
+        sched_due[TASK_LOCKOUT_POLL] = FALSE;
+        lockout_poll();
+        if (sched_ticks[TASK_LOCKOUT_END] > LOCKOUT_POLL_MS / TIMER_TICK_MS)
+        {
+            sched_at(TASK_LOCKOUT_POLL, LOCKOUT_POLL_MS);
+        }
+    }
+
+    // at the end of the lockout, nothing is left pending: the main loop
+    // then goes back to (power-down) sleep
+    if (sched_due[TASK_LOCKOUT_END])
+    {
+        sched_due[TASK_LOCKOUT_END] = FALSE;
+        lockout_end();
+        POWER_STATE_END(POWER_STATE_LOCKOUT);
+        TRACE(TRACE_EV_LOCKOUT_END, 0);
+    }
+}
+
+// start the coil pulse that flips the relay, and flip the LED with it (in
+// the same port write); the pulse is ended by the scheduler
+void relay_toggle_scheduled(void)
+{
+    // never drive both coil pins: let a pulse still in progress finish
+    while (sched_ticks[TASK_COIL_RELEASE]) { MRC_enter_idle_mode(); }
+    sched_run_due();
+
+    uint8_t pulse_ms;
+    if (relay_state == OFF)
+    {
+        relay_pulse_measure(RELAY_SET_PULSE_MS);
+        pulse_ms = relay_pulse_width(RELAY_SET_PULSE_MS);
+    }
+    else
+    {
+        relay_pulse_measure(RELAY_RESET_PULSE_MS);
+        pulse_ms = relay_pulse_width(RELAY_RESET_PULSE_MS);
+    }
+
+    MUTE_BEGIN();
+    POWER_STATE_BEGIN(POWER_STATE_COIL);
+    POWER_STATE_BEGIN(POWER_STATE_LOCKOUT);
+    if (relay_state == OFF)
+    {
+        MRC_port_apply(MRC_PORT_COIL1 | MRC_PORT_LED, 0);
+        relay_state = ON;
+        TRACE(TRACE_EV_SET, pulse_ms);
+    }
+    else
+    {
+        RELAY_RESET_START();
+        relay_state = OFF;
+        TRACE(TRACE_EV_RESET, pulse_ms);
+    }
+
+#ifdef USE_MUTE
+    sched_at(TASK_MUTE_RELEASE, RELAY_OPERATE_MS + (MUTE_POST_US + 999) / 1000);
+#endif // USE_MUTE
+    sched_at(TASK_COIL_RELEASE, pulse_ms);
+    sched_at(TASK_LOCKOUT_END, pulse_ms + SWITCH_DEBOUNCE_TIME_MS);
+    lockout_released = FALSE;
+    sched_at(TASK_LOCKOUT_POLL, pulse_ms + LOCKOUT_POLL_MS);
+}
+
+#endif // USE_SCHEDULER
+
+#if DEBOUNCE_STRATEGY != DEBOUNCE_LEADING_EDGE
+#ifdef USE_TIMER_DEBOUNCE
+
+// the same shift-register integrator as below, but each step is taken from
+// the timer interrupt, so the core can sleep between switch reads
+volatile uint8_t debounce_state;
+volatile uint8_t debounce_reads;
+volatile uint8_t debounce_done;
+
+void debounce_tick(void)
+{
+    if (debounce_done) { return; }
+
+    uint8_t state = (uint8_t)(debounce_state << 1);
+    state |= (LOW == MRC_switch_pin_get_state() ? 1 : 0);
+    state &= SWITCH_DEBOUNCE_TARGET;
+    debounce_state = state;
+
+    if ((SWITCH_DEBOUNCE_TARGET == state) ||
+        (++debounce_reads >= MAX_N_SWITCH_DEBOUNCE_READS))
+    {
+        debounce_done = TRUE;
+    }
+}
+
+uint8_t debounce_integrate(void)
+{
+    debounce_state = (LOW == MRC_switch_pin_get_state() ? 1 : 0);
+    debounce_reads = 0;
+    debounce_done = (SWITCH_DEBOUNCE_TARGET == debounce_state);
+
+    if (!debounce_done)
+    {
+#ifdef USE_SCHEDULER
+        // the scheduler keeps the timer running whenever we are awake
+        while (!debounce_done) { MRC_enter_idle_mode(); }
+#else
+        MRC_timer_start();
+        while (!debounce_done) { MRC_enter_idle_mode(); }
+        MRC_timer_stop();
+        MRC_switch_wake_disarm();
+#endif
+    }
+
+    TRACE_READS(debounce_reads);
+    return SWITCH_DEBOUNCE_TARGET == debounce_state;
+}
+
+#else // USE_TIMER_DEBOUNCE
+
+uint8_t debounce_integrate(void)
 {
     uint8_t state = (LOW == MRC_switch_pin_get_state() ? 1 : 0);
+    uint8_t i;
+    ADAPT_BEGIN(state);
 
-    for (   uint8_t i=0 ;
+    for (   i=0 ;
             ((i<MAX_N_SWITCH_DEBOUNCE_READS) &&
-             (SWITCH_DEBOUNCE_TARGET != state)) ;
+             (DEBOUNCE_TARGET != state)) ;
             ++i )
     {
         state  = (uint8_t)(state << 1);
         state |= (LOW == MRC_switch_pin_get_state() ? 1 : 0);
-        state &= SWITCH_DEBOUNCE_TARGET;
+        ADAPT_READ(state & 1, i);
+        state &= DEBOUNCE_TARGET;
         MRC_sleep_millisecs(1);
+        MIDI_POLL();
+    }
+
+    TRACE_READS(i);
+    return DEBOUNCE_TARGET == state;
+}
+
+#endif // USE_TIMER_DEBOUNCE
+#endif // DEBOUNCE_STRATEGY != DEBOUNCE_LEADING_EDGE
+
+#ifdef USE_TIMER_TICK
+void timer_tick(void)
+{
+#ifdef USE_TIMER_DEBOUNCE
+    debounce_tick();
+#endif
+#ifdef USE_SCHEDULER
+    sched_tick();
+#  ifdef USE_TRACE
+    if (trace_ms != 255) { ++trace_ms; }
+#  endif
+#endif
+}
+#endif // USE_TIMER_TICK
+
+#if DEBOUNCE_STRATEGY != DEBOUNCE_INTEGRATOR
+// leading-edge check: the pin that woke us is low, and still low a moment
+// later (i.e. not a short RF spike)
+uint8_t debounce_leading_edge(void)
+{
+    if (LOW != MRC_switch_pin_get_state()) { return FALSE; }
+    MRC_sleep_microsecs(DEBOUNCE_CONFIRM_US);
+    return LOW == MRC_switch_pin_get_state();
+}
+#endif // DEBOUNCE_STRATEGY != DEBOUNCE_INTEGRATOR
+
+#if DEBOUNCE_STRATEGY == DEBOUNCE_INTEGRATOR
+// quick check on wake-up, before the integrator (see DEBOUNCE_QUICK_READS):
+// the switch reads low on at least half of a few reads, microseconds apart
+uint8_t debounce_plausible(void)
+{
+    uint8_t lows = 0;
+    for (uint8_t i=0; i<DEBOUNCE_QUICK_READS; ++i)
+    {
+        MRC_sleep_microsecs(DEBOUNCE_QUICK_GAP_US);
+        if (LOW == MRC_switch_pin_get_state()) { ++lows; }
+    }
+    return 2 * lows >= DEBOUNCE_QUICK_READS;
+}
+#endif // DEBOUNCE_STRATEGY == DEBOUNCE_INTEGRATOR
+
+// what a (debounced) switch press does
+void switch_press_action(void)
+{
+#ifdef USE_SCHEDULER
+    relay_toggle_scheduled();
+#else
+    relay_toggle(); // the LED changes with the coil
+#endif
+}
+
+// debounce strategy layer, selected at build time with DEBOUNCE_STRATEGY
+// returns one of:
+#define PRESS_NONE    0 // no (valid) press
+#define PRESS_NEW     1 // valid press, the caller should act on it
+#define PRESS_HANDLED 2 // valid press, already acted upon
+uint8_t debounce_switch(void)
+{
+#if DEBOUNCE_STRATEGY == DEBOUNCE_LEADING_EDGE
+    if (debounce_leading_edge()) { return PRESS_NEW; }
+
+    // woken by a release, a spike, or a press whose first bounce defeated
+    // the check above: sit out any remaining bounce with the pin ignored;
+    // if the switch is then (still) down, it is a press - its edges are
+    // over, so nothing else would wake us for it
+    LOCKOUT_WAIT_MS(DEBOUNCE_RELEASE_LOCKOUT_MS);
+    TRACE_WAIT_MS(DEBOUNCE_RELEASE_LOCKOUT_MS);
+    return LOW == MRC_switch_pin_get_state() ? PRESS_NEW : PRESS_NONE;
+
+#elif DEBOUNCE_STRATEGY == DEBOUNCE_HYBRID
+    if (!debounce_leading_edge())
+    {
+        return debounce_integrate() ? PRESS_NEW : PRESS_NONE;
+    }
+
+    // act right away, then let the integrator confirm that the switch is
+    // really held down; if it is not, it was a glitch: undo the action
+    switch_press_action();
+    if (debounce_integrate()) { return PRESS_HANDLED; }
+    switch_press_action();
+    return PRESS_NONE;
+
+#else // DEBOUNCE_INTEGRATOR
+    // a spike on the footswitch wire, or the release, goes straight back to
+    // sleep; only a plausible press runs the integrator
+    if (!debounce_plausible()) { STATS_QUICK_REJECT(); return PRESS_NONE; }
+    return debounce_integrate() ? PRESS_NEW : PRESS_NONE;
+#endif
+}
+
+#ifdef USE_PERSIST
+
+// relay state persistence: a ring of one-byte records across the whole
+// EEPROM (but for the last cell, with USE_ADAPTIVE_DEBOUNCE), written in
+// order; a record is
+//   bit 7:    lap phase, flipped each time the ring wraps (a one-bit
+//             sequence number: the ring is only ever written in order)
+//   bits 6-2: 0b10100, marks a record (erased cells read 0xFF)
+//   bit 1:    ~state
+//   bit 0:    state
+// an interrupted write (programming only clears bits) either fails the
+// checks, or reads as the previous lap; either way the record before it is
+// found instead
+#define PERSIST_MAGIC      0x50
+#define PERSIST_MAGIC_MASK 0x7C
+#define persist_record(phase, state) \
+    (uint8_t)(((phase) << 7) | PERSIST_MAGIC | ((state) ? 0b01 : 0b10))
+
+uint16_t persist_pos;  // cell of the newest record
+uint8_t persist_phase; // its lap phase
+uint8_t persist_state; // the state it holds
+
+uint8_t persist_valid(uint8_t rec)
+{
+    return (PERSIST_MAGIC == (rec & PERSIST_MAGIC_MASK)) &&
+           ((rec ^ (rec >> 1)) & 1);
+}
+
+// the cells from 0 up to the newest record have the lap phase of cell 0,
+// the ones after it (previous lap, or erased) do not: binary search for the
+// boundary, ~log2(PERSIST_CELLS) reads; if cell 0 holds no record, either
+// the EEPROM is blank, or the first write of a lap was torn and cells 1 on
+// are all the previous lap (the newest is the last cell): search from cell
+// 1 instead, and the next record still goes to cell 0, in the other phase
+void persist_load(void)
+{
+    uint16_t lo = 0;               // in the current lap
+    uint8_t first = MRC_eeprom_read(0);
+    if (!persist_valid(first))
+    {
+        lo = 1;
+        first = MRC_eeprom_read(1);
+    }
+    if (!persist_valid(first))
+    {
+        // blank: the first record goes to cell 0, phase 0
+        persist_pos = PERSIST_CELLS - 1;
+        persist_phase = 1;
+        persist_state = OFF;
+        return;
+    }
+
+    uint16_t hi = PERSIST_CELLS; // not (or past the end)
+    while (hi - lo > 1)
+    {
+        uint16_t mid = lo + (hi - lo) / 2;
+        uint8_t rec = MRC_eeprom_read(mid);
+        if (persist_valid(rec) && (0 == ((rec ^ first) & 0x80))) { lo = mid; }
+        else                                                       { hi = mid; }
+    }
+
+    persist_pos = lo;
+    persist_phase = first >> 7;
+    persist_state = MRC_eeprom_read(lo) & 1;
+}
+
+// append a record if the state has changed since the last one
+void persist_save(uint8_t state)
+{
+    if (state == persist_state) { return; }
+
+    if (++persist_pos == PERSIST_CELLS)
+    {
+        persist_pos = 0;
+        persist_phase ^= 1;
     }
+    persist_state = state;
+    MRC_eeprom_write_start(persist_pos, persist_record(persist_phase, state));
+}
+
+#  define PERSIST_SAVE() persist_save(relay_state)
+#  define PERSIST_WAIT() MRC_eeprom_wait()
+#else
+#  define PERSIST_SAVE() do { } while(0)
+#  define PERSIST_WAIT() do { } while(0)
+#endif // USE_PERSIST
+
+#ifdef USE_GESTURES
 
-    return SWITCH_DEBOUNCE_TARGET == state;
+// gesture_run() samples the switch at the low clock (USE_CLOCK_SCALING);
+// a correction's coil pulse, and the supply reading and mute waits around
+// it, are timed for the normal one
+void gesture_press_action(void)
+{
+    CLOCK_NORMAL();
+    switch_press_action();
+    CLOCK_LOW();
 }
 
+// gesture recognizer (see USE_GESTURES), run once a press has been
+// accepted and acted on as a tap: follows the debounced switch edges (the
+// same integrator as debounce_integrate(), run in both directions) until
+// the gesture is complete, correcting the speculative tap if need be; a
+// double tap is only looked for if GESTURE_DOUBLE_TAP_ACTION() is defined
+// (otherwise a second press is just another tap)
+void gesture_run(void)
+{
+    uint8_t history = SWITCH_DEBOUNCE_TARGET; // bit set = switch read low
+    uint8_t pressed = TRUE;
+    uint8_t long_press = FALSE;
+    uint8_t second_press = FALSE;
+    uint16_t edge_ms = 0; // time of the last debounced edge
+    uint16_t t_ms = 0;
+
+    for (;;)
+    {
+        MRC_sleep_millisecs(1);
+        ++t_ms;
+#ifdef USE_SCHEDULER
+        sched_run_due();
+#endif
+        history  = (uint8_t)(history << 1);
+        history |= (LOW == MRC_switch_pin_get_state() ? 1 : 0);
+        history &= SWITCH_DEBOUNCE_TARGET;
+
+        if (pressed && (0 == history)) // released
+        {
+            if (long_press) { gesture_press_action(); } // momentary: undo
+#ifdef GESTURE_DOUBLE_TAP_ACTION
+            if (long_press || second_press) { return; }
+            pressed = FALSE;
+            edge_ms = t_ms;
+#else
+            return;
+#endif
+        }
+#ifdef GESTURE_DOUBLE_TAP_ACTION
+        else if (!pressed && (SWITCH_DEBOUNCE_TARGET == history)) // pressed again
+        {
+            CLOCK_NORMAL();
+            switch_press_action(); // undo the first tap
+            GESTURE_DOUBLE_TAP_ACTION();
+            CLOCK_LOW();
+            pressed = TRUE;
+            second_press = TRUE;
+        }
+#endif
+
+        // (uint16_t): the difference would otherwise be promoted to int
+        if (pressed && !second_press &&
+            ((uint16_t)(t_ms - edge_ms) >= GESTURE_LONG_PRESS_MS))
+        {
+            long_press = TRUE;
+        }
+#ifdef GESTURE_DOUBLE_TAP_ACTION
+        if (!pressed && ((uint16_t)(t_ms - edge_ms) >= GESTURE_DOUBLE_TAP_MS))
+        {
+            return; // a tap
+        }
+#endif
+    }
+}
+
+#  define GESTURE_RUN() gesture_run()
+#else
+#  define GESTURE_RUN() do { } while(0)
+#endif // USE_GESTURES
+
 // blink the status LED a few times
 void led_greeting(void)
 {
     for (uint8_t i=0; i<4; ++i)
     {
         MRC_led_pin_set_high();
-        MRC_sleep_millisecs(250);
+        SLEEP_LOWPOWER_MS(250);
         MRC_led_pin_set_low();
-        MRC_sleep_millisecs(250);
+        SLEEP_LOWPOWER_MS(250);
     }
 }
 
+// make relay and status indicator LED consistent consistent with the
+// default relay_state = OFF (or, with USE_PERSIST, the saved state); the
+// coil pulse sets the LED
+void relay_init_state(void)
+{
+    MRC_port_apply(0, MRC_PORT_COIL1 | MRC_PORT_COIL2);
+#ifdef USE_PERSIST
+    persist_load();
+    ADAPT_LOAD();
+    if (ON == persist_state) { relay_activate();   }
+    else                     { relay_deactivate(); }
+#else
+    relay_deactivate();
+#endif // USE_PERSIST
+}
+
 int main(int argc, char* argv[])
 {
     // initialize hardware
     MRC_hardware_init();
 
+#ifdef USE_FAST_BOOT
+    relay_init_state();
+#  if LED_GREETING
+    led_greeting();
+    if (ON == relay_state) { MRC_led_pin_set_high(); }
+#  endif // LED_GREETING
+#else
+#  if LED_GREETING
     // just for fun
     led_greeting();
+#  endif // LED_GREETING
 
-    // make relay and status indicator LED consistent consistent with the
-    // default relay_state = OFF
-    MRC_relay_coil_pin2_set_low();
-    MRC_relay_coil_pin1_set_low();
-    relay_deactivate();
-    MRC_led_pin_set_low();
+    relay_init_state();
+#endif // USE_FAST_BOOT
 
     while (1)
     {
-        MRC_disable_interrupts();
+        MRC_switch_wake_disarm();
         MRC_disable_sleep();
+        TRACE_WAKE();
+        STATS_WAKE();
 
+#ifdef USE_SCHEDULER
+        MRC_timer_start();
+
+        POWER_STATE_BEGIN(POWER_STATE_DEBOUNCE);
+        CLOCK_LOW();
         uint8_t switch_pressed = debounce_switch();
-        MRC_switch_pin_clear_int_flags();
+        CLOCK_NORMAL();
+        POWER_STATE_END(POWER_STATE_DEBOUNCE);
+        TRACE(switch_pressed ? TRACE_EV_ACCEPT : TRACE_EV_REJECT, trace_reads);
+        STATS_PRESS_IF(switch_pressed);
+        if (PRESS_NEW == switch_pressed) { switch_press_action(); }
+        if (switch_pressed) { CLOCK_LOW(); GESTURE_RUN(); CLOCK_NORMAL(); }
+#ifdef USE_PERSIST
+        // save once the coil pulse is over; the write then runs during the
+        // lockout
+        while (sched_ticks[TASK_COIL_RELEASE]) { MRC_enter_idle_mode(); }
+        sched_run_due();
+        PERSIST_SAVE();
+#endif // USE_PERSIST
+
+        // the press schedules the end of its coil pulse and of the lockout:
+        // sleep between those deadlines, then power down
+        CLOCK_LOW();
+        while (sched_pending())
+        {
+            MRC_enter_idle_mode();
+            sched_run_due();
+        }
+        CLOCK_NORMAL();
+
+        MRC_timer_stop();
+#else
+#ifdef USE_MIDI
+        // woken by the MIDI input alone: the switch has not changed, or is
+        // not down (its next edge wakes us again)
+        if (midi_service() && !MRC_switch_press_pending())
+        {
+            PERSIST_SAVE();
+            PERSIST_WAIT();
+            LED_DIM_START();
+            MRC_enter_sleep_mode();
+            LED_DIM_STOP();
+            continue;
+        }
+#endif // USE_MIDI
+
+        POWER_STATE_BEGIN(POWER_STATE_DEBOUNCE);
+        CLOCK_LOW();
+        uint8_t switch_pressed = debounce_switch();
+        CLOCK_NORMAL();
+        POWER_STATE_END(POWER_STATE_DEBOUNCE);
+        TRACE(switch_pressed ? TRACE_EV_ACCEPT : TRACE_EV_REJECT, trace_reads);
+        STATS_PRESS_IF(switch_pressed);
         if (switch_pressed)
         {
-            relay_toggle();
-            MRC_led_toggle();
-            MRC_sleep_millisecs(SWITCH_DEBOUNCE_TIME_MS);
+            if (PRESS_NEW == switch_pressed) { switch_press_action(); }
+            MIDI_RUN_PENDING(); // commands taken while the press was read
+            ADAPT_LEARN(TRUE); // before the lockout, which it may shorten
+            POWER_STATE_BEGIN(POWER_STATE_LOCKOUT);
+            CLOCK_LOW();
+            GESTURE_RUN();
+            PERSIST_SAVE(); // the write runs during the lockout
+            lockout_sleep();
+            CLOCK_NORMAL();
+            POWER_STATE_END(POWER_STATE_LOCKOUT);
+            TRACE_WAIT_MS(LOCKOUT_POLLS * LOCKOUT_POLL_MS);
+            TRACE(TRACE_EV_LOCKOUT_END, 0);
+        }
+        else
+        {
+            MIDI_RUN_PENDING();
+            ADAPT_LEARN(FALSE);
+        }
+        ADAPT_SAVE();
+#endif // USE_SCHEDULER
+
+        TRACE_DUMP_IF_HELD(switch_pressed);
+
+#ifdef USE_MIDI
+        PERSIST_SAVE(); // any commands taken while awake for the switch
+#endif
+        PERSIST_WAIT();
+
+        // the pin-change flags still hold what the switch did since the
+        // wake-up (or the release seen in the lockout): if it is down now, a
+        // press came while we were not looking, and is serviced at once;
+        // otherwise they are cleared, and sleep waits for the next change
+        if (MRC_switch_press_pending()) { continue; }
+
+        LED_DIM_START();
+        MRC_enter_sleep_mode();
+        LED_DIM_STOP();
+    }
+
+    return 0;
+}
+
+#else // MRC_N_CHANNELS > 1
+
+#if defined(USE_GESTURES) || defined(USE_SCHEDULER) || defined(USE_TIMER_DEBOUNCE) || \
+    defined(USE_MUTE) || defined(USE_PERSIST) || defined(USE_TRACE) || \
+    defined(USE_WAKE_STATS) || defined(USE_POWER_FAIL) || defined(USE_NON_LATCHING) || defined(USE_LED_DIM) || \
+    defined(USE_MIDI) || defined(USE_ADAPTIVE_DEBOUNCE) || \
+    (DEBOUNCE_STRATEGY != DEBOUNCE_INTEGRATOR)
+#  error "MRC_N_CHANNELS > 1: only the integrator debounce, and none of the single-switch features"
+#endif
+#if MRC_N_CHANNELS > 8
+#  error "MRC_N_CHANNELS: at most 8 (one uint8_t mask)"
+#endif
+
+// vertical counters: the integrator's eight consecutive reads, for all
+// channels at once; bit n of vc_c2:vc_c1:vc_c0 is a 3-bit counter for
+// channel n, which counts down while the switch reads differently from its
+// debounced state, and is reset to 7 by any read that agrees with it; the
+// eighth differing read in a row (the count rolling over) flips the
+// debounced state
+uint8_t vc_state;            // debounced, bit set = pressed
+uint8_t vc_c0 = 0xFF;
+uint8_t vc_c1 = 0xFF;
+uint8_t vc_c2 = 0xFF;
+
+// one read of all the switches (bit set = pressed); returns the channels
+// whose debounced state it flips
+uint8_t debounce_vertical(uint8_t sample)
+{
+    uint8_t differs = sample ^ vc_state;
+    uint8_t borrow0 = (uint8_t)~vc_c0;             // out of bit 0
+    uint8_t borrow1 = borrow0 & (uint8_t)~vc_c1;   // out of bit 1
+    uint8_t flip = differs & borrow1 & (uint8_t)~vc_c2;
+
+    vc_c0 = (uint8_t)~differs | borrow0;
+    vc_c1 = (uint8_t)~differs | (vc_c1 ^ borrow0);
+    vc_c2 = (uint8_t)~differs | (vc_c2 ^ borrow1);
+    vc_state ^= flip;
+    return flip;
+}
+
+// no channel is part-way through a count: the last read agreed with the
+// debounced state everywhere
+#define VC_IDLE() (0xFF == (vc_c0 & vc_c1 & vc_c2))
+
+// one coil pulse, moving the relays of the channels in mask to state
+void relay_coils_pulse(uint8_t mask, uint8_t state)
+{
+    relay_pulse_measure(ON == state ? RELAY_SET_PULSE_MS : RELAY_RESET_PULSE_MS);
+    POWER_STATE_BEGIN(POWER_STATE_COIL);
+    MRC_relay_coils_drive(mask, state);
+    if (ON == state) { RELAY_PULSE_WAIT(RELAY_SET_PULSE_MS);   }
+    else             { RELAY_PULSE_WAIT(RELAY_RESET_PULSE_MS); }
+    MRC_relay_coils_release();
+    POWER_STATE_END(POWER_STATE_COIL);
+}
+
+// move the relays of the channels in mask to state, in as few coil pulses
+// as RELAY_PEAK_MA allows: each round takes the remaining coils largest
+// first, every one that still fits (first-fit decreasing, one round at a
+// time); with coils of one kind, that is the fewest rounds there can be
+void relay_channels_pulse(uint8_t mask, uint8_t state)
+{
+    while (mask)
+    {
+        uint8_t round = 0;
+        uint16_t round_ma = 0;
+        for (;;)
+        {
+            uint8_t pick = 0;
+            uint8_t pick_ma = 0;
+            uint8_t i = 0;
+            for (uint8_t ch=1; ch & MRC_CHANNEL_MASK; ch <<= 1, ++i)
+            {
+                uint8_t ma = RELAY_CHANNEL_COIL_MA(i);
+                if ((mask & ch) && (ma > pick_ma) &&
+                    (round_ma + ma <= RELAY_PEAK_MA))
+                {
+                    pick = ch;
+                    pick_ma = ma;
+                }
+            }
+            if (!pick) { break; }
+            round |= pick;
+            round_ma += pick_ma;
+            mask &= (uint8_t)~pick;
         }
+        // a coil over the budget on its own
+        if (!round) { round = mask & (uint8_t)-mask; mask &= (uint8_t)~round; }
+        relay_coils_pulse(round, state);
+    }
+}
+
+// toggle the relays of the channels in mask; the coils may share a return
+// pin (set and reset drive it opposite ways), so the relays going ON and
+// those going OFF are pulsed separately
+void relay_channels_toggle(uint8_t mask)
+{
+    relay_channels_pulse(mask & (uint8_t)~relay_state, ON);
+    relay_channels_pulse(mask & relay_state, OFF);
+    relay_state ^= mask;
+    MRC_leds_set(relay_state);
+}
+
+// every relay OFF
+void relay_channels_init_state(void)
+{
+    MRC_relay_coils_release();
+    relay_channels_pulse(MRC_CHANNEL_MASK, OFF);
+    relay_state = 0;
+    MRC_leds_set(relay_state);
+}
+
+int main(int argc, char* argv[])
+{
+    MRC_hardware_init();
+    relay_channels_init_state();
+
+    while (1)
+    {
+        MRC_switch_wake_disarm();
+        MRC_disable_sleep();
+
+        // read every 1ms, acting on presses as they are debounced, until
+        // eight reads in a row find nothing part-way through a count (or
+        // MAX_N_SWITCH_DEBOUNCE_READS have been taken: the counts carry
+        // over to the next wake-up)
+        POWER_STATE_BEGIN(POWER_STATE_DEBOUNCE);
+        CLOCK_LOW();
+        uint8_t quiet = 0;
+        for (uint8_t reads=0;
+             (quiet < 8) && (reads < MAX_N_SWITCH_DEBOUNCE_READS);
+             ++reads)
+        {
+            uint8_t sample = (uint8_t)~MRC_switch_pins_get_state() & MRC_CHANNEL_MASK;
+            uint8_t pressed = debounce_vertical(sample) & vc_state;
+            if (pressed)
+            {
+                CLOCK_NORMAL();
+                relay_channels_toggle(pressed);
+                CLOCK_LOW();
+            }
+            quiet = VC_IDLE() ? quiet + 1 : 0;
+            MRC_sleep_millisecs(1);
+        }
+        CLOCK_NORMAL();
+        POWER_STATE_END(POWER_STATE_DEBOUNCE);
+        MRC_switch_pin_clear_int_flags();
 
-        MRC_enable_interrupts();
         MRC_enter_sleep_mode();
     }
 
     return 0;
 }
+
+#endif // MRC_N_CHANNELS
@@ -0,0 +1,285 @@
+// Copyright (c) Matthew Garman.  All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for
+// license information.
+
+
+/*
+ * ageing-switch benchmark: drives the core's main() with the life of one
+ * footswitch, whose bounce gets longer and more broken up as it wears (see
+ * phases[]), on the host simulation.  the life is played as sessions of
+ * SESSION_STIMULI presses and glitches, each from a power-up (the EEPROM
+ * keeps its contents, see USE_PERSIST); a fifth of the presses are fast
+ * double presses, a tap followed by a second one soon after its release.
+ * built with the fixed debounce, or with USE_ADAPTIVE_DEBOUNCE, it reports
+ * per phase
+ *   - press-to-coil-edge latency, and the presses that did not reach the
+ *     relay (of them, the second presses of double presses)
+ *   - false triggers: coil pulses beyond one per press, or on a glitch
+ *   - with USE_ADAPTIVE_DEBOUNCE, the low reads a press needed and the
+ *     lockout at the end of the phase's last session; with USE_PERSIST as
+ *     well, how often the learned record was written
+ * with USE_PERSIST, it first checks that a relay state record left in the
+ * learned record's cell (by a build without USE_ADAPTIVE_DEBOUNCE) is not
+ * taken for one, and exits non-zero if it is
+ *
+ * usage: bench-adapt [sessions_per_phase [seed]]
+ */
+
+#include "simlib.h"
+
+#include "../mcu-relay-controller-iface.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// stimuli start once the startup LED greeting is over
+#define FIRST_STIMULUS_US  3000000UL
+#define STIMULUS_PERIOD_US  400000UL
+#define STIMULUS_JITTER_US  300000UL
+
+#define SESSION_STIMULI     120
+#define SESSION_GLITCHES     20
+
+#define MIN_HOLD_US         80000UL
+#define MAX_HOLD_US        400000UL
+
+// a double press: a tap, and a second press this soon after the tap's
+// release has settled
+#define TAP_MIN_HOLD_US     40000UL
+#define TAP_MAX_HOLD_US     70000UL
+#define DOUBLE_MIN_GAP_US   30000UL
+#define DOUBLE_MAX_GAP_US   60000UL
+#define DOUBLE_PERCENT      20
+
+#ifdef USE_ADAPTIVE_DEBOUNCE
+extern uint8_t debounce_target;
+extern uint8_t lockout_polls;
+#endif
+
+// the switch as it ages: each edge bounces for up to bounce_us, the level
+// flipping after gaps of min_gap_us..max_gap_us (so the contacts may rest
+// for up to max_gap_us in the middle of a bounce)
+typedef struct
+{
+    const char* name;
+    uint32_t bounce_us;
+    uint32_t min_gap_us;
+    uint32_t max_gap_us;
+} phase_t;
+
+static const phase_t phases[] =
+{
+    { "new",      1000,  20,  200 },
+    { "run in",   3000,  20,  600 },
+    { "worn",     8000,  50, 1500 },
+    { "aged",    15000, 100, 3000 },
+    { "failing", 25000, 200, 5000 },
+};
+#define N_PHASES (sizeof(phases) / sizeof(phases[0]))
+
+#define STIM_GLITCH 0
+#define STIM_PRESS  1
+#define STIM_SECOND 2 // the second press of a double press
+
+typedef struct
+{
+    uint64_t t_us;
+    uint8_t kind;
+} stimulus_t;
+
+typedef struct
+{
+    unsigned presses;
+    unsigned missed;
+    unsigned seconds;
+    unsigned seconds_missed;
+    unsigned glitches;
+    unsigned false_triggers;
+    sim_stats_t latency;
+} result_t;
+
+// a transition to final_level at t_us, bouncing for up to bounce_us;
+// returns the time of the last edge
+static uint64_t gen_bounce(const phase_t* ph, uint64_t t_us, uint8_t final_level,
+                           uint32_t* rng)
+{
+    const uint64_t end_us = t_us + sim_rand_range(rng, 0, ph->bounce_us);
+    uint8_t level = final_level;
+
+    sim_switch_add_edge(t_us, level);
+    for (;;)
+    {
+        uint64_t next_us = t_us + sim_rand_range(rng, ph->min_gap_us, ph->max_gap_us);
+        if (next_us >= end_us) { break; }
+        t_us = next_us;
+        level = !level;
+        sim_switch_add_edge(t_us, level);
+    }
+    if (level != final_level)
+    {
+        sim_switch_add_edge(end_us, final_level);
+        t_us = end_us;
+    }
+    return t_us;
+}
+
+// one session: script it, run it from power-up, and score it
+static void run_session(const phase_t* ph, result_t* r, uint32_t* rng)
+{
+    stimulus_t stim[2 * SESSION_STIMULI + 1];
+    unsigned n = 0;
+
+    sim_reset();
+    uint64_t t_us = FIRST_STIMULUS_US;
+    unsigned glitches_left = SESSION_GLITCHES;
+    for (unsigned i=0; i<SESSION_STIMULI; ++i)
+    {
+        uint64_t next_us = t_us + STIMULUS_PERIOD_US +
+                           sim_rand_range(rng, 0, STIMULUS_JITTER_US);
+        if (sim_rand_range(rng, 1, SESSION_STIMULI - i) <= glitches_left)
+        {
+            --glitches_left;
+            stim[n++] = (stimulus_t){ t_us, STIM_GLITCH };
+            sim_gen_glitch(t_us, rng);
+        }
+        else if (sim_rand_range(rng, 1, 100) <= DOUBLE_PERCENT)
+        {
+            stim[n++] = (stimulus_t){ t_us, STIM_PRESS };
+            gen_bounce(ph, t_us, LOW, rng);
+            uint64_t up_us = t_us + sim_rand_range(rng, TAP_MIN_HOLD_US,
+                                                   TAP_MAX_HOLD_US);
+            uint64_t settled_us = gen_bounce(ph, up_us, HIGH, rng);
+            uint64_t second_us = settled_us +
+                sim_rand_range(rng, DOUBLE_MIN_GAP_US, DOUBLE_MAX_GAP_US);
+            stim[n++] = (stimulus_t){ second_us, STIM_SECOND };
+            gen_bounce(ph, second_us, LOW, rng);
+            gen_bounce(ph, second_us + sim_rand_range(rng, TAP_MIN_HOLD_US,
+                                                      TAP_MAX_HOLD_US),
+                       HIGH, rng);
+        }
+        else
+        {
+            stim[n++] = (stimulus_t){ t_us, STIM_PRESS };
+            gen_bounce(ph, t_us, LOW, rng);
+            gen_bounce(ph, t_us + sim_rand_range(rng, MIN_HOLD_US, MAX_HOLD_US),
+                       HIGH, rng);
+        }
+        t_us = next_us;
+    }
+    stim[n].t_us = t_us;
+    sim_run(t_us);
+
+    for (unsigned i=0; i<n; ++i)
+    {
+        uint64_t from = stim[i].t_us;
+        uint64_t to = stim[i + 1].t_us;
+        unsigned pulses = sim_count_edges(SIM_COIL1, HIGH, from, to) +
+                          sim_count_edges(SIM_COIL2, HIGH, from, to);
+
+        if (STIM_GLITCH == stim[i].kind)
+        {
+            ++r->glitches;
+            r->false_triggers += pulses;
+            continue;
+        }
+
+        ++r->presses;
+        if (STIM_SECOND == stim[i].kind) { ++r->seconds; }
+        if (!pulses)
+        {
+            ++r->missed;
+            if (STIM_SECOND == stim[i].kind) { ++r->seconds_missed; }
+            continue;
+        }
+        r->false_triggers += pulses - 1;
+
+        uint64_t set = sim_find_edge(SIM_COIL1, HIGH, from, to);
+        uint64_t reset = sim_find_edge(SIM_COIL2, HIGH, from, to);
+        uint64_t rise = set < reset ? set : reset;
+        sim_stats_add(&r->latency, (double)(rise - from) / 1000.0);
+    }
+}
+
+
+int main(int argc, char* argv[])
+{
+    unsigned sessions = argc > 1 ? (unsigned)strtoul(argv[1], NULL, 0) : 20;
+    uint32_t rng      = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 0) : 1;
+    if (0 == rng) { rng = 1; }
+
+#ifdef USE_ADAPTIVE_DEBOUNCE
+    printf("adaptive debounce: %u..%u reads, lockout %u..%u ms",
+           DEBOUNCE_ADAPT_MIN_READS, SWITCH_DEBOUNCE_READS, LOCKOUT_POLL_MS,
+           SWITCH_DEBOUNCE_TIME_MS);
+#  ifdef USE_PERSIST
+    printf(", kept in the EEPROM\n");
+#  else
+    printf(", relearned at each power-up\n");
+#  endif
+#else
+    printf("fixed debounce: %u reads, lockout %u ms\n",
+           SWITCH_DEBOUNCE_READS, SWITCH_DEBOUNCE_TIME_MS);
+#endif
+    printf("%u sessions of %u stimuli per phase, %u%% double presses\n",
+           sessions, SESSION_STIMULI, DOUBLE_PERCENT);
+
+    int status = 0;
+#if defined(USE_ADAPTIVE_DEBOUNCE) && defined(USE_PERSIST)
+    // relay state records, ON and OFF, of either lap phase (see
+    // persist_record() in mcu-relay-controller.c)
+    static const uint8_t stale[] = { 0x51, 0x52, 0xD1, 0xD2 };
+    unsigned taken = 0;
+    for (unsigned i=0; i<sizeof(stale); ++i)
+    {
+        sim_eeprom_erase();
+        sim_eeprom[MRC_EEPROM_SIZE - 1] = stale[i];
+        sim_reset();
+        sim_run(FIRST_STIMULUS_US);
+        if ((SWITCH_DEBOUNCE_TARGET != debounce_target) ||
+            (SWITCH_DEBOUNCE_TIME_MS != lockout_polls * LOCKOUT_POLL_MS))
+        {
+            ++taken;
+        }
+    }
+    printf("relay state records in the learned record's cell: %u of %u taken "
+           "for one\n", taken, (unsigned)sizeof(stale));
+    if (taken) { status = 1; }
+#endif
+
+    sim_eeprom_erase();
+    unsigned total_false = 0;
+    unsigned total_missed = 0;
+    unsigned total_presses = 0;
+    for (unsigned p=0; p<N_PHASES; ++p)
+    {
+        result_t r = { 0 };
+        for (unsigned s=0; s<sessions; ++s) { run_session(&phases[p], &r, &rng); }
+
+        char label[64];
+        snprintf(label, sizeof(label), "%-8s latency", phases[p].name);
+        printf("%-8s bounce <=%2u ms, rests <=%.1f ms: presses %u  missed %u "
+               "(second of a double: %u of %u)  glitches %u  false triggers %u",
+               phases[p].name, phases[p].bounce_us / 1000,
+               phases[p].max_gap_us / 1000.0, r.presses, r.missed,
+               r.seconds_missed, r.seconds, r.glitches, r.false_triggers);
+#ifdef USE_ADAPTIVE_DEBOUNCE
+        unsigned reads = 0;
+        for (uint8_t t=debounce_target; t; t >>= 1) { ++reads; }
+        printf("  learned: %u reads, %u ms", reads, lockout_polls * LOCKOUT_POLL_MS);
+#endif
+        printf("\n");
+        sim_stats_print(label, "ms", &r.latency);
+        sim_stats_free(&r.latency);
+        total_false += r.false_triggers;
+        total_missed += r.missed;
+        total_presses += r.presses;
+    }
+    printf("total: presses %u  missed %u  false triggers %u\n",
+           total_presses, total_missed, total_false);
+#if defined(USE_ADAPTIVE_DEBOUNCE) && defined(USE_PERSIST)
+    printf("learned record written %u times (the relay state ring: %u writes "
+           "per cell at most)\n", sim_eeprom_writes[MRC_EEPROM_SIZE - 1],
+           sim_eeprom_writes[0]);
+#endif
+    return status;
+}
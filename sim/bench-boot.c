@@ -0,0 +1,98 @@
+// Copyright (c) Matthew Garman.  All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for
+// license information.
+
+
+/*
+ * boot timeline benchmark: powers up the core's main() on the host
+ * simulation once per target, with that target's software start-up delay
+ * (STARTUP_DELAY_MS in hardware-details/), and reports when
+ *   - the startup coil pulse begins
+ *   - the relay is in a defined state (the end of that pulse; a latching
+ *     relay is in position once its pulse is over)
+ *   - the core first goes to sleep, i.e. starts to respond to presses
+ * from the first instruction, and from power-on, which adds the time the
+ * target is held in reset by hardware (start-up fuses, power-up timer)
+ *
+ * build it with and without USE_FAST_BOOT to compare
+ *
+ * usage: bench-boot
+ */
+
+#include "simlib.h"
+
+#include "../mcu-relay-controller-iface.h"
+
+#include <stdio.h>
+
+#define RUN_US 5000000UL
+
+// start-up delays of each target: held in reset by hardware, then
+// STARTUP_DELAY_MS in software (see hardware-details/)
+typedef struct
+{
+    const char* name;
+    uint32_t reset_hold_ms;
+    uint32_t software_delay_ms;
+} boot_target_t;
+
+static const boot_target_t targets[] =
+{
+#ifdef USE_FAST_BOOT
+    { "attiny13",  64, 0 },  // SUT fuses (factory): 14CK + 64ms
+    { "attiny85",  64, 0 },
+    { "pic12f675", 72, 0 },  // PWRTE = ON: TPWRT
+    { "pic10f320", 64, 0 },
+#else
+    { "attiny13",  64, 10 }, // STARTUP_DELAY_MS, twice
+    { "attiny85",  64, 10 },
+    { "pic12f675", 0,  72 }, // PWRTE = OFF: TPWRT in software
+    { "pic10f320", 0,  64 },
+#endif // USE_FAST_BOOT
+};
+
+static double ms(uint64_t t_us) { return (double)t_us / 1000.0; }
+
+
+int main(int argc, char* argv[])
+{
+#ifdef USE_FAST_BOOT
+    printf("USE_FAST_BOOT, LED_GREETING %d\n", LED_GREETING);
+#else
+    printf("default boot, LED_GREETING %d\n", LED_GREETING);
+#endif // USE_FAST_BOOT
+    printf("%-10s %7s %7s | from first instruction, ms: %10s %10s %10s | "
+           "from power-on: %10s\n", "target", "reset", "delay",
+           "coil on", "defined", "ready", "defined");
+
+    for (size_t i=0; i<sizeof(targets)/sizeof(targets[0]); ++i)
+    {
+        const boot_target_t* t = &targets[i];
+
+        sim_reset();
+        sim_startup_delay_us = t->software_delay_ms * 1000UL;
+        // no presses scripted: the run stops where the core first goes to
+        // sleep
+        uint64_t ready = sim_run(RUN_US);
+
+        uint64_t set = sim_find_edge(SIM_COIL1, HIGH, 0, RUN_US);
+        uint64_t reset = sim_find_edge(SIM_COIL2, HIGH, 0, RUN_US);
+        uint8_t coil = set < reset ? SIM_COIL1 : SIM_COIL2;
+        uint64_t on = set < reset ? set : reset;
+        uint64_t defined = sim_find_edge(coil, LOW, on, RUN_US);
+        if (UINT64_MAX == on || UINT64_MAX == defined || RUN_US == ready)
+        {
+            printf("%-10s: no startup coil pulse, or never went to sleep\n",
+                   t->name);
+            return 1;
+        }
+
+        printf("%-10s %5lums %5lums | %37.3f %10.3f %10.3f | %25.3f\n",
+               t->name, (unsigned long)t->reset_hold_ms,
+               (unsigned long)t->software_delay_ms,
+               ms(on), ms(defined), ms(ready),
+               t->reset_hold_ms + ms(defined));
+    }
+
+    return 0;
+}
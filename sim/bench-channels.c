@@ -0,0 +1,318 @@
+// Copyright (c) Matthew Garman.  All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for
+// license information.
+
+
+/*
+ * multi-channel benchmark: the core's main() built with MRC_N_CHANNELS > 1
+ * on the host simulation, in two parts
+ *   - firmware: random presses on every channel, a lot of them overlapping
+ *     (pressed within a few ms of each other, bouncing at the same time);
+ *     checks that each press moves its own relay exactly once, in the right
+ *     direction, and reports the time awake and the HAL calls per press
+ *   - scaling: the core's vertical-counter debounce (one read of the switch
+ *     port per sample, every channel at once) against one shift-register
+ *     integrator per channel (one pin read each), on the same sampled
+ *     waveforms for 1..MRC_N_CHANNELS channels; checks that both find the
+ *     same presses at the same samples, and reports the cost per sample
+ * exits non-zero on a missed, extra or wrong-direction pulse, or if the two
+ * debounces disagree
+ *
+ * usage: bench-channels [n_slots [n_samples [seed]]]
+ */
+
+#include "simlib.h"
+
+#include "../mcu-relay-controller-iface.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// presses start once the startup coil pulses are over; in each slot, every
+// channel is pressed with probability 1/2, somewhere in its first
+// PRESS_SPREAD_US
+#define FIRST_PRESS_US    200000UL
+#define SLOT_US           600000UL
+#define PRESS_SPREAD_US    20000UL
+
+#define MIN_HOLD_US        80000UL
+#define MAX_HOLD_US       300000UL
+#define MAX_BOUNCE_US       5000UL
+
+#define SCALING_REPEAT 8
+
+// the core's debounce state (see MRC_N_CHANNELS > 1 in
+// mcu-relay-controller.c)
+extern uint8_t vc_state;
+extern uint8_t vc_c0;
+extern uint8_t vc_c1;
+extern uint8_t vc_c2;
+uint8_t debounce_vertical(uint8_t sample);
+
+typedef struct
+{
+    sim_event_t* v;
+    size_t n;
+    size_t cap;
+} edges_t;
+
+static void add_edge(edges_t* e, uint8_t ch, uint64_t t_us, uint8_t level)
+{
+    if (e->n == e->cap)
+    {
+        e->cap = e->cap ? 2 * e->cap : 1024;
+        e->v = realloc(e->v, e->cap * sizeof(*e->v));
+        if (!e->v) { perror("realloc"); exit(1); }
+    }
+    e->v[e->n++] = (sim_event_t){ t_us, SIM_SWITCH, level, ch };
+}
+
+// a transition of channel ch to level at t_us, bouncing for up to bounce_us
+// (as sim_gen_bounce())
+static void gen_bounce(edges_t* e, uint8_t ch, uint64_t t_us,
+                       uint32_t bounce_us, uint8_t final_level, uint32_t* rng)
+{
+    const uint64_t end_us = t_us + bounce_us;
+    uint8_t level = final_level;
+
+    add_edge(e, ch, t_us, level);
+    for (;;)
+    {
+        uint64_t next_us = t_us + sim_rand_range(rng, SIM_BOUNCE_MIN_GAP_US,
+                                                 SIM_BOUNCE_MAX_GAP_US);
+        if (next_us >= end_us) { break; }
+        t_us = next_us;
+        level = !level;
+        add_edge(e, ch, t_us, level);
+    }
+    if (level != final_level) { add_edge(e, ch, end_us, final_level); }
+}
+
+// the edges of one channel are at distinct times (bounce gaps are at least
+// SIM_BOUNCE_MIN_GAP_US), so this keeps them in order
+static int edge_cmp(const void* a, const void* b)
+{
+    const sim_event_t* x = a;
+    const sim_event_t* y = b;
+    if (x->t_us != y->t_us) { return x->t_us < y->t_us ? -1 : 1; }
+    return (int)x->channel - (int)y->channel;
+}
+
+static int run_firmware(unsigned n_slots, uint32_t* rng)
+{
+    edges_t edges = { 0 };
+    unsigned presses[MRC_N_CHANNELS] = { 0 };
+    unsigned overlapping = 0;
+
+    sim_reset();
+    uint64_t slot_us = FIRST_PRESS_US;
+    for (unsigned s=0; s<n_slots; ++s, slot_us += SLOT_US)
+    {
+        unsigned in_slot = 0;
+        for (uint8_t ch=0; ch<MRC_N_CHANNELS; ++ch)
+        {
+            if (sim_rand(rng) & 1) { continue; }
+            uint64_t t_us = slot_us + sim_rand_range(rng, 0, PRESS_SPREAD_US);
+            uint32_t hold = sim_rand_range(rng, MIN_HOLD_US, MAX_HOLD_US);
+            gen_bounce(&edges, ch, t_us,
+                       sim_rand_range(rng, 0, MAX_BOUNCE_US), LOW, rng);
+            gen_bounce(&edges, ch, t_us + hold,
+                       sim_rand_range(rng, 0, MAX_BOUNCE_US), HIGH, rng);
+            ++presses[ch];
+            ++in_slot;
+        }
+        if (in_slot > 1) { overlapping += in_slot; }
+    }
+    // one time-ordered script for all the channels
+    qsort(edges.v, edges.n, sizeof(*edges.v), edge_cmp);
+    for (size_t i=0; i<edges.n; ++i)
+    {
+        sim_channel_switch_add_edge(edges.v[i].channel, edges.v[i].t_us,
+                                    edges.v[i].level);
+    }
+    free(edges.v);
+
+    uint64_t end_us = slot_us + SLOT_US;
+    sim_run(end_us);
+
+    // every pulse after start-up, per channel: the n-th must be the n-th
+    // press, alternately set and reset
+    size_t n;
+    const sim_event_t* log = sim_log(&n);
+    unsigned pulses[MRC_N_CHANNELS] = { 0 };
+    unsigned wrong_direction = 0;
+    unsigned total = 0;
+    for (size_t i=sim_log_lower_bound(FIRST_PRESS_US); i<n; ++i)
+    {
+        const sim_event_t* e = &log[i];
+        if ((SIM_COIL1 != e->signal && SIM_COIL2 != e->signal) ||
+            HIGH != e->level || e->channel >= MRC_N_CHANNELS)
+        {
+            continue;
+        }
+        // the relays start OFF: odd pulses set, even ones reset
+        uint8_t expect = (pulses[e->channel] & 1) ? SIM_COIL2 : SIM_COIL1;
+        if (e->signal != expect) { ++wrong_direction; }
+        ++pulses[e->channel];
+    }
+
+    unsigned missed = 0;
+    unsigned extra = 0;
+    for (uint8_t ch=0; ch<MRC_N_CHANNELS; ++ch)
+    {
+        total += presses[ch];
+        if (pulses[ch] < presses[ch]) { missed += presses[ch] - pulses[ch]; }
+        else                          { extra += pulses[ch] - presses[ch]; }
+    }
+
+    printf("firmware, %u channels: %u presses (%u overlapping another "
+           "channel's)  missed: %u  extra: %u  wrong direction: %u\n",
+           MRC_N_CHANNELS, total, overlapping, missed, extra, wrong_direction);
+    if (total)
+    {
+        printf("  per press: %.3f ms awake, %.1f HAL calls\n",
+               (double)sim_awake_us / 1000.0 / total,
+               (double)sim_hal_calls / total);
+    }
+    return (missed || extra || wrong_direction) ? 1 : 0;
+}
+
+// the switch "port" the scaling benchmark reads from, one sample at a time
+static volatile uint8_t port;
+
+// sampled waveforms: bit n of samples[i] is channel n pressed at sample i;
+// each channel is pressed at random, with bouncy edges
+static void gen_samples(uint8_t* samples, size_t n, uint32_t* rng)
+{
+    for (uint8_t ch=0; ch<8; ++ch)
+    {
+        uint8_t level = 0;
+        size_t i = 0;
+        while (i < n)
+        {
+            size_t hold = sim_rand_range(rng, 20, 300);
+            size_t bounce = sim_rand_range(rng, 0, 6);
+            for (size_t j=0; j<hold && i<n; ++j, ++i)
+            {
+                uint8_t bit = (j < bounce) ? (sim_rand(rng) & 1) : level;
+                if (bit) { samples[i] |= (uint8_t)(1U << ch); }
+                else     { samples[i] &= (uint8_t)~(1U << ch); }
+            }
+            level = !level;
+        }
+    }
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// presses (debounced released => pressed transitions) found by the core's
+// vertical counters over the first n_ch channels; writes the sample index
+// of each to at
+static size_t run_vertical(const uint8_t* samples, size_t n, uint8_t n_ch,
+                           uint32_t* at)
+{
+    uint8_t mask = (uint8_t)((1U << n_ch) - 1);
+    size_t found = 0;
+    vc_state = 0;
+    vc_c0 = vc_c1 = vc_c2 = 0xFF;
+    for (size_t i=0; i<n; ++i)
+    {
+        port = samples[i];
+        uint8_t pressed = debounce_vertical(port & mask) & vc_state;
+        while (pressed)
+        {
+            at[found++] = (uint32_t)i;
+            pressed &= (uint8_t)(pressed - 1);
+        }
+    }
+    return found;
+}
+
+// the same with one 8-read shift register per channel, each read from the
+// port on its own (as n_ch single-channel integrators would)
+static size_t run_per_channel(const uint8_t* samples, size_t n, uint8_t n_ch,
+                              uint32_t* at)
+{
+    uint8_t history[8];
+    uint8_t state[8];
+    size_t found = 0;
+    for (uint8_t ch=0; ch<n_ch; ++ch) { history[ch] = 0; state[ch] = 0; }
+    for (size_t i=0; i<n; ++i)
+    {
+        port = samples[i];
+        for (uint8_t ch=0; ch<n_ch; ++ch)
+        {
+            history[ch] = (uint8_t)(history[ch] << 1) | ((port >> ch) & 1);
+            if (0xFF == history[ch] && !state[ch])
+            {
+                state[ch] = 1;
+                at[found++] = (uint32_t)i;
+            }
+            else if (0x00 == history[ch]) { state[ch] = 0; }
+        }
+    }
+    return found;
+}
+
+static int run_scaling(size_t n_samples, uint32_t* rng)
+{
+    uint8_t* samples = calloc(n_samples, 1);
+    uint32_t* at_v = malloc(n_samples * 8 * sizeof(*at_v));
+    uint32_t* at_p = malloc(n_samples * 8 * sizeof(*at_p));
+    if (!samples || !at_v || !at_p) { perror("malloc"); exit(1); }
+    gen_samples(samples, n_samples, rng);
+
+    int disagree = 0;
+    printf("scaling, %zu samples: %8s %14s %14s %14s %14s\n", n_samples,
+           "channels", "presses", "vertical", "per channel", "reads/sample");
+    for (uint8_t n_ch=1; n_ch<=MRC_N_CHANNELS; ++n_ch)
+    {
+        size_t nv = 0;
+        size_t np = 0;
+        double t0 = now_ns();
+        for (unsigned r=0; r<SCALING_REPEAT; ++r)
+        {
+            nv = run_vertical(samples, n_samples, n_ch, at_v);
+        }
+        double t1 = now_ns();
+        for (unsigned r=0; r<SCALING_REPEAT; ++r)
+        {
+            np = run_per_channel(samples, n_samples, n_ch, at_p);
+        }
+        double t2 = now_ns();
+
+        // within a sample, both list the channels in ascending order
+        uint8_t same = (nv == np);
+        for (size_t i=0; same && i<nv; ++i) { same = (at_v[i] == at_p[i]); }
+        if (!same) { ++disagree; }
+
+        double per = (double)n_samples * SCALING_REPEAT;
+        printf("%36u %14zu %11.2f ns %11.2f ns %9u vs %u%s\n", n_ch, nv,
+               (t1 - t0) / per, (t2 - t1) / per, 1, n_ch,
+               same ? "" : "  DISAGREE");
+    }
+
+    free(at_p);
+    free(at_v);
+    free(samples);
+    return disagree ? 1 : 0;
+}
+
+
+int main(int argc, char* argv[])
+{
+    unsigned n_slots  = argc > 1 ? (unsigned)strtoul(argv[1], NULL, 0) : 500;
+    size_t n_samples  = argc > 2 ? (size_t)strtoul(argv[2], NULL, 0) : 1000000;
+    uint32_t rng      = argc > 3 ? (uint32_t)strtoul(argv[3], NULL, 0) : 1;
+    if (0 == rng) { rng = 1; }
+
+    int rc = run_firmware(n_slots, &rng);
+    rc |= run_scaling(n_samples, &rng);
+    return rc;
+}
@@ -0,0 +1,256 @@
+// Copyright (c) Matthew Garman.  All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for
+// license information.
+
+
+/*
+ * coil pulse scheduling benchmark: the core's multi-channel relay toggle
+ * (MRC_N_CHANNELS > 1) on the host simulation, given random sets of coil
+ * transitions (any channels, each in whichever direction its relay goes),
+ * and the start-up reset of every channel; for each, it checks from the
+ * event log that every relay in the set got one coil pulse, of the right
+ * direction and width, and no other relay any, and that the coils
+ * energized at once never drew more than RELAY_PEAK_MA (see
+ * RELAY_CHANNEL_COIL_MA in mcu-relay-controller-iface.h).  it reports the
+ * time from the first coil energized to the last one released, by the
+ * number of relays in the set, against
+ *   - sequential: one coil after another (the default budget)
+ *   - fewest: the shortest schedule within the budget, from an exhaustive
+ *     search over the ways to split each direction's coils into rounds
+ *   - at once: one pulse per direction, whatever the current
+ * exits non-zero on a wrong, missing or extra pulse, or a budget overrun
+ *
+ * usage: bench-coils [n_sets [seed]]
+ */
+
+#include "simlib.h"
+
+#include "../mcu-relay-controller-iface.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// the core's relay state and toggle (see MRC_N_CHANNELS > 1 in
+// mcu-relay-controller.c)
+extern volatile uint8_t relay_state;
+void relay_channels_toggle(uint8_t mask);
+
+#define SET_US   (RELAY_SET_PULSE_MS * 1000UL)
+#define RESET_US (RELAY_RESET_PULSE_MS * 1000UL)
+
+// longest a set (or the start-up) may take
+#define RUN_LIMIT_US 1000000UL
+
+// coil current of every subset of the channels, and the fewest rounds its
+// coils can be pulsed in within the budget (a coil over the budget on its
+// own takes a round of its own)
+static uint16_t subset_ma[1 << MRC_N_CHANNELS];
+static uint8_t fewest_rounds[1 << MRC_N_CHANNELS];
+
+static void init_subsets(void)
+{
+    for (unsigned s=1; s < (1U << MRC_N_CHANNELS); ++s)
+    {
+        unsigned low = s & -s;
+        unsigned ch = 0;
+        while (!(low & (1U << ch))) { ++ch; }
+        subset_ma[s] = subset_ma[s ^ low] + RELAY_CHANNEL_COIL_MA(ch);
+    }
+    // a round that includes the lowest remaining channel, and the best for
+    // what is left
+    for (unsigned s=1; s < (1U << MRC_N_CHANNELS); ++s)
+    {
+        unsigned low = s & -s;
+        unsigned best = MRC_N_CHANNELS;
+        for (unsigned t=s; t; t = (t - 1) & s)
+        {
+            if (!(t & low)) { continue; }
+            if (t != low && subset_ma[t] > RELAY_PEAK_MA) { continue; }
+            if (1U + fewest_rounds[s ^ t] < best) { best = 1U + fewest_rounds[s ^ t]; }
+        }
+        fewest_rounds[s] = (uint8_t)best;
+    }
+}
+
+static unsigned popcount(unsigned x)
+{
+    unsigned n = 0;
+    for (; x; x &= x - 1) { ++n; }
+    return n;
+}
+
+// what the log shows of the coil pulses within [from_us, to_us)
+typedef struct
+{
+    uint64_t first_us;   // first coil energized
+    uint64_t last_us;    // last coil released
+    uint16_t peak_ma;    // most current drawn at once
+    uint8_t set;         // channels given a set pulse
+    uint8_t reset;       // channels given a reset pulse
+    unsigned errors;     // more than one pulse on a channel, or one too short
+    unsigned over;       // coils energized together beyond the budget (one
+                         // coil on its own may be)
+} coil_log_t;
+
+static coil_log_t scan_coils(uint64_t from_us, uint64_t to_us)
+{
+    coil_log_t c = { UINT64_MAX, 0, 0, 0, 0, 0, 0 };
+    uint64_t start_us[MRC_N_CHANNELS];
+    uint8_t energized = 0;
+    uint8_t pulsed = 0;
+
+    size_t n;
+    const sim_event_t* log = sim_log(&n);
+    for (size_t i=sim_log_lower_bound(from_us); i<n && log[i].t_us < to_us; ++i)
+    {
+        const sim_event_t* e = &log[i];
+        if ((SIM_COIL1 != e->signal && SIM_COIL2 != e->signal) ||
+            e->channel >= MRC_N_CHANNELS)
+        {
+            continue;
+        }
+        uint8_t bit = (uint8_t)(1U << e->channel);
+        if (HIGH == e->level)
+        {
+            if (pulsed & bit) { ++c.errors; }
+            pulsed |= bit;
+            energized |= bit;
+            start_us[e->channel] = e->t_us;
+            if (SIM_COIL1 == e->signal) { c.set |= bit;   }
+            else                        { c.reset |= bit; }
+            if (e->t_us < c.first_us) { c.first_us = e->t_us; }
+            if (subset_ma[energized] > c.peak_ma) { c.peak_ma = subset_ma[energized]; }
+            if (subset_ma[energized] > RELAY_PEAK_MA && popcount(energized) > 1)
+            {
+                ++c.over;
+            }
+        }
+        else
+        {
+            uint64_t width = e->t_us - start_us[e->channel];
+            if (width < (SIM_COIL1 == e->signal ? SET_US : RESET_US)) { ++c.errors; }
+            energized &= (uint8_t)~bit;
+            c.last_us = e->t_us;
+        }
+    }
+    if (energized) { ++c.errors; }
+    return c;
+}
+
+static uint8_t toggle_mask;
+
+static void do_toggle(void) { relay_channels_toggle(toggle_mask); }
+
+// per number of relays in a set: time from the first coil energized to the
+// last released, summed over the sets
+typedef struct
+{
+    unsigned sets;
+    double scheduled_ms;
+    double sequential_ms;
+    double fewest_ms;
+    double at_once_ms;
+    unsigned at_once_peak_ma;
+} by_size_t;
+
+static double schedule_ms(unsigned set_rounds, unsigned reset_rounds)
+{
+    return (set_rounds * (double)SET_US + reset_rounds * (double)RESET_US) / 1000.0;
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned n_sets = argc > 1 ? (unsigned)strtoul(argv[1], NULL, 0) : 20000;
+    uint32_t rng    = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 0) : 1;
+    if (0 == rng) { rng = 1; }
+
+    init_subsets();
+    printf("%u channels, coils of", MRC_N_CHANNELS);
+    for (uint8_t ch=0; ch<MRC_N_CHANNELS; ++ch)
+    {
+        printf(" %u", (unsigned)RELAY_CHANNEL_COIL_MA(ch));
+    }
+    printf(" mA, budget %u mA, set/reset pulses %u/%u ms\n",
+           (unsigned)RELAY_PEAK_MA, RELAY_SET_PULSE_MS, RELAY_RESET_PULSE_MS);
+
+    unsigned wrong = 0;
+    unsigned over = 0;
+    unsigned above_fewest = 0;
+    uint16_t peak_ma = 0;
+
+    // start-up: every relay reset
+    sim_reset();
+    uint64_t end_us = sim_run(RUN_LIMIT_US);
+    coil_log_t c = scan_coils(0, end_us + 1);
+    unsigned all = MRC_CHANNEL_MASK;
+    if (c.errors || c.set || c.reset != all) { ++wrong; }
+    over += c.over;
+    printf("start-up reset of all %u: %.3f ms  (sequential %.3f, fewest %.3f)  "
+           "peak %u mA\n", MRC_N_CHANNELS, (c.last_us - c.first_us) / 1000.0,
+           schedule_ms(0, MRC_N_CHANNELS), schedule_ms(0, fewest_rounds[all]),
+           c.peak_ma);
+
+    by_size_t by_size[MRC_N_CHANNELS + 1] = { 0 };
+    sim_stats_t scheduled = { 0 };
+    sim_stats_t saved = { 0 };
+    for (unsigned i=0; i<n_sets; ++i)
+    {
+        uint8_t state = (uint8_t)(sim_rand(&rng) & MRC_CHANNEL_MASK);
+        uint8_t mask;
+        do { mask = (uint8_t)(sim_rand(&rng) & MRC_CHANNEL_MASK); } while (!mask);
+
+        // relays that are ON get a reset pulse, the others a set pulse
+        relay_state = state;
+        toggle_mask = mask;
+        uint64_t from_us = sim_now_us;
+        sim_call(from_us + RUN_LIMIT_US, do_toggle);
+        c = scan_coils(from_us, sim_now_us + 1);
+
+        uint8_t going_on = mask & (uint8_t)~state;
+        uint8_t going_off = mask & state;
+        if (c.errors || c.set != going_on || c.reset != going_off ||
+            relay_state != (state ^ mask))
+        {
+            ++wrong;
+        }
+        over += c.over;
+        if (c.peak_ma > peak_ma) { peak_ma = c.peak_ma; }
+
+        double ms = (c.last_us - c.first_us) / 1000.0;
+        double fewest = schedule_ms(fewest_rounds[going_on], fewest_rounds[going_off]);
+        double sequential = schedule_ms(popcount(going_on), popcount(going_off));
+        if (ms > fewest + 0.5) { ++above_fewest; }
+
+        by_size_t* b = &by_size[popcount(mask)];
+        ++b->sets;
+        b->scheduled_ms += ms;
+        b->sequential_ms += sequential;
+        b->fewest_ms += fewest;
+        b->at_once_ms += schedule_ms(going_on ? 1 : 0, going_off ? 1 : 0);
+        unsigned at_once = subset_ma[going_on] > subset_ma[going_off]
+                         ? subset_ma[going_on] : subset_ma[going_off];
+        if (at_once > b->at_once_peak_ma) { b->at_once_peak_ma = at_once; }
+        sim_stats_add(&scheduled, ms);
+        sim_stats_add(&saved, sequential - ms);
+    }
+
+    printf("%u sets of transitions  wrong pulses: %u  over budget: %u  "
+           "longer than fewest: %u  peak: %u mA\n",
+           n_sets, wrong, over, above_fewest, peak_ma);
+    printf("%8s %8s %14s %14s %14s %14s %14s\n", "relays", "sets",
+           "sequential", "scheduled", "fewest", "at once", "(peak)");
+    for (unsigned k=1; k<=MRC_N_CHANNELS; ++k)
+    {
+        by_size_t* b = &by_size[k];
+        if (!b->sets) { continue; }
+        printf("%8u %8u %11.3f ms %11.3f ms %11.3f ms %11.3f ms %10u mA\n",
+               k, b->sets, b->sequential_ms / b->sets, b->scheduled_ms / b->sets,
+               b->fewest_ms / b->sets, b->at_once_ms / b->sets,
+               b->at_once_peak_ma);
+    }
+    sim_stats_print("transition time", "ms", &scheduled);
+    sim_stats_print("saved against sequential", "ms", &saved);
+    sim_stats_free(&saved);
+    sim_stats_free(&scheduled);
+    return (wrong || over) ? 1 : 0;
+}
@@ -0,0 +1,711 @@
+// Copyright (c) Matthew Garman.  All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for
+// license information.
+
+
+/*
+ * debounce corpus benchmark: replays a corpus of switch traces through the
+ * core's debounce_switch(), as built (SWITCH_DEBOUNCE_TARGET,
+ * MAX_N_SWITCH_DEBOUNCE_READS), the way main() drives it: sleep until an
+ * edge, debounce, act on a press and sit out SWITCH_DEBOUNCE_TIME_MS, sleep
+ * again.  the traces are spread over a pool of threads, each with a host
+ * simulation of its own.  for every source in the corpus it reports
+ *   - press-detection latency (first edge of the press to debounce_switch()
+ *     returning it) percentiles, and a histogram
+ *   - presses missed
+ *   - false triggers: a second detection within one press (e.g. noise on a
+ *     held switch), or a detection in a trace of noise alone; and a
+ *     histogram of how long the switch had been reading low when they
+ *     happened
+ * a source is one of
+ *   synth:BOUNCE_US[:SPIKES_PER_S]
+ *       generated: a press whose edges bounce for up to BOUNCE_US, with
+ *       noise spikes (the switch reading inverted for SIM_GLITCH_* widths)
+ *       at the given average rate; every press trace is paired with a trace
+ *       of the same noise alone
+ *   FILE[:COLUMN]
+ *       a logic-analyzer capture exported as CSV: time in seconds in the
+ *       first column, the switch level (0/1) in COLUMN (default 1); lines
+ *       that do not start with a number (headers) are skipped.  it is split
+ *       into traces at CAPTURE_GAP_US of the switch released; a press is a
+ *       stretch of CAPTURE_PRESS_MIN_US low, starting at the first falling
+ *       edge after CAPTURE_RELEASE_MIN_US high
+ * to sweep the debounce constants, build one binary per parameter set (make
+ * debounce-sweep) and run them on the same corpus
+ *
+ * usage: bench-debounce [-n traces_per_synth_source] [-j threads] [-s seed]
+ *                       [source ...]
+ */
+
+#include "simlib.h"
+
+#include "../mcu-relay-controller-iface.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#if (DEBOUNCE_STRATEGY != DEBOUNCE_INTEGRATOR) || defined(USE_TIMER_DEBOUNCE)
+// the other variants keep state in the core's globals (or act on the relay
+// from within debounce_switch()), which the threads would share
+#  error "bench-debounce: the busy-wait integrator only"
+#endif
+
+uint8_t debounce_switch(void);
+
+// synthetic traces: idle, a press held for MIN..MAX_HOLD_US, idle
+#define SYNTH_LEAD_US       50000UL
+#define SYNTH_MIN_HOLD_US   80000UL
+#define SYNTH_MAX_HOLD_US  400000UL
+#define SYNTH_TAIL_US      300000UL
+
+#define CAPTURE_GAP_US         500000UL
+#define CAPTURE_PRESS_MIN_US    20000UL
+#define CAPTURE_RELEASE_MIN_US  20000UL
+
+// a replay never runs past the end of its trace by more than this
+#define REPLAY_MARGIN_US  1000000UL
+
+// traces per job handed to a thread
+#define JOB_TRACES 256
+
+// latency histogram: LATENCY_BIN_US wide bins, the last one open-ended
+#define LATENCY_BIN_US 100
+#define LATENCY_BINS   4096
+// false triggers, by time since the switch last went low: 1ms bins
+#define FALSE_BINS     64
+
+#define MAX_SOURCES 32
+
+typedef struct
+{
+    sim_event_t* edges;  // switch transitions, in time order, starting HIGH
+    size_t n_edges;
+    size_t cap_edges;
+    uint64_t* presses;   // first edge of each true press
+    size_t n_presses;
+    size_t cap_presses;
+    uint64_t end_us;
+} trace_t;
+
+typedef struct
+{
+    char name[64];
+    uint32_t bounce_us;  // synth
+    double spike_hz;     // synth
+    trace_t* traces;     // capture: loaded up front
+    size_t n_traces;
+} source_t;
+
+typedef struct
+{
+    uint64_t presses;
+    uint64_t detected;
+    uint64_t false_in_press;
+    uint64_t false_in_noise;
+    uint64_t noise_traces;
+    uint64_t latency_max_us;
+    uint64_t latency[LATENCY_BINS];
+    uint64_t false_low[FALSE_BINS];
+} result_t;
+
+typedef struct
+{
+    size_t source;
+    size_t first;
+    size_t count;
+} job_t;
+
+static source_t sources[MAX_SOURCES];
+static size_t n_sources;
+static size_t n_synth_traces = 20000;
+static uint32_t seed = 1;
+
+static job_t* jobs;
+static size_t n_jobs;
+static atomic_size_t next_job;
+
+static result_t results[MAX_SOURCES];
+static pthread_mutex_t results_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// the replay's detections, per thread (see replay())
+static _Thread_local uint64_t* detections;
+static _Thread_local size_t n_detections;
+static _Thread_local size_t cap_detections;
+
+
+static void* xrealloc(void* p, size_t size)
+{
+    p = realloc(p, size);
+    if (!p) { perror("realloc"); exit(1); }
+    return p;
+}
+
+static void trace_add_edge(trace_t* t, uint64_t t_us, uint8_t level)
+{
+    if (t->n_edges == t->cap_edges)
+    {
+        t->cap_edges = t->cap_edges ? 2 * t->cap_edges : 64;
+        t->edges = xrealloc(t->edges, t->cap_edges * sizeof(*t->edges));
+    }
+    t->edges[t->n_edges++] = (sim_event_t){ t_us, SIM_SWITCH, level, 0 };
+}
+
+static void trace_add_press(trace_t* t, uint64_t t_us)
+{
+    if (t->n_presses == t->cap_presses)
+    {
+        t->cap_presses = t->cap_presses ? 2 * t->cap_presses : 8;
+        t->presses = xrealloc(t->presses, t->cap_presses * sizeof(*t->presses));
+    }
+    t->presses[t->n_presses++] = t_us;
+}
+
+static void trace_clear(trace_t* t)
+{
+    t->n_edges = 0;
+    t->n_presses = 0;
+    t->end_us = 0;
+}
+
+// the seed of trace i of source src: the corpus is the same whatever the
+// number of threads (splitmix64)
+static uint32_t trace_seed(size_t src, size_t i)
+{
+    uint64_t x = ((uint64_t)seed << 40) ^ ((uint64_t)src << 32) ^ i;
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    x ^= x >> 31;
+    return (uint32_t)x ? (uint32_t)x : 1;
+}
+
+// a clean waveform edge: bounce to level from t_us, for up to bounce_us
+// (as sim_gen_bounce())
+static void gen_bounce(trace_t* t, uint64_t t_us, uint32_t bounce_us,
+                       uint8_t final_level, uint32_t* rng)
+{
+    const uint64_t end_us = t_us + bounce_us;
+    uint8_t level = final_level;
+
+    trace_add_edge(t, t_us, level);
+    for (;;)
+    {
+        uint64_t next_us = t_us + sim_rand_range(rng, SIM_BOUNCE_MIN_GAP_US,
+                                                 SIM_BOUNCE_MAX_GAP_US);
+        if (next_us >= end_us) { break; }
+        t_us = next_us;
+        level = !level;
+        trace_add_edge(t, t_us, level);
+    }
+    if (level != final_level) { trace_add_edge(t, end_us, final_level); }
+}
+
+// the clean waveform in clean (ending at clean->end_us), with noise spikes
+// at spike_hz on average laid over it, into out
+static void add_noise(const trace_t* clean, double spike_hz, trace_t* out,
+                      uint32_t* rng)
+{
+    size_t ci = 0;
+    uint8_t clean_level = HIGH;
+    uint8_t level = HIGH;
+    uint64_t t_us = 0;
+
+    for (;;)
+    {
+        // next spike: exponentially distributed gap
+        uint64_t start_us = UINT64_MAX;
+        uint64_t stop_us = UINT64_MAX;
+        if (spike_hz > 0)
+        {
+            double u = (sim_rand(rng) + 1.0) / 4294967297.0;
+            start_us = t_us + (uint64_t)(-log(u) / spike_hz * 1e6);
+            uint8_t is_long = sim_rand_range(rng, 1, 100) <= SIM_GLITCH_LONG_PERCENT;
+            stop_us = start_us + sim_rand_range(rng, SIM_GLITCH_MIN_WIDTH_US,
+                                                is_long ? SIM_GLITCH_LONG_WIDTH_US
+                                                        : SIM_GLITCH_MAX_WIDTH_US);
+        }
+        if (start_us >= clean->end_us) { start_us = stop_us = clean->end_us; }
+
+        // clean edges before the spike, then the spike inverts the reading
+        // until it ends, clean edges and all
+        for (uint8_t in_spike=0; in_spike<2; ++in_spike)
+        {
+            uint64_t until_us = in_spike ? stop_us : start_us;
+            while (ci < clean->n_edges && clean->edges[ci].t_us < until_us)
+            {
+                clean_level = clean->edges[ci].level;
+                uint8_t l = in_spike ? !clean_level : clean_level;
+                if (l != level) { trace_add_edge(out, clean->edges[ci].t_us, l); level = l; }
+                ++ci;
+            }
+            if (until_us >= clean->end_us) { break; }
+            uint8_t l = in_spike ? clean_level : !clean_level;
+            if (l != level) { trace_add_edge(out, until_us, l); level = l; }
+        }
+        if (stop_us >= clean->end_us) { break; }
+        t_us = stop_us;
+    }
+    if (level != clean_level) { trace_add_edge(out, clean->end_us, clean_level); }
+    out->end_us = clean->end_us;
+}
+
+// trace i of a synthetic source: a press (odd i: noise alone)
+static void gen_synth(const source_t* s, size_t src, size_t i, trace_t* clean,
+                      trace_t* out)
+{
+    uint32_t rng = trace_seed(src, i);
+    trace_clear(clean);
+    trace_clear(out);
+
+    uint64_t hold_us = sim_rand_range(&rng, SYNTH_MIN_HOLD_US, SYNTH_MAX_HOLD_US);
+    clean->end_us = SYNTH_LEAD_US + hold_us + s->bounce_us + SYNTH_TAIL_US;
+    if (!(i & 1))
+    {
+        gen_bounce(clean, SYNTH_LEAD_US, sim_rand_range(&rng, 0, s->bounce_us),
+                   LOW, &rng);
+        gen_bounce(clean, SYNTH_LEAD_US + hold_us,
+                   sim_rand_range(&rng, 0, s->bounce_us), HIGH, &rng);
+        trace_add_press(out, SYNTH_LEAD_US);
+    }
+    add_noise(clean, s->spike_hz, out, &rng);
+}
+
+// what main() does with the integrator: unless a press came meanwhile (see
+// MRC_switch_press_pending()), sleep until an edge; debounce, and on a press
+// sit out the lockout; the run ends when the core goes to sleep with no
+// edges left
+static void replay(void)
+{
+    for (;;)
+    {
+        if (!MRC_switch_press_pending()) { MRC_enter_sleep_mode(); }
+        MRC_switch_wake_disarm();
+        if (debounce_switch())
+        {
+            if (n_detections == cap_detections)
+            {
+                cap_detections = cap_detections ? 2 * cap_detections : 16;
+                detections = xrealloc(detections,
+                                      cap_detections * sizeof(*detections));
+            }
+            detections[n_detections++] = sim_now_us;
+
+            // the lockout, polling for the release (see lockout_sleep())
+            uint8_t released = FALSE;
+            for (unsigned i=0; i<SWITCH_DEBOUNCE_TIME_MS / LOCKOUT_POLL_MS; ++i)
+            {
+                MRC_sleep_millisecs(LOCKOUT_POLL_MS);
+                if (HIGH == MRC_switch_pin_get_state()) { released = TRUE; }
+            }
+            if (!released) { MRC_switch_pin_clear_int_flags(); }
+        }
+    }
+}
+
+// time the switch had been reading low at t_us
+static uint64_t low_for_us(const trace_t* t, uint64_t t_us)
+{
+    uint64_t since_us = 0;
+    for (size_t i=0; i<t->n_edges && t->edges[i].t_us <= t_us; ++i)
+    {
+        if (LOW == t->edges[i].level) { since_us = t->edges[i].t_us; }
+    }
+    return t_us - since_us;
+}
+
+static void false_trigger(result_t* r, const trace_t* t, uint64_t t_us)
+{
+    uint64_t bin = low_for_us(t, t_us) / 1000;
+    ++r->false_low[bin < FALSE_BINS ? bin : FALSE_BINS - 1];
+}
+
+static void run_trace(const trace_t* t, result_t* r)
+{
+    sim_reset();
+    for (size_t i=0; i<t->n_edges; ++i)
+    {
+        sim_switch_add_edge(t->edges[i].t_us, t->edges[i].level);
+    }
+    n_detections = 0;
+    sim_call(t->end_us + REPLAY_MARGIN_US, replay);
+
+    // each detection belongs to the last press that started before it
+    r->presses += t->n_presses;
+    if (0 == t->n_presses) { ++r->noise_traces; }
+    size_t p = 0;
+    uint8_t matched = FALSE;
+    for (size_t i=0; i<n_detections; ++i)
+    {
+        uint64_t d = detections[i];
+        while (p < t->n_presses && t->presses[p] <= d) { ++p; matched = FALSE; }
+        if (0 == p)
+        {
+            ++r->false_in_noise;
+            false_trigger(r, t, d);
+        }
+        else if (matched)
+        {
+            ++r->false_in_press;
+            false_trigger(r, t, d);
+        }
+        else
+        {
+            uint64_t lat = d - t->presses[p - 1];
+            uint64_t bin = lat / LATENCY_BIN_US;
+            ++r->latency[bin < LATENCY_BINS ? bin : LATENCY_BINS - 1];
+            if (lat > r->latency_max_us) { r->latency_max_us = lat; }
+            ++r->detected;
+            matched = TRUE;
+        }
+    }
+}
+
+static void* worker(void* arg)
+{
+    result_t* local = calloc(n_sources, sizeof(*local));
+    trace_t clean = { 0 };
+    trace_t synth = { 0 };
+    if (!local) { perror("calloc"); exit(1); }
+
+    for (;;)
+    {
+        size_t j = atomic_fetch_add(&next_job, 1);
+        if (j >= n_jobs) { break; }
+        const source_t* s = &sources[jobs[j].source];
+        for (size_t i=jobs[j].first; i<jobs[j].first + jobs[j].count; ++i)
+        {
+            if (s->traces)
+            {
+                run_trace(&s->traces[i], &local[jobs[j].source]);
+            }
+            else
+            {
+                gen_synth(s, jobs[j].source, i, &clean, &synth);
+                run_trace(&synth, &local[jobs[j].source]);
+            }
+        }
+    }
+
+    pthread_mutex_lock(&results_lock);
+    for (size_t s=0; s<n_sources; ++s)
+    {
+        result_t* r = &results[s];
+        result_t* l = &local[s];
+        r->presses += l->presses;
+        r->detected += l->detected;
+        r->false_in_press += l->false_in_press;
+        r->false_in_noise += l->false_in_noise;
+        r->noise_traces += l->noise_traces;
+        if (l->latency_max_us > r->latency_max_us) { r->latency_max_us = l->latency_max_us; }
+        for (size_t b=0; b<LATENCY_BINS; ++b) { r->latency[b] += l->latency[b]; }
+        for (size_t b=0; b<FALSE_BINS; ++b) { r->false_low[b] += l->false_low[b]; }
+    }
+    pthread_mutex_unlock(&results_lock);
+
+    free(local);
+    free(clean.edges);
+    free(clean.presses);
+    free(synth.edges);
+    free(synth.presses);
+    free(detections);
+    return arg;
+}
+
+// split a capture's edges (in one trace) into traces at long idle gaps,
+// and mark the presses in each
+static void split_capture(source_t* s, const trace_t* all)
+{
+    size_t i = 0;
+    while (i < all->n_edges)
+    {
+        s->traces = xrealloc(s->traces, (s->n_traces + 1) * sizeof(*s->traces));
+        trace_t* t = &s->traces[s->n_traces++];
+        memset(t, 0, sizeof(*t));
+
+        uint64_t release_us = 0;    // last rising edge (start of a high stretch)
+        uint64_t burst_us = 0;      // first falling edge after a long high stretch
+        uint8_t counted = FALSE;    // the burst has been counted as a press
+        for (; i < all->n_edges; ++i)
+        {
+            const sim_event_t* e = &all->edges[i];
+            if (HIGH == e->level)
+            {
+                release_us = e->t_us;
+                trace_add_edge(t, e->t_us, HIGH);
+                if (i + 1 < all->n_edges &&
+                    all->edges[i + 1].t_us - e->t_us >= CAPTURE_GAP_US)
+                {
+                    ++i;
+                    break;
+                }
+                continue;
+            }
+            if (0 == t->n_edges || e->t_us - release_us >= CAPTURE_RELEASE_MIN_US)
+            {
+                burst_us = e->t_us;
+                counted = FALSE;
+            }
+            trace_add_edge(t, e->t_us, LOW);
+            uint64_t until_us = i + 1 < all->n_edges ? all->edges[i + 1].t_us
+                                                     : all->end_us;
+            if (!counted && until_us - e->t_us >= CAPTURE_PRESS_MIN_US)
+            {
+                trace_add_press(t, burst_us);
+                counted = TRUE;
+            }
+        }
+        t->end_us = t->n_edges ? t->edges[t->n_edges - 1].t_us : 0;
+        if (i >= all->n_edges && all->end_us > t->end_us) { t->end_us = all->end_us; }
+    }
+}
+
+// FILE[:COLUMN]
+static int load_capture(source_t* s, const char* spec)
+{
+    char path[1024];
+    unsigned column = 1;
+    snprintf(path, sizeof(path), "%s", spec);
+    char* colon = strrchr(path, ':');
+    if (colon && colon[1] && strspn(colon + 1, "0123456789") == strlen(colon + 1))
+    {
+        column = (unsigned)strtoul(colon + 1, NULL, 10);
+        *colon = '\0';
+    }
+
+    FILE* f = fopen(path, "r");
+    if (!f) { perror(path); return 1; }
+
+    trace_t all = { 0 };
+    uint8_t level = HIGH;
+    uint8_t started = FALSE;  // seen the switch released
+    double t0 = 0;
+    char line[4096];
+    while (fgets(line, sizeof(line), f))
+    {
+        char* end;
+        double t_s = strtod(line, &end);
+        if (end == line) { continue; }  // header, comment, blank
+
+        char* field = end;
+        for (unsigned c=0; c<column && field; ++c)
+        {
+            field = strchr(field, ',');
+            if (field) { ++field; }
+        }
+        if (!field) { continue; }
+        uint8_t l = strtol(field, NULL, 10) ? HIGH : LOW;
+
+        // a trace starts with the switch released: skip to the first high
+        if (!started)
+        {
+            if (LOW == l) { continue; }
+            started = TRUE;
+            t0 = t_s;
+        }
+        uint64_t t_us = (uint64_t)llround((t_s - t0) * 1e6);
+        all.end_us = t_us;
+        if (l != level)
+        {
+            trace_add_edge(&all, t_us, l);
+            level = l;
+        }
+    }
+    fclose(f);
+
+    snprintf(s->name, sizeof(s->name), "%s", spec);
+    split_capture(s, &all);
+    free(all.edges);
+    if (0 == s->n_traces)
+    {
+        fprintf(stderr, "%s: no switch transitions\n", spec);
+        return 1;
+    }
+    return 0;
+}
+
+static int add_source(const char* spec)
+{
+    if (n_sources == MAX_SOURCES)
+    {
+        fprintf(stderr, "at most %d sources\n", MAX_SOURCES);
+        return 1;
+    }
+    source_t* s = &sources[n_sources];
+    memset(s, 0, sizeof(*s));
+
+    if (0 == strncmp(spec, "synth:", 6))
+    {
+        char* end;
+        s->bounce_us = (uint32_t)strtoul(spec + 6, &end, 0);
+        if (':' == *end) { s->spike_hz = strtod(end + 1, &end); }
+        if (*end)
+        {
+            fprintf(stderr, "%s: expected synth:BOUNCE_US[:SPIKES_PER_S]\n", spec);
+            return 1;
+        }
+        snprintf(s->name, sizeof(s->name), "%s", spec);
+        s->n_traces = 2 * n_synth_traces;  // press, noise alone, ...
+    }
+    else if (load_capture(s, spec))
+    {
+        return 1;
+    }
+    ++n_sources;
+    return 0;
+}
+
+static double latency_percentile(const result_t* r, double q)
+{
+    uint64_t want = (uint64_t)ceil(q * r->detected);
+    uint64_t seen = 0;
+    for (size_t b=0; b<LATENCY_BINS; ++b)
+    {
+        seen += r->latency[b];
+        if (seen >= want && seen) { return (double)(b * LATENCY_BIN_US) / 1000.0; }
+    }
+    return 0;
+}
+
+static void print_bar(uint64_t n, uint64_t max)
+{
+    int width = max ? (int)((n * 40 + max - 1) / max) : 0;
+    for (int i=0; i<width; ++i) { putchar('#'); }
+    putchar('\n');
+}
+
+static void print_histograms(const result_t* r)
+{
+    // latency, 1ms bins, over the range that has any
+    uint64_t ms_bins[LATENCY_BINS * LATENCY_BIN_US / 1000] = { 0 };
+    size_t n_ms = sizeof(ms_bins) / sizeof(ms_bins[0]);
+    for (size_t b=0; b<LATENCY_BINS; ++b) { ms_bins[b * LATENCY_BIN_US / 1000] += r->latency[b]; }
+    size_t lo = 0;
+    size_t hi = n_ms;
+    while (lo < hi && !ms_bins[lo]) { ++lo; }
+    while (hi > lo && !ms_bins[hi - 1]) { --hi; }
+    uint64_t max = 0;
+    for (size_t b=lo; b<hi; ++b) { if (ms_bins[b] > max) { max = ms_bins[b]; } }
+    for (size_t b=lo; b<hi; ++b)
+    {
+        printf("    latency %3zu..%3zu ms %10llu ", b, b + 1,
+               (unsigned long long)ms_bins[b]);
+        print_bar(ms_bins[b], max);
+    }
+
+    max = 0;
+    for (size_t b=0; b<FALSE_BINS; ++b) { if (r->false_low[b] > max) { max = r->false_low[b]; } }
+    for (size_t b=0; b<FALSE_BINS; ++b)
+    {
+        if (!r->false_low[b]) { continue; }
+        printf("    false trigger, low for %2zu..%2zu%s ms %8llu ", b, b + 1,
+               b == FALSE_BINS - 1 ? "+" : " ", (unsigned long long)r->false_low[b]);
+        print_bar(r->false_low[b], max);
+    }
+}
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+int main(int argc, char* argv[])
+{
+    long n_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    int opt;
+    while (-1 != (opt = getopt(argc, argv, "n:j:s:")))
+    {
+        switch (opt)
+        {
+            case 'n': n_synth_traces = strtoul(optarg, NULL, 0); break;
+            case 'j': n_threads = strtol(optarg, NULL, 0);       break;
+            case 's': seed = (uint32_t)strtoul(optarg, NULL, 0); break;
+            default:
+                fprintf(stderr, "usage: %s [-n traces_per_synth_source] "
+                        "[-j threads] [-s seed] [source ...]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (n_threads < 1) { n_threads = 1; }
+
+    if (optind == argc)
+    {
+        // a new switch, a worn one, and both with RF noise on the wire
+        const char* corpus[] = { "synth:1000", "synth:5000", "synth:20000",
+                                 "synth:5000:20", "synth:20000:20" };
+        for (size_t i=0; i<sizeof(corpus)/sizeof(corpus[0]); ++i)
+        {
+            if (add_source(corpus[i])) { return 1; }
+        }
+    }
+    for (int i=optind; i<argc; ++i)
+    {
+        if (add_source(argv[i])) { return 1; }
+    }
+
+    for (size_t s=0; s<n_sources; ++s)
+    {
+        for (size_t i=0; i<sources[s].n_traces; i+=JOB_TRACES)
+        {
+            jobs = xrealloc(jobs, (n_jobs + 1) * sizeof(*jobs));
+            size_t left = sources[s].n_traces - i;
+            jobs[n_jobs++] = (job_t){ s, i, left < JOB_TRACES ? left : JOB_TRACES };
+        }
+    }
+
+    double t0 = now_s();
+    pthread_t* threads = xrealloc(NULL, n_threads * sizeof(*threads));
+    for (long i=0; i<n_threads; ++i)
+    {
+        if (pthread_create(&threads[i], NULL, worker, NULL))
+        {
+            perror("pthread_create");
+            return 1;
+        }
+    }
+    for (long i=0; i<n_threads; ++i) { pthread_join(threads[i], NULL); }
+    double elapsed = now_s() - t0;
+
+    uint64_t total_presses = 0;
+    uint64_t total_traces = 0;
+    for (size_t s=0; s<n_sources; ++s)
+    {
+        total_presses += results[s].presses;
+        total_traces += sources[s].n_traces;
+    }
+    printf("SWITCH_DEBOUNCE_TARGET 0x%02X, MAX_N_SWITCH_DEBOUNCE_READS %d, "
+           "SWITCH_DEBOUNCE_TIME_MS %d\n", SWITCH_DEBOUNCE_TARGET,
+           MAX_N_SWITCH_DEBOUNCE_READS, SWITCH_DEBOUNCE_TIME_MS);
+    printf("%llu traces (%llu presses) on %ld threads in %.2fs\n",
+           (unsigned long long)total_traces, (unsigned long long)total_presses,
+           n_threads, elapsed);
+    printf("%-24s %9s %8s %13s %13s | latency ms: %6s %6s %6s %6s\n",
+           "source", "presses", "missed", "false (held)", "false (noise)",
+           "p50", "p90", "p99", "max");
+    for (size_t s=0; s<n_sources; ++s)
+    {
+        const result_t* r = &results[s];
+        printf("%-24s %9llu %8llu %13llu %13llu | %18.1f %6.1f %6.1f %6.1f\n",
+               sources[s].name, (unsigned long long)r->presses,
+               (unsigned long long)(r->presses - r->detected),
+               (unsigned long long)r->false_in_press,
+               (unsigned long long)r->false_in_noise,
+               latency_percentile(r, 0.50), latency_percentile(r, 0.90),
+               latency_percentile(r, 0.99), r->latency_max_us / 1000.0);
+    }
+    for (size_t s=0; s<n_sources; ++s)
+    {
+        printf("%s:\n", sources[s].name);
+        print_histograms(&results[s]);
+    }
+
+    return 0;
+}
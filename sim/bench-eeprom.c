@@ -0,0 +1,267 @@
+// Copyright (c) Matthew Garman.  All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for
+// license information.
+
+
+/*
+ * relay state persistence benchmark: drives the core's main() (built with
+ * USE_PERSIST) on the host simulation, in two parts
+ *   - power cuts: runs of a few presses, each cut off at a random moment
+ *     (tearing any EEPROM write in progress), then powered up again; checks
+ *     that the relay comes back in the state it was left in, or in the one
+ *     before it if the cut came before that state's record was complete
+ *   - lap wraps: a full ring of records from the previous lap, and a
+ *     press whose record, the first of the new lap (in cell 0), is cut off
+ *     at a random moment; checks the state restored at the next power-up,
+ *     and after one more toggle, at the one after that
+ *   - endurance: a long series of toggles on a blank EEPROM, counting the
+ *     writes each cell takes; extrapolates the toggles each target survives
+ *     before its most worn cell reaches the rated endurance, against
+ *     writing the state to a single cell
+ * exits non-zero if a power-up restores the wrong state
+ *
+ * usage: bench-eeprom [n_cuts [n_toggles [toggles_per_day [seed]]]]
+ */
+
+#include "simlib.h"
+
+#include "../mcu-relay-controller-iface.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// presses start once the startup LED greeting (and the restoring coil
+// pulse) is over
+#define FIRST_PRESS_US   3000000UL
+#define PRESS_PERIOD_US   600000UL
+#define PRESS_JITTER_US   200000UL
+#define MAX_PRESSES_PER_RUN    4
+
+#define MIN_HOLD_US        80000UL
+#define MAX_HOLD_US       300000UL
+#define MAX_BOUNCE_US       5000UL
+
+// data EEPROM of each target, and its rated erase/write endurance per cell
+typedef struct
+{
+    const char* name;
+    uint16_t size;
+    uint32_t endurance;
+} eeprom_target_t;
+
+static const eeprom_target_t targets[] =
+{
+    { "attiny13",  64,  100000 },
+    { "attiny85",  512, 100000 },
+    { "pic12f675", 128, 1000000 }, // typical; 100000 minimum
+};
+
+static uint8_t relay_at(uint64_t t_us)
+{
+    uint8_t level[SIM_N_SIGNALS];
+    sim_levels_at(t_us, level);
+    return level[SIM_RELAY];
+}
+
+static uint64_t last_edge(uint8_t signal, uint8_t level, uint64_t to_us)
+{
+    size_t n;
+    const sim_event_t* log = sim_log(&n);
+    for (size_t i=sim_log_lower_bound(to_us); i-- > 0; )
+    {
+        if (log[i].signal == signal && log[i].level == level) { return log[i].t_us; }
+    }
+    return 0;
+}
+
+// the lap wrap cuts land within this long of the write's start (a write
+// takes a few ms; see SIM_EEPROM_WRITE_US in hardware-details/hostsim.c)
+#define TEAR_WINDOW_US      4000UL
+#define TEAR_MARGIN_US       500UL
+
+// a ring record as the core writes it (see persist_record() in
+// mcu-relay-controller.c); the ring spans the whole EEPROM in this build
+#define RING_CELLS MRC_EEPROM_SIZE
+static uint8_t ring_record(uint8_t phase, uint8_t state)
+{
+    return (uint8_t)((phase << 7) | 0x50 | (state ? 0b01 : 0b10));
+}
+
+static uint8_t ring_valid(uint8_t rec)
+{
+    return (0x50 == (rec & 0x7C)) && ((rec ^ (rec >> 1)) & 1);
+}
+
+// power up and let the startup (and the restoring coil pulse) run
+static uint8_t power_up_state(void)
+{
+    sim_reset();
+    sim_run(FIRST_PRESS_US);
+    return relay_at(FIRST_PRESS_US);
+}
+
+// script presses from FIRST_PRESS_US on; returns the time of the last one
+static uint64_t script_presses(unsigned n, uint32_t* rng)
+{
+    uint64_t t_us = FIRST_PRESS_US;
+    uint64_t last_us = t_us;
+    for (unsigned i=0; i<n; ++i)
+    {
+        sim_gen_press(t_us, sim_rand_range(rng, MIN_HOLD_US, MAX_HOLD_US),
+                      sim_rand_range(rng, 0, MAX_BOUNCE_US), rng);
+        last_us = t_us;
+        t_us += PRESS_PERIOD_US + sim_rand_range(rng, 0, PRESS_JITTER_US);
+    }
+    return last_us;
+}
+
+
+int main(int argc, char* argv[])
+{
+    unsigned n_cuts          = argc > 1 ? (unsigned)strtoul(argv[1], NULL, 0) : 1000;
+    unsigned n_toggles       = argc > 2 ? (unsigned)strtoul(argv[2], NULL, 0) : 20000;
+    double   toggles_per_day = argc > 3 ? strtod(argv[3], NULL) : 200;
+    uint32_t rng             = argc > 4 ? (uint32_t)strtoul(argv[4], NULL, 0) : 1;
+    if (0 == rng) { rng = 1; }
+
+    // power cuts
+    sim_eeprom_erase();
+    uint8_t expect = OFF;      // state the relay was left in
+    uint8_t expect_prev = OFF; // the one before, if its record may be lost
+    unsigned restored = 0;
+    unsigned lost_last = 0;
+    unsigned wrong = 0;
+    for (unsigned c=0; c<=n_cuts; ++c)
+    {
+        sim_reset();
+        unsigned n_presses = c < n_cuts ? sim_rand_range(&rng, 0, MAX_PRESSES_PER_RUN) : 0;
+        uint64_t last_us = script_presses(n_presses, &rng);
+        uint64_t cut_us = c < n_cuts
+                        ? sim_rand_range(&rng, FIRST_PRESS_US,
+                                         last_us + PRESS_PERIOD_US)
+                        : FIRST_PRESS_US;
+        sim_run(cut_us);
+
+        uint8_t state = relay_at(FIRST_PRESS_US);
+        if (c > 0)
+        {
+            if (state == expect)           { ++restored;  }
+            else if (state == expect_prev) { ++lost_last; }
+            else                           { ++wrong;     }
+        }
+
+        // the record of the last toggle before the cut may not have been
+        // written (or finished) yet: its write starts after its coil pulse
+        uint64_t now_us = sim_now_us;
+        uint64_t coil_us = last_edge(SIM_COIL1, HIGH, now_us + 1);
+        uint64_t coil2_us = last_edge(SIM_COIL2, HIGH, now_us + 1);
+        if (coil2_us > coil_us) { coil_us = coil2_us; }
+        uint64_t write_us = last_edge(SIM_EEPROM_BUSY, LOW, now_us + 1);
+        uint8_t final = relay_at(now_us + 1);
+        uint8_t toggled = (coil_us >= FIRST_PRESS_US);
+        expect_prev = (toggled && write_us < coil_us) ? !final : final;
+        expect = final;
+    }
+
+    printf("power cuts: %u  restored: %u  lost the last toggle (cut before "
+           "its record was complete): %u  wrong state: %u\n",
+           n_cuts, restored, lost_last, wrong);
+
+    // lap wraps: cells 0..RING_CELLS-1 hold the previous lap, the last one
+    // the state the relay was left in; the first record of the new lap is
+    // torn
+    unsigned wraps = 0;
+    unsigned wrap_wrong = 0;
+    unsigned wrap_torn = 0;
+    for (unsigned c=0; c<n_cuts; ++c)
+    {
+        uint8_t phase = (uint8_t)(c & 1);
+        uint8_t left = (uint8_t)((c >> 1) & 1);
+        sim_eeprom_erase();
+        for (uint16_t i=0; i<RING_CELLS; ++i)
+        {
+            uint8_t st = (i == RING_CELLS - 1) ? left : (uint8_t)(sim_rand(&rng) & 1);
+            sim_eeprom[i] = ring_record(phase, st);
+        }
+        uint8_t old = sim_eeprom[0];
+        uint8_t ring[RING_CELLS];
+        memcpy(ring, sim_eeprom, sizeof(ring));
+
+        // a dry run of the press finds its write, then the same press is
+        // cut off around it
+        uint32_t press_rng = rng;
+        sim_reset();
+        uint64_t last_us = script_presses(1, &rng);
+        sim_run(last_us + PRESS_PERIOD_US);
+        uint64_t write_us = sim_find_edge(SIM_EEPROM_BUSY, HIGH, last_us, sim_now_us + 1);
+        memcpy(sim_eeprom, ring, sizeof(ring));
+        sim_reset();
+        script_presses(1, &press_rng);
+        sim_run(sim_rand_range(&rng, write_us - TEAR_MARGIN_US,
+                               write_us + TEAR_WINDOW_US + TEAR_MARGIN_US));
+        ++wraps;
+
+        // the cut may have come before the write, or after it: the record
+        // in cell 0 counts if it is whole and of the new lap
+        uint8_t first_state = power_up_state();
+        uint8_t rec = sim_eeprom[0];
+        uint8_t expect_first = left;
+        if (ring_valid(rec) && ((rec >> 7) != phase)) { expect_first = rec & 1; }
+        else if (rec != old)                          { ++wrap_torn; }
+        if (first_state != expect_first) { ++wrap_wrong; }
+
+        // one more toggle, with no cut, and power up again
+        sim_reset();
+        script_presses(1, &rng);
+        sim_run(FIRST_PRESS_US + PRESS_PERIOD_US);
+        if (power_up_state() != !first_state) { ++wrap_wrong; }
+    }
+    printf("lap wraps: %u  first record of the lap torn: %u  wrong state: %u\n",
+           wraps, wrap_torn, wrap_wrong);
+
+    // endurance
+    sim_reset();
+    sim_eeprom_erase();
+    uint64_t end_us = script_presses(n_toggles, &rng) + PRESS_PERIOD_US;
+    sim_run(end_us);
+
+    unsigned toggles = sim_count_edges(SIM_RELAY, HIGH, FIRST_PRESS_US, end_us) +
+                       sim_count_edges(SIM_RELAY, LOW, FIRST_PRESS_US, end_us);
+    uint64_t writes = 0;
+    uint32_t max_writes = 0;
+    uint32_t min_writes = UINT32_MAX;
+    for (uint16_t i=0; i<MRC_EEPROM_SIZE; ++i)
+    {
+        writes += sim_eeprom_writes[i];
+        if (sim_eeprom_writes[i] > max_writes) { max_writes = sim_eeprom_writes[i]; }
+        if (sim_eeprom_writes[i] < min_writes) { min_writes = sim_eeprom_writes[i]; }
+    }
+    if (0 == toggles || 0 == max_writes)
+    {
+        printf("endurance: no toggles\n");
+        return 1;
+    }
+
+    // wear of the most worn cell per toggle, relative to an even spread
+    double spread = (double)max_writes * MRC_EEPROM_SIZE / (double)writes;
+    printf("endurance: %u toggles, %llu writes (%.3f per toggle) over %u "
+           "cells: %u..%u per cell (most worn %.2fx the mean)\n",
+           toggles, (unsigned long long)writes, (double)writes / toggles,
+           MRC_EEPROM_SIZE, min_writes, max_writes, spread);
+    printf("%-10s %6s %10s %16s %10s %16s %10s\n", "target", "bytes",
+           "endurance", "single cell", "years", "ring", "years");
+    for (size_t i=0; i<sizeof(targets)/sizeof(targets[0]); ++i)
+    {
+        const eeprom_target_t* t = &targets[i];
+        double per_toggle = (double)writes / toggles;
+        double single = t->endurance / per_toggle;
+        double ring = single * t->size / spread;
+        printf("%-10s %6u %10lu %16.0f %10.1f %16.0f %10.1f\n",
+               t->name, t->size, (unsigned long)t->endurance,
+               single, single / toggles_per_day / 365.0,
+               ring, ring / toggles_per_day / 365.0);
+    }
+
+    return (wrong || wrap_wrong) ? 1 : 0;
+}
@@ -0,0 +1,213 @@
+// Copyright (c) Matthew Garman.  All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for
+// license information.
+
+
+/*
+ * energy report: drives the core's main() with a series of bouncing switch
+ * presses on the host simulation, attributes the simulated time to the
+ * core's power states (see POWER_STATE_* in mcu-relay-controller-iface.h),
+ * and turns it into charge per press, average supply current and battery
+ * life for each target, using the currents in sim/energy.c
+ *
+ * with USE_NON_LATCHING, the relay's hold current while it is ON (as the LED
+ * is, led_on_percent of the time) is part of the average, and is compared
+ * with holding at the full coil current
+ *
+ * with USE_LED_DIM, the LED is dimmed (LED_DIM_METHOD, LED_DIM_PERCENT) in
+ * the average; each method is compared with the LED at full brightness, at
+ * a few brightness settings, and the run is checked: the mcu never sleeps
+ * with the relay ON and the LED at full brightness
+ *
+ * usage: bench-energy [presses_per_hour [battery_mAh [led_on_percent
+ *                     [n_presses [supply_mV]]]]]
+ * (the supply voltage is what USE_VCC_COMPENSATION measures; the currents
+ * in the table are not scaled by it)
+ */
+
+#include "energy.h"
+#include "simlib.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define FIRST_PRESS_US    3000000UL
+#define PRESS_PERIOD_US    600000UL
+#define PRESS_JITTER_US    200000UL
+
+#define MIN_HOLD_US         80000UL
+#define MAX_HOLD_US        400000UL
+#define MAX_BOUNCE_US        5000UL
+
+#ifdef USE_LED_DIM
+// brightness settings compared, in percent
+static const unsigned dim_percents[] = { 5, 10, 25, 50 };
+#define N_DIM_PERCENTS (sizeof(dim_percents) / sizeof(dim_percents[0]))
+
+// time asleep with the relay ON and the LED not dimmed
+static double undimmed_us(uint64_t from_us, uint64_t to_us)
+{
+    size_t n;
+    const sim_event_t* log = sim_log(&n);
+    uint8_t level[SIM_N_SIGNALS];
+    uint64_t t_us = from_us;
+    double us = 0;
+
+    sim_levels_at(from_us, level);
+    for (size_t i=sim_log_lower_bound(from_us); i<=n; ++i)
+    {
+        uint64_t next_us = (i < n && log[i].t_us < to_us) ? log[i].t_us : to_us;
+        if (!level[SIM_AWAKE] && level[SIM_LED] && !level[SIM_LED_DIM])
+        {
+            us += (double)(next_us - t_us);
+        }
+        if (next_us == to_us) { break; }
+        level[log[i].signal] = log[i].level;
+        t_us = next_us;
+    }
+    return us;
+}
+#endif // USE_LED_DIM
+
+
+int main(int argc, char* argv[])
+{
+    double presses_per_hour = argc > 1 ? strtod(argv[1], NULL) : 60;
+    double battery_mAh      = argc > 2 ? strtod(argv[2], NULL) : 500;
+    double led_on_fraction  = argc > 3 ? strtod(argv[3], NULL) / 100.0 : 0.5;
+    unsigned n_presses      = argc > 4 ? (unsigned)strtoul(argv[4], NULL, 0) : 1000;
+    if (argc > 5) { sim_vcc_mv = (uint16_t)strtoul(argv[5], NULL, 0); }
+    uint32_t rng = 1;
+
+    if (0 == n_presses) { n_presses = 1; }
+
+    sim_reset();
+    uint64_t t_us = FIRST_PRESS_US;
+    for (unsigned i=0; i<n_presses; ++i)
+    {
+        sim_gen_press(t_us,
+                      sim_rand_range(&rng, MIN_HOLD_US, MAX_HOLD_US),
+                      sim_rand_range(&rng, 0, MAX_BOUNCE_US),
+                      &rng);
+        t_us += PRESS_PERIOD_US + sim_rand_range(&rng, 0, PRESS_JITTER_US);
+    }
+    sim_run(t_us);
+
+    printf("%u presses at %umV; %.0f presses/hour, LED on %.0f%% of the time, "
+           "%.0f mAh battery\n", n_presses, sim_vcc_mv,
+           presses_per_hour, 100.0 * led_on_fraction, battery_mAh);
+
+    // time per press does not depend on the target
+    energy_account_t acct;
+    energy_account(&energy_targets[0], FIRST_PRESS_US, t_us, &acct);
+    printf("%-10s", "per press");
+    for (uint8_t b=0; b<ENERGY_N_BUCKETS; ++b)
+    {
+        if (ENERGY_SLEEP == b || ENERGY_HOLD == b) { continue; }
+        printf(" %8s=%-8.3f", energy_bucket_names[b],
+               acct.t_us[b] / 1000.0 / n_presses);
+    }
+    printf(" ms\n");
+
+    // the LED's share can swamp everything else, so also without it
+    printf("%-10s %-16s %9s %9s %9s %9s %10s %9s %10s\n",
+           "target", "board", "uC/press", "(coil)", "sleep uA",
+           "avg uA", "life days", "no-LED uA", "life days");
+    for (size_t i=0; i<n_energy_targets; ++i)
+    {
+        const energy_target_t* tgt = &energy_targets[i];
+#ifdef USE_NON_LATCHING
+        if (0 == tgt->hold_duty)
+        {
+            printf("%-10s %-16s (no non-latching support)\n", tgt->name, tgt->board);
+            continue;
+        }
+#endif // USE_NON_LATCHING
+#ifdef USE_LED_DIM
+        if (0 == energy_on_mA(tgt, ENERGY_HOLD_NONE,
+                              (LED_DIM_METHOD == LED_DIM_WDT) ? ENERGY_LED_WDT : ENERGY_LED_PWM,
+                              LED_DIM_PERCENT / 100.0))
+        {
+            printf("%-10s %-16s (no LED dimming support)\n", tgt->name, tgt->board);
+            continue;
+        }
+#endif // USE_LED_DIM
+        energy_account(tgt, FIRST_PRESS_US, t_us, &acct);
+
+        double press_uC = 0;
+        for (uint8_t b=0; b<ENERGY_N_BUCKETS; ++b)
+        {
+            if (ENERGY_HOLD != b) { press_uC += acct.charge_uC[b]; }
+        }
+        press_uC /= n_presses;
+
+        double avg_uA = energy_average_uA(tgt, &acct, n_presses, presses_per_hour,
+                                          led_on_fraction, TRUE);
+        double no_led_uA = energy_average_uA(tgt, &acct, n_presses, presses_per_hour,
+                                             led_on_fraction, FALSE);
+        printf("%-10s %-16s %9.1f %9.1f %9.3f %9.1f %10.1f %9.2f %10.0f\n",
+               tgt->name, tgt->board, press_uC,
+               acct.charge_uC[ENERGY_COIL] / n_presses, tgt->sleep_uA,
+               avg_uA, battery_mAh * 1000.0 / avg_uA / 24.0,
+               no_led_uA, battery_mAh * 1000.0 / no_led_uA / 24.0);
+    }
+
+#ifdef USE_NON_LATCHING
+    // the hold against the full coil current (with the mcu in power-down),
+    // while ON, and on average
+    printf("relay held ON at %u%% duty (continuous: full coil current, mcu in "
+           "power-down)\n", RELAY_HOLD_PERCENT);
+    printf("%-10s %13s %9s %9s %9s %11s\n", "target", "continuous mA",
+           "hold mA", "saved mA", "saved %", "avg saved mA");
+    for (size_t i=0; i<n_energy_targets; ++i)
+    {
+        const energy_target_t* tgt = &energy_targets[i];
+        if (0 == tgt->hold_duty) { continue; }
+        double full_mA = energy_on_mA(tgt, ENERGY_HOLD_FULL, ENERGY_LED_OFF, 0);
+        double hold_mA = energy_on_mA(tgt, ENERGY_HOLD_PWM, ENERGY_LED_OFF, 0);
+        printf("%-10s %13.2f %9.2f %9.2f %9.1f %11.2f\n", tgt->name, full_mA,
+               hold_mA, full_mA - hold_mA, 100.0 * (full_mA - hold_mA) / full_mA,
+               led_on_fraction * (full_mA - hold_mA));
+    }
+#endif // USE_NON_LATCHING
+
+#ifdef USE_LED_DIM
+    // the LED alone, while the relay is ON and the mcu waits for a press
+    double bad_us = undimmed_us(FIRST_PRESS_US, t_us);
+    printf("LED lit while ON, mA above power-down (built: %s at %u%%); "
+           "asleep at full brightness: %.0f ms\n",
+           (LED_DIM_METHOD == LED_DIM_WDT) ? "wdt" : "pwm", LED_DIM_PERCENT,
+           bad_us / 1000.0);
+    printf("%-10s %-7s %9s", "target", "method", "full");
+    for (size_t k=0; k<N_DIM_PERCENTS; ++k) { printf(" %8u%%", dim_percents[k]); }
+    printf("\n");
+    for (size_t i=0; i<n_energy_targets; ++i)
+    {
+        const energy_target_t* tgt = &energy_targets[i];
+        static const struct { const char* name; uint8_t led; } methods[] =
+        {
+            { "pwm", ENERGY_LED_PWM },
+            { "wdt", ENERGY_LED_WDT },
+        };
+        for (size_t m=0; m<sizeof(methods)/sizeof(methods[0]); ++m)
+        {
+            printf("%-10s %-7s %9.3f", tgt->name, methods[m].name,
+                   energy_on_mA(tgt, ENERGY_HOLD_NONE, ENERGY_LED_FULL, 1));
+            if ((ENERGY_LED_PWM == methods[m].led && PWM_WAIT_NONE == tgt->led_pwm_wait) ||
+                (ENERGY_LED_WDT == methods[m].led && 0 == tgt->wdt_ms))
+            {
+                printf("  (not supported)\n");
+                continue;
+            }
+            for (size_t k=0; k<N_DIM_PERCENTS; ++k)
+            {
+                printf(" %9.3f", energy_on_mA(tgt, ENERGY_HOLD_NONE, methods[m].led,
+                                              dim_percents[k] / 100.0));
+            }
+            printf("\n");
+        }
+    }
+    if (bad_us > 0) { return 1; }
+#endif // USE_LED_DIM
+    return 0;
+}
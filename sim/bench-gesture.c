@@ -0,0 +1,171 @@
+// Copyright (c) Matthew Garman.  All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for
+// license information.
+
+
+/*
+ * gesture benchmark: drives the core's main() (built with USE_GESTURES)
+ * with a random mix of taps, long presses and double taps on the host
+ * simulation, and checks where each one leaves the relay (the relay contact
+ * model in hostsim.h): a tap toggles it, a long press and a double tap
+ * leave it where it was (without GESTURE_DOUBLE_TAP_ACTION(), a double tap
+ * is two taps, which do the same); reports, per gesture:
+ *   - latency from the first switch edge to the first relay coil edge
+ *     (or the end of a non-latching relay's hold)
+ *   - coil pulses (and hold ends)
+ *   - awake time
+ * and exits non-zero if a coil pulse starts (or a hold ends) on the low
+ * clock (USE_CLOCK_SCALING): the pulse is timed, and with
+ * USE_VCC_COMPENSATION the supply measured, for the normal one
+ *
+ * usage: bench-gesture [n_gestures [seed]]
+ */
+
+#include "simlib.h"
+
+#include "../mcu-relay-controller-iface.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define FIRST_GESTURE_US  3000000UL
+#define GESTURE_PERIOD_US 2500000UL
+#define GESTURE_JITTER_US  500000UL
+
+#define MAX_BOUNCE_US        5000UL
+
+// well clear of GESTURE_LONG_PRESS_MS/GESTURE_DOUBLE_TAP_MS, allowing for
+// bounce and debounce
+#define TAP_MIN_US          60000UL
+#define TAP_MAX_US   ((GESTURE_LONG_PRESS_MS - 60) * 1000UL)
+#define LONG_MIN_US  ((GESTURE_LONG_PRESS_MS + 60) * 1000UL)
+#define LONG_MAX_US  ((GESTURE_LONG_PRESS_MS * 4) * 1000UL)
+#ifdef GESTURE_DOUBLE_TAP_ACTION
+#  define GAP_MIN_US        40000UL
+#else
+// not recognized: two taps, the second clear of the first one's lockout
+#  define GAP_MIN_US ((SWITCH_DEBOUNCE_TIME_MS + 40) * 1000UL)
+#endif
+#define GAP_MAX_US   ((GESTURE_DOUBLE_TAP_MS - 60) * 1000UL)
+
+enum { TAP = 0, LONG_PRESS, DOUBLE_TAP, N_KINDS };
+static const char* const kind_names[N_KINDS] = { "tap", "long press", "double tap" };
+
+typedef struct
+{
+    uint64_t t_us;
+    uint8_t kind;
+} gesture_t;
+
+
+int main(int argc, char* argv[])
+{
+    unsigned n   = argc > 1 ? (unsigned)strtoul(argv[1], NULL, 0) : 1000;
+    uint32_t rng = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 0) : 1;
+    if (0 == rng) { rng = 1; }
+
+    gesture_t* g = malloc((n + 1) * sizeof(*g));
+    if (!g) { perror("malloc"); return 1; }
+
+    sim_reset();
+    uint64_t t_us = FIRST_GESTURE_US;
+    for (unsigned i=0; i<n; ++i)
+    {
+        g[i].t_us = t_us;
+        g[i].kind = (uint8_t)sim_rand_range(&rng, 0, N_KINDS - 1);
+        uint32_t bounce = sim_rand_range(&rng, 0, MAX_BOUNCE_US);
+        switch (g[i].kind)
+        {
+        case TAP:
+            sim_gen_press(t_us, sim_rand_range(&rng, TAP_MIN_US, TAP_MAX_US),
+                          bounce, &rng);
+            break;
+        case LONG_PRESS:
+            sim_gen_press(t_us, sim_rand_range(&rng, LONG_MIN_US, LONG_MAX_US),
+                          bounce, &rng);
+            break;
+        default:
+        {
+            uint32_t hold = sim_rand_range(&rng, TAP_MIN_US, 150000UL);
+            sim_gen_press(t_us, hold, bounce, &rng);
+            sim_gen_press(t_us + hold + bounce +
+                          sim_rand_range(&rng, GAP_MIN_US, GAP_MAX_US),
+                          sim_rand_range(&rng, TAP_MIN_US, 150000UL),
+                          bounce, &rng);
+            break;
+        }
+        }
+        t_us += GESTURE_PERIOD_US + sim_rand_range(&rng, 0, GESTURE_JITTER_US);
+    }
+    g[n].t_us = t_us;
+    sim_run(t_us);
+
+    sim_stats_t latency[N_KINDS] = { { 0 } };
+    sim_stats_t pulses[N_KINDS] = { { 0 } };
+    sim_stats_t awake[N_KINDS] = { { 0 } };
+    unsigned count[N_KINDS] = { 0 };
+    unsigned wrong[N_KINDS] = { 0 };
+    unsigned slow[N_KINDS] = { 0 };
+    uint8_t levels[SIM_N_SIGNALS];
+
+    for (unsigned i=0; i<n; ++i)
+    {
+        uint64_t from = g[i].t_us;
+        uint64_t to = g[i + 1].t_us;
+        uint8_t k = g[i].kind;
+
+        sim_levels_at(from, levels);
+        uint8_t before = levels[SIM_RELAY];
+        sim_levels_at(to, levels);
+        uint8_t after = levels[SIM_RELAY];
+        uint8_t expect = (TAP == k) ? !before : before;
+
+        ++count[k];
+        if (after != expect) { ++wrong[k]; }
+
+        // a non-latching relay (USE_NON_LATCHING) is reset by the end of
+        // its hold, with no pulse
+        uint64_t set = sim_find_edge(SIM_COIL1, HIGH, from, to);
+        uint64_t reset = sim_find_edge(SIM_COIL2, HIGH, from, to);
+        uint64_t release = sim_find_edge(SIM_COIL_HOLD, LOW, from, to);
+        if (release < reset) { reset = release; }
+        uint64_t rise = set < reset ? set : reset;
+        if (UINT64_MAX != rise)
+        {
+            sim_stats_add(&latency[k], (double)(rise - from) / 1000.0);
+        }
+        sim_stats_add(&pulses[k], sim_count_edges(SIM_COIL1, HIGH, from, to) +
+                                  sim_count_edges(SIM_COIL2, HIGH, from, to) +
+                                  sim_count_edges(SIM_COIL_HOLD, LOW, from, to));
+        slow[k] += sim_count_edges_while(SIM_COIL1, HIGH, SIM_CLOCK_LOW, HIGH,
+                                         from, to) +
+                   sim_count_edges_while(SIM_COIL2, HIGH, SIM_CLOCK_LOW, HIGH,
+                                         from, to) +
+                   sim_count_edges_while(SIM_COIL_HOLD, LOW, SIM_CLOCK_LOW,
+                                         HIGH, from, to);
+        sim_stats_add(&awake[k], (double)sim_time_at_level(SIM_AWAKE, HIGH,
+                                                           from, to) / 1000.0);
+    }
+
+    unsigned n_wrong = 0;
+    for (uint8_t k=0; k<N_KINDS; ++k)
+    {
+        char label[64];
+        printf("%-11s n=%-5u relay left in the wrong state: %u, coil edges "
+               "on the low clock: %u\n", kind_names[k], count[k], wrong[k],
+               slow[k]);
+        snprintf(label, sizeof(label), "  %s latency", kind_names[k]);
+        sim_stats_print(label, "ms", &latency[k]);
+        snprintf(label, sizeof(label), "  %s coil pulses", kind_names[k]);
+        sim_stats_print(label, "", &pulses[k]);
+        snprintf(label, sizeof(label), "  %s awake time", kind_names[k]);
+        sim_stats_print(label, "ms", &awake[k]);
+        sim_stats_free(&latency[k]);
+        sim_stats_free(&pulses[k]);
+        sim_stats_free(&awake[k]);
+        n_wrong += wrong[k] + slow[k];
+    }
+
+    free(g);
+    return n_wrong ? 1 : 0;
+}
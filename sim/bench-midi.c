@@ -0,0 +1,366 @@
+// Copyright (c) Matthew Garman.  All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for
+// license information.
+
+
+/*
+ * MIDI remote benchmark (USE_MIDI): drives the core's main() with byte
+ * streams on the MIDI input of the host simulation, in four parts:
+ *   - commands to the sleeping mcu: Program Change and Control Change
+ *     messages for the relay, among others that must be ignored (other
+ *     channels, controllers and programs, Note On, System Exclusive), with
+ *     running status, and MIDI clock bytes anywhere in between
+ *   - program toggles sent while a footswitch press keeps the core awake
+ *     (its coil pulse and lockout): both must move the relay
+ *   - bursts of controller data long enough to overflow the receive buffer
+ *     during a press's coil pulse, followed by a command: the bytes lost
+ *     must not turn the rest of the burst into a command
+ *   - commands that come in while a press is debounced: they are acted on
+ *     after it, and must not hold up its debounce, or delay its coil pulse
+ *     (the latency from the press to its coil edge, the first once its
+ *     debounce is over, is checked against that of the second part's)
+ * and checks the relay (its contact model) and the coil pulses against
+ * what the messages ask for; reports the latency from the start bit of a
+ * command's last byte (a byte takes SIM_MIDI_BYTE_US on the line) to its
+ * coil edge, for the sleeping mcu and for one busy with a press; exits
+ * non-zero on a wrong state, a coil pulse too many or too few, a delayed
+ * press, or a coil pulse started on the low clock (USE_CLOCK_SCALING)
+ *
+ * usage: bench-midi [n_commands [n_presses [n_bursts [n_debounced [seed]]]]]
+ */
+
+#include "simlib.h"
+
+#include "../mcu-relay-controller-iface.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#if MIDI_CHANNEL == 0
+#  error "bench-midi: needs a MIDI_CHANNEL to tell the other channels from"
+#endif
+#if (MIDI_PROGRAM_ON > 127) || (MIDI_PROGRAM_OFF > 127) || (MIDI_PROGRAM_TOGGLE > 127) || (MIDI_CC > 127)
+#  error "bench-midi: needs every command (see the Makefile)"
+#endif
+
+// the startup LED greeting is over by then
+#define FIRST_STIMULUS_US 3000000UL
+
+// commands to the sleeping mcu: far enough apart for each to be over
+#define COMMAND_PERIOD_US   50000UL
+#define COMMAND_JITTER_US   50000UL
+
+// presses, with a command some time into each (after its coil pulse has
+// started, so that the first coil edge after the command is its own)
+#define PRESS_PERIOD_US    600000UL
+#define PRESS_JITTER_US    200000UL
+#define MIN_HOLD_US         80000UL
+#define MAX_HOLD_US        400000UL
+#define MAX_BOUNCE_US        5000UL
+#define MIN_OFFSET_US       20000UL
+#define MAX_OFFSET_US      160000UL
+
+// bursts: start while the press is debounced, and last well beyond its
+// coil pulse, in which the core takes no bytes
+#define BURST_OFFSET_US      5000UL
+#define BURST_BYTES            90
+
+// commands whose last byte comes this soon into a press: while its
+// integrator reads the switch; a press's coil edge may come this much later
+// than the slowest one without a command in its debounce
+#define DEBOUNCED_MAX_US     6000UL
+#define PRESS_SLACK_US        500UL
+
+#define CHANNEL        (MIDI_CHANNEL - 1)
+#define OTHER_CHANNEL  (MIDI_CHANNEL % 16)
+#define MIDI_CLOCK     0xF8
+
+// what a message does to the relay
+#define NOTHING (-1)
+#define TOGGLE  2
+
+typedef struct
+{
+    uint8_t b[4];
+    uint8_t n;
+    int8_t effect; // NOTHING, OFF, ON or TOGGLE
+} message_t;
+
+static uint32_t rng = 1;
+
+// the status byte in force on the line (running status), 0 if none
+static uint8_t line_status;
+
+// a program number that is none of the commands'
+static uint8_t other_program(void)
+{
+    uint8_t p;
+    do { p = (uint8_t)sim_rand_range(&rng, 0, 127); }
+    while (p == MIDI_PROGRAM_ON || p == MIDI_PROGRAM_OFF || p == MIDI_PROGRAM_TOGGLE);
+    return p;
+}
+
+static message_t random_message(void)
+{
+    message_t m = { { 0 }, 0, NOTHING };
+    uint8_t value = (uint8_t)sim_rand_range(&rng, 0, 127);
+
+    switch (sim_rand_range(&rng, 0, 9))
+    {
+    case 0: m = (message_t){ { 0xC0 | CHANNEL, MIDI_PROGRAM_ON },     2, ON };     break;
+    case 1: m = (message_t){ { 0xC0 | CHANNEL, MIDI_PROGRAM_OFF },    2, OFF };    break;
+    case 2: m = (message_t){ { 0xC0 | CHANNEL, MIDI_PROGRAM_TOGGLE }, 2, TOGGLE }; break;
+    case 3:
+    case 4: m = (message_t){ { 0xB0 | CHANNEL, MIDI_CC, value }, 3, value >= 64 ? ON : OFF }; break;
+    case 5: m = (message_t){ { 0xC0 | CHANNEL, other_program() }, 2, NOTHING }; break;
+    case 6: m = (message_t){ { 0xB0 | CHANNEL, (MIDI_CC + 1) & 0x7F, value }, 3, NOTHING }; break;
+    case 7: m = (message_t){ { 0xC0 | OTHER_CHANNEL, MIDI_PROGRAM_TOGGLE }, 2, NOTHING }; break;
+    case 8: m = (message_t){ { 0x90 | CHANNEL, MIDI_CC, value }, 3, NOTHING }; break;
+    default:
+        // data bytes that would make a command, inside a System Exclusive
+        m = (message_t){ { 0xF0, MIDI_PROGRAM_TOGGLE, 0xF7 }, 3, NOTHING }; break;
+    }
+    return m;
+}
+
+// script a message from t_us, MIDI clock bytes among its own, and running
+// status where it can be used; returns the start bit time of its last byte
+static uint64_t send(uint64_t t_us, message_t m)
+{
+    uint8_t first = 0;
+    if (m.b[0] == line_status && sim_rand_range(&rng, 0, 1)) { first = 1; }
+    if (m.b[0] < 0xF0)   { line_status = m.b[0]; }
+    else                 { line_status = 0; }
+
+    uint64_t last_us = t_us;
+    for (uint8_t i=first; i<m.n; ++i)
+    {
+        if (0 == sim_rand_range(&rng, 0, 3))
+        {
+            sim_midi_add_byte(t_us, MIDI_CLOCK);
+            t_us += SIM_MIDI_BYTE_US;
+        }
+        sim_midi_add_byte(t_us, m.b[i]);
+        last_us = t_us;
+        t_us += SIM_MIDI_BYTE_US + sim_rand_range(&rng, 0, 1) * SIM_MIDI_BYTE_US;
+    }
+    return last_us;
+}
+
+static uint8_t apply(uint8_t state, int8_t effect)
+{
+    if (NOTHING == effect) { return state; }
+    if (TOGGLE == effect)  { return !state; }
+    return (uint8_t)effect;
+}
+
+static unsigned coil_pulses(uint64_t from, uint64_t to)
+{
+    return sim_count_edges(SIM_COIL1, HIGH, from, to) +
+           sim_count_edges(SIM_COIL2, HIGH, from, to);
+}
+
+static uint64_t first_coil_edge(uint64_t from, uint64_t to)
+{
+    uint64_t set = sim_find_edge(SIM_COIL1, HIGH, from, to);
+    uint64_t reset = sim_find_edge(SIM_COIL2, HIGH, from, to);
+    return set < reset ? set : reset;
+}
+
+static uint8_t relay_at(uint64_t t_us)
+{
+    uint8_t level[SIM_N_SIGNALS];
+    sim_levels_at(t_us, level);
+    return level[SIM_RELAY];
+}
+
+typedef struct
+{
+    uint64_t t_us;   // start of the stimulus
+    uint64_t cmd_us; // start bit of the command's last byte
+    int8_t effect;   // of the command
+    uint8_t kind;    // one of the KIND_*
+} stimulus_t;
+
+#define KIND_COMMAND 0
+#define KIND_PRESS   1
+#define KIND_BURST   2
+#define KIND_DEBOUNCED 3
+
+
+int main(int argc, char* argv[])
+{
+    unsigned n_commands = argc > 1 ? (unsigned)strtoul(argv[1], NULL, 0) : 2000;
+    unsigned n_presses  = argc > 2 ? (unsigned)strtoul(argv[2], NULL, 0) : 500;
+    unsigned n_bursts   = argc > 3 ? (unsigned)strtoul(argv[3], NULL, 0) : 200;
+    unsigned n_debounced = argc > 4 ? (unsigned)strtoul(argv[4], NULL, 0) : 500;
+    rng                 = argc > 5 ? (uint32_t)strtoul(argv[5], NULL, 0) : 1;
+    if (0 == rng) { rng = 1; }
+
+    unsigned n = n_commands + n_presses + n_bursts + n_debounced;
+    stimulus_t* stim = malloc((n + 1) * sizeof(*stim));
+    if (!stim) { perror("malloc"); return 1; }
+
+    sim_reset();
+    uint64_t t_us = FIRST_STIMULUS_US;
+    for (unsigned i=0; i<n; ++i)
+    {
+        stimulus_t* s = &stim[i];
+        s->t_us = t_us;
+        s->kind = i < n_commands ? KIND_COMMAND :
+                  i < n_commands + n_presses ? KIND_PRESS :
+                  i < n_commands + n_presses + n_bursts ? KIND_BURST : KIND_DEBOUNCED;
+
+        if (KIND_COMMAND == s->kind)
+        {
+            message_t m = random_message();
+            s->cmd_us = send(t_us, m);
+            s->effect = m.effect;
+            t_us += COMMAND_PERIOD_US + sim_rand_range(&rng, 0, COMMAND_JITTER_US);
+            continue;
+        }
+
+        sim_gen_press(t_us, sim_rand_range(&rng, MIN_HOLD_US, MAX_HOLD_US),
+                      sim_rand_range(&rng, 0, MAX_BOUNCE_US), &rng);
+        if (KIND_PRESS == s->kind)
+        {
+            message_t m = { { 0xC0 | CHANNEL, MIDI_PROGRAM_TOGGLE }, 2, TOGGLE };
+            s->cmd_us = send(t_us + sim_rand_range(&rng, MIN_OFFSET_US, MAX_OFFSET_US), m);
+            s->effect = TOGGLE;
+        }
+        else if (KIND_DEBOUNCED == s->kind)
+        {
+            // any command of the relay's: its last byte within the debounce
+            message_t m;
+            do { m = random_message(); } while (NOTHING == m.effect);
+            uint64_t end_us = t_us + sim_rand_range(&rng, 0, DEBOUNCED_MAX_US);
+            uint64_t start_us = end_us - (m.n + 2) * 2 * SIM_MIDI_BYTE_US;
+            line_status = 0;
+            s->cmd_us = send(start_us > t_us ? start_us : t_us, m);
+            s->effect = m.effect;
+        }
+        else
+        {
+            // volume changes, with running status, then the command
+            uint64_t b_us = t_us + BURST_OFFSET_US;
+            sim_midi_add_byte(b_us, 0xB0 | CHANNEL);
+            for (unsigned k=1; k<BURST_BYTES; ++k)
+            {
+                b_us += SIM_MIDI_BYTE_US;
+                sim_midi_add_byte(b_us, (k & 1) ? 7 : (uint8_t)sim_rand_range(&rng, 0, 127));
+            }
+            line_status = 0; // in full: bytes lost end the running status
+            uint8_t value = (uint8_t)sim_rand_range(&rng, 0, 127);
+            message_t m = { { 0xB0 | CHANNEL, MIDI_CC, value }, 3, value >= 64 ? ON : OFF };
+            s->cmd_us = send(b_us + SIM_MIDI_BYTE_US, m);
+            s->effect = m.effect;
+        }
+        t_us += PRESS_PERIOD_US + sim_rand_range(&rng, 0, PRESS_JITTER_US);
+    }
+    stim[n].t_us = t_us;
+    sim_run(t_us);
+
+    sim_stats_t asleep = { 0 };
+    sim_stats_t busy = { 0 };
+    sim_stats_t press_plain = { 0 };
+    sim_stats_t press_debounced = { 0 };
+    unsigned acting = 0;
+    unsigned wrong_state = 0;
+    unsigned wrong_pulses = 0;
+    unsigned burst_wrong = 0;
+    uint8_t state = relay_at(FIRST_STIMULUS_US);
+
+    for (unsigned i=0; i<n; ++i)
+    {
+        stimulus_t* s = &stim[i];
+        uint64_t from = s->t_us;
+        uint64_t to = stim[i + 1].t_us;
+        unsigned expected = 0;
+
+        if (KIND_COMMAND != s->kind)
+        {
+            state = !state; // the press
+            ++expected;
+        }
+        uint8_t pressed = state;
+        state = apply(state, s->effect);
+        if (state != pressed) { ++expected; ++acting; }
+
+        unsigned pulses = coil_pulses(from, to);
+        uint8_t wrong = (pulses != expected) || (relay_at(to - 1) != state);
+        if (pulses != expected)       { ++wrong_pulses; }
+        if (relay_at(to - 1) != state) { ++wrong_state; }
+        if (KIND_BURST == s->kind && wrong) { ++burst_wrong; }
+        state = relay_at(to - 1); // carry on from what it is
+
+        // the press's own coil edge: the first once its debounce is over
+        if (KIND_PRESS == s->kind || KIND_DEBOUNCED == s->kind)
+        {
+            uint64_t accept = sim_find_edge(SIM_POWER_STATE + POWER_STATE_DEBOUNCE,
+                                            LOW, from, to);
+            uint64_t edge = first_coil_edge(accept, to);
+            if (UINT64_MAX != edge)
+            {
+                sim_stats_add(KIND_PRESS == s->kind ? &press_plain : &press_debounced,
+                              (double)(edge - from) / 1000.0);
+            }
+        }
+
+        if (state == pressed || KIND_BURST == s->kind || KIND_DEBOUNCED == s->kind)
+        {
+            continue;
+        }
+        uint64_t edge = first_coil_edge(s->cmd_us, to);
+        if (UINT64_MAX == edge) { continue; }
+        double ms = (double)(edge - s->cmd_us) / 1000.0;
+        if (KIND_COMMAND == s->kind) { sim_stats_add(&asleep, ms); }
+        else                         { sim_stats_add(&busy, ms); }
+    }
+
+    printf("commands: %u  presses with a command: %u  bursts: %u (%u bytes each)  "
+           "presses with a command in their debounce: %u\n",
+           n_commands, n_presses, n_bursts, BURST_BYTES + 3, n_debounced);
+    printf("commands that moved the relay: %u  wrong state: %u  "
+           "coil pulses too many/few: %u (after a burst: %u)\n",
+           acting, wrong_state, wrong_pulses, burst_wrong);
+    printf("simulated: %.1f s  awake: %.3f s (active %.3f s)  asleep: %.3f s\n",
+           (double)sim_now_us / 1e6, (double)sim_awake_us / 1e6,
+           (double)sim_active_us / 1e6, (double)sim_sleep_us / 1e6);
+    sim_stats_print("last-byte-to-coil-edge latency, mcu asleep", "ms", &asleep);
+    sim_stats_print("last-byte-to-coil-edge latency, during a press", "ms", &busy);
+    sim_stats_print("press-to-coil-edge latency", "ms", &press_plain);
+    sim_stats_print("press-to-coil-edge latency, command in the debounce", "ms",
+                    &press_debounced);
+
+    // the presses with a command in their debounce are no slower
+    double plain_max = 0;
+    double debounced_max = 0;
+    for (size_t i=0; i<press_plain.n; ++i)
+    {
+        if (press_plain.v[i] > plain_max) { plain_max = press_plain.v[i]; }
+    }
+    for (size_t i=0; i<press_debounced.n; ++i)
+    {
+        if (press_debounced.v[i] > debounced_max) { debounced_max = press_debounced.v[i]; }
+    }
+    uint8_t delayed = n_presses && n_debounced &&
+                      (debounced_max > plain_max + PRESS_SLACK_US / 1000.0);
+    printf("presses delayed by a command in their debounce: %s (slowest %.3f ms, "
+           "without a command %.3f ms)\n", delayed ? "yes" : "no",
+           debounced_max, plain_max);
+
+    // a command taken during the lockout, on the low clock
+    // (USE_CLOCK_SCALING), is acted on at the normal one
+    unsigned slow = sim_count_edges_while(SIM_COIL1, HIGH, SIM_CLOCK_LOW, HIGH,
+                                          0, UINT64_MAX) +
+                    sim_count_edges_while(SIM_COIL2, HIGH, SIM_CLOCK_LOW, HIGH,
+                                          0, UINT64_MAX);
+    printf("coil pulses started on the low clock: %u\n", slow);
+
+    sim_stats_free(&asleep);
+    sim_stats_free(&busy);
+    sim_stats_free(&press_plain);
+    sim_stats_free(&press_debounced);
+    free(stim);
+    return (wrong_state || wrong_pulses || delayed || slow) ? 1 : 0;
+}
@@ -0,0 +1,123 @@
+// Copyright (c) Matthew Garman.  All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for
+// license information.
+
+
+/*
+ * mute window check: drives the core's main() (built with USE_MUTE) with a
+ * series of bouncing switch presses on the host simulation, and checks for
+ * every relay transition that the mute output was asserted before the
+ * contacts broke and released only after they had come to rest (see the
+ * relay contact model in hostsim.h); reports, per transition:
+ *   - lead: time from mute to contact break
+ *   - trail: time from the end of contact bounce to unmute
+ *   - the length of the muted window
+ * plus the transitions that were not covered, and the coil pulses that did
+ * not move the relay
+ *
+ * usage: bench-mute [n_presses [seed]]
+ */
+
+#include "simlib.h"
+
+#include "../mcu-relay-controller-iface.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define FIRST_PRESS_US    3000000UL
+#define PRESS_PERIOD_US    600000UL
+#define PRESS_JITTER_US    200000UL
+
+#define MIN_HOLD_US         80000UL
+#define MAX_HOLD_US        400000UL
+#define MAX_BOUNCE_US        5000UL
+
+
+int main(int argc, char* argv[])
+{
+    unsigned n_presses = argc > 1 ? (unsigned)strtoul(argv[1], NULL, 0) : 1000;
+    uint32_t rng       = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 0) : 1;
+    if (0 == rng) { rng = 1; }
+
+    uint64_t* press_us = malloc((n_presses + 1) * sizeof(*press_us));
+    if (!press_us) { perror("malloc"); return 1; }
+
+    sim_reset();
+    uint64_t t_us = FIRST_PRESS_US;
+    for (unsigned i=0; i<n_presses; ++i)
+    {
+        press_us[i] = t_us;
+        sim_gen_press(t_us,
+                      sim_rand_range(&rng, MIN_HOLD_US, MAX_HOLD_US),
+                      sim_rand_range(&rng, 0, MAX_BOUNCE_US),
+                      &rng);
+        t_us += PRESS_PERIOD_US + sim_rand_range(&rng, 0, PRESS_JITTER_US);
+    }
+    press_us[n_presses] = t_us;
+    sim_run(t_us);
+
+    sim_stats_t lead = { 0 };
+    sim_stats_t trail = { 0 };
+    sim_stats_t window = { 0 };
+    unsigned transitions = 0;
+    unsigned uncovered = 0;
+    unsigned not_moved = 0;
+
+    for (unsigned i=0; i<n_presses; ++i)
+    {
+        uint64_t from = press_us[i];
+        uint64_t to = press_us[i + 1];
+        unsigned pulses = sim_count_edges(SIM_COIL1, HIGH, from, to) +
+                          sim_count_edges(SIM_COIL2, HIGH, from, to);
+        unsigned moves = sim_count_edges(SIM_CONTACTS_MOVING, HIGH, from, to);
+        if (pulses > moves) { not_moved += pulses - moves; }
+
+        // every contact movement, and the mute window around it
+        uint64_t t = from;
+        for (;;)
+        {
+            uint64_t brk = sim_find_edge(SIM_CONTACTS_MOVING, HIGH, t, to);
+            if (UINT64_MAX == brk) { break; }
+            uint64_t rest = sim_find_edge(SIM_CONTACTS_MOVING, LOW, brk, to);
+            uint64_t mute = UINT64_MAX;
+            for (uint64_t m=from; ; )
+            {
+                uint64_t e = sim_find_edge(SIM_MUTE, HIGH, m, brk + 1);
+                if (UINT64_MAX == e) { break; }
+                mute = e;
+                m = e + 1;
+            }
+            uint64_t unmute = (UINT64_MAX == mute) ? UINT64_MAX
+                            : sim_find_edge(SIM_MUTE, LOW, mute, to);
+
+            ++transitions;
+            if (UINT64_MAX == mute || UINT64_MAX == rest ||
+                UINT64_MAX == unmute || unmute < rest)
+            {
+                ++uncovered;
+            }
+            else
+            {
+                sim_stats_add(&lead, (double)(brk - mute));
+                sim_stats_add(&trail, (double)(unmute - rest));
+                sim_stats_add(&window, (double)(unmute - mute));
+            }
+            if (UINT64_MAX == rest) { break; }
+            t = rest;
+        }
+    }
+
+    printf("presses: %u  relay transitions: %u  not covered by mute: %u  "
+           "coil pulses that did not move the relay: %u\n",
+           n_presses, transitions, uncovered, not_moved);
+    sim_stats_print("lead (mute to break)", "us", &lead);
+    sim_stats_print("trail (rest to unmute)", "us", &trail);
+    sim_stats_print("muted window", "us", &window);
+
+    sim_stats_free(&lead);
+    sim_stats_free(&trail);
+    sim_stats_free(&window);
+    free(press_us);
+    return uncovered ? 1 : 0;
+}
@@ -0,0 +1,256 @@
+// Copyright (c) Matthew Garman.  All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for
+// license information.
+
+
+/*
+ * power-fail check (USE_POWER_FAIL): runs the core's main() on the host
+ * simulation once through a script of presses and glitches, then again for
+ * every point of that run (each logged transition: switch edges, coil and
+ * LED pins, sleep and idle, power state marks, ..., the instant of it, 1us
+ * after, and half-way to the next one), with the power-good pin falling
+ * there; each time checks that
+ *   - the run ends in MRC_power_fail_halt(), i.e. power_fail() was entered
+ *   - the reset coil is driven, and the set coil released, from the latency
+ *     after the power-fail, for at least RELAY_RESET_PULSE_MS, and neither
+ *     moves again
+ *   - the relay contacts are at rest in OFF (bypass), and the LED is off
+ * with USE_TRACE, the first press is held down until the trace is sent
+ * (after the lockout, and any EEPROM write, have been waited out);
+ * and reports the latency from the power-good edge to the reset coil
+ * drive, split by whether the mcu was asleep (power-down) or awake, for each
+ * target's interrupt timing (see targets[] below); the pic10f320 has no
+ * power-fail input (see hardware-details/pic10f320.c)
+ * exits non-zero on a failed check, or a latency beyond the target's bound:
+ * the wake-up, one other interrupt service routine and the entry into
+ * power_fail() (all at the low clock, with USE_CLOCK_SCALING)
+ *
+ * usage: bench-powerfail [n_stimuli [seed]]
+ */
+
+#include "simlib.h"
+
+#include "../mcu-relay-controller-iface.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifndef USE_POWER_FAIL
+#  error "bench-powerfail: build with USE_POWER_FAIL"
+#endif
+
+#define FIRST_STIMULUS_US  3000000UL
+#define STIMULUS_PERIOD_US  600000UL
+#define MIN_HOLD_US          80000UL
+#define MAX_HOLD_US         400000UL
+#define MAX_BOUNCE_US         5000UL
+#define TAIL_US             500000UL
+
+// USE_TRACE: the first press is held down this long (see
+// TRACE_DUMP_HOLD_MS), the stimuli after it start this much later
+#ifdef USE_TRACE
+#  define TRACE_HOLD_US  ((uint64_t)TRACE_DUMP_HOLD_MS * 1000 + 200000UL)
+#  define TRACE_EXTRA_US (TRACE_HOLD_US + 500000UL)
+#else
+#  define TRACE_EXTRA_US 0
+#endif // USE_TRACE
+
+// past the power-fail: the reset pulse, and plenty of margin
+#define AFTER_FAIL_US      1000000UL
+
+// interrupt timing of each target (see SIM_* in hardware-details/hostsim.c)
+typedef struct
+{
+    const char* name;
+    uint32_t wake_latency_us;   // power-down to the interrupt response
+    uint32_t isr_us;            // the timer interrupt (USE_TIMER_TICK)
+    uint32_t power_fail_isr_us; // interrupt entry to the port write
+    uint32_t clock_low_div;     // CLOCK_PROFILE_LOW (USE_CLOCK_SCALING)
+} pf_target_t;
+
+static const pf_target_t targets[] =
+{
+    // 1MHz: 6CK wake-up from power-down, 4+4 cycles of interrupt response;
+    // PCINT0 saves the call-clobbered registers (~35 cycles), tests PB4 and
+    // calls power_fail(); Timer0 as in hostsim.c
+    { "attiny13/85", 10, 80, 50, 8 },
+    // 4MHz, 1us per instruction: INTOSC needs no oscillator start-up, 2
+    // cycles after SLEEP and 3-4 of interrupt latency; xc8's context save
+    // (~10), GPIF/GP3 tests, the call and the shadow-register port write
+    // (~20); TMR0 reload, timer_tick() and the restore: ~60; no clock
+    // scaling
+    { "pic12f675",    6, 60, 30, 1 },
+};
+
+static void script(unsigned n_stimuli, uint32_t rng)
+{
+    uint64_t t_us = FIRST_STIMULUS_US;
+#ifdef USE_TRACE
+    sim_gen_press(t_us, (uint32_t)TRACE_HOLD_US, sim_rand_range(&rng, 0, MAX_BOUNCE_US),
+                  &rng);
+    t_us += TRACE_EXTRA_US;
+#endif // USE_TRACE
+    for (unsigned i=0; i<n_stimuli; ++i)
+    {
+        if (sim_rand(&rng) & 1)
+        {
+            sim_gen_press(t_us, sim_rand_range(&rng, MIN_HOLD_US, MAX_HOLD_US),
+                          sim_rand_range(&rng, 0, MAX_BOUNCE_US), &rng);
+        }
+        else
+        {
+            sim_gen_glitch(t_us, &rng);
+        }
+        t_us += STIMULUS_PERIOD_US;
+    }
+}
+
+// a fresh power-up: the same script, and (USE_PERSIST) the same EEPROM, so
+// that the run is the baseline's up to the power-fail
+static uint64_t run(const pf_target_t* t, unsigned n_stimuli, uint32_t seed,
+                    uint64_t fail_us, uint64_t until_us)
+{
+    sim_reset();
+    sim_eeprom_erase();
+    sim_wake_latency_us = t->wake_latency_us;
+    sim_isr_us = t->isr_us;
+    sim_power_fail_isr_us = t->power_fail_isr_us;
+    sim_clock_low_div = t->clock_low_div;
+    script(n_stimuli, seed);
+    if (UINT64_MAX != fail_us) { sim_power_fail_at(fail_us); }
+    return sim_run(until_us);
+}
+
+// the checks above for a run with the power-fail at fail_us that stopped at
+// end_us; sets *latency_us, and *asleep if the mcu was in power-down
+static int check(uint64_t fail_us, uint64_t end_us, uint64_t until_us,
+                 uint64_t* latency_us, uint8_t* asleep)
+{
+    size_t n;
+    const sim_event_t* log = sim_log(&n);
+    uint8_t level[SIM_N_SIGNALS];
+    sim_levels_at(fail_us, level);
+    *asleep = !level[SIM_AWAKE];
+
+    if (end_us >= until_us) { return 0; } // never halted
+    if (fail_us != sim_find_edge(SIM_POWER_GOOD, LOW, fail_us, end_us + 1))
+    {
+        return 0;
+    }
+
+    // the last time the reset drive (coil 2 on, coil 1 off) was
+    // established, and its end, which must be the last coil edge; the core
+    // may still end a pulse of its own at the instant of the power-fail,
+    // before the interrupt is taken
+    uint64_t drive_us = UINT64_MAX;
+    uint64_t release_us = UINT64_MAX;
+    if (level[SIM_COIL2] && !level[SIM_COIL1]) { drive_us = fail_us; }
+    for (size_t i=sim_log_lower_bound(fail_us); i<n; ++i)
+    {
+        uint8_t s = log[i].signal;
+        if (SIM_COIL1 != s && SIM_COIL2 != s) { continue; }
+        level[s] = log[i].level;
+        if (level[SIM_COIL2] && !level[SIM_COIL1])
+        {
+            drive_us = log[i].t_us;
+            release_us = UINT64_MAX;
+        }
+        else if (UINT64_MAX != drive_us && UINT64_MAX == release_us &&
+                 SIM_COIL2 == s)
+        {
+            release_us = log[i].t_us;
+        }
+        else
+        {
+            drive_us = UINT64_MAX;
+            release_us = UINT64_MAX;
+        }
+    }
+    if (UINT64_MAX == drive_us || UINT64_MAX == release_us) { return 0; }
+    if (release_us - drive_us < (uint64_t)RELAY_RESET_PULSE_MS * 1000) { return 0; }
+    *latency_us = drive_us - fail_us;
+
+    sim_levels_at(end_us + 1, level);
+    return (OFF == level[SIM_RELAY]) && !level[SIM_CONTACTS_MOVING] &&
+           !level[SIM_LED] && !level[SIM_COIL1] && !level[SIM_COIL2];
+}
+
+
+int main(int argc, char* argv[])
+{
+    unsigned n_stimuli = argc > 1 ? (unsigned)strtoul(argv[1], NULL, 0) : 6;
+    uint32_t seed      = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 0) : 1;
+    if (0 == seed) { seed = 1; }
+    const uint64_t baseline_until_us =
+        FIRST_STIMULUS_US + TRACE_EXTRA_US + (uint64_t)n_stimuli * STIMULUS_PERIOD_US +
+        TAIL_US;
+
+    int status = 0;
+    for (size_t ti=0; ti<sizeof(targets)/sizeof(targets[0]); ++ti)
+    {
+        const pf_target_t* t = &targets[ti];
+
+        // the points of the baseline run
+        run(t, n_stimuli, seed, UINT64_MAX, baseline_until_us);
+        size_t n;
+        const sim_event_t* log = sim_log(&n);
+        size_t n_points = 0;
+        uint64_t* points = malloc((3 * n + 1) * sizeof(*points));
+        if (!points) { perror("malloc"); return 1; }
+        points[n_points++] = 0;
+        for (size_t i=0; i<n; ++i)
+        {
+            uint64_t next_us = (i + 1 < n) ? log[i + 1].t_us : baseline_until_us;
+            points[n_points++] = log[i].t_us;
+            points[n_points++] = log[i].t_us + 1;
+            if (next_us > log[i].t_us + 2)
+            {
+                points[n_points++] = log[i].t_us + (next_us - log[i].t_us) / 2;
+            }
+        }
+
+        sim_stats_t asleep_stats = { 0 };
+        sim_stats_t awake_stats = { 0 };
+        unsigned failed = 0;
+        double worst_us = 0;
+        for (size_t i=0; i<n_points; ++i)
+        {
+            uint64_t until_us = points[i] + AFTER_FAIL_US;
+            uint64_t end_us = run(t, n_stimuli, seed, points[i], until_us);
+            uint64_t latency_us = 0;
+            uint8_t asleep;
+            if (!check(points[i], end_us, until_us, &latency_us, &asleep))
+            {
+                if (0 == failed++)
+                {
+                    printf("%s: power-fail at %.6f s not handled\n", t->name,
+                           (double)points[i] / 1e6);
+                }
+                continue;
+            }
+            sim_stats_add(asleep ? &asleep_stats : &awake_stats, (double)latency_us);
+            if (latency_us > worst_us) { worst_us = (double)latency_us; }
+        }
+
+#ifdef USE_CLOCK_SCALING
+        uint32_t div = t->clock_low_div;
+#else
+        uint32_t div = 1;
+#endif // USE_CLOCK_SCALING
+        double bound_us = (double)(t->wake_latency_us + t->isr_us +
+                                   t->power_fail_isr_us) * div;
+
+        printf("%s: %zu power-fail points, failed: %u, worst latency %.0f us "
+               "(bound %.0f us)\n", t->name, n_points, failed, worst_us, bound_us);
+        sim_stats_print("  latency, asleep", "us", &asleep_stats);
+        sim_stats_print("  latency, awake", "us", &awake_stats);
+        if (failed || worst_us > bound_us) { status = 1; }
+
+        sim_stats_free(&asleep_stats);
+        sim_stats_free(&awake_stats);
+        free(points);
+    }
+    printf("pic10f320: no power-fail input\n");
+
+    return status;
+}
@@ -0,0 +1,174 @@
+// Copyright (c) Matthew Garman.  All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for
+// license information.
+
+
+/*
+ * press-to-relay benchmark: drives the core's main() with a series of
+ * bouncing switch presses, interleaved with glitches (short low-going
+ * spikes, as picked up by a long footswitch wire), on the host simulation
+ * and reports, per press:
+ *   - latency from the first switch edge to the first relay coil edge
+ *   - width of the coil pulse
+ *   - skew from the first coil edge to the status LED edge (0 where both
+ *     change in one port write, see MRC_port_apply())
+ *   - total time the mcu spent awake, and the part of it in which the cpu
+ *     was running (i.e. not in idle mode)
+ * plus the presses that did not reach the relay, and the glitches that did
+ * (moving the relay at all, and leaving it in the wrong state); built with
+ * USE_WAKE_STATS, also the core's own count of wake-ups, of those turned
+ * away by the quick check and of presses accepted
+ *
+ * usage: bench-press [n_presses [n_glitches [seed]]]
+ */
+
+#include "simlib.h"
+
+#include "../mcu-relay-controller-iface.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// stimuli start once the startup LED greeting is over, and are spaced far
+// enough apart that every one of them is handled on its own
+#define FIRST_STIMULUS_US 3000000UL
+#define STIMULUS_PERIOD_US 600000UL
+#define STIMULUS_JITTER_US 200000UL
+
+#define MIN_HOLD_US         80000UL
+#define MAX_HOLD_US        400000UL
+#define MAX_BOUNCE_US        5000UL
+
+#ifdef USE_WAKE_STATS
+extern uint16_t stats_wakes;
+extern uint16_t stats_rejected;
+extern uint16_t stats_presses;
+#endif
+
+typedef struct
+{
+    uint64_t t_us;
+    uint8_t is_press;
+} stimulus_t;
+
+
+int main(int argc, char* argv[])
+{
+    unsigned n_presses  = argc > 1 ? (unsigned)strtoul(argv[1], NULL, 0) : 1000;
+    unsigned n_glitches = argc > 2 ? (unsigned)strtoul(argv[2], NULL, 0) : 1000;
+    uint32_t rng        = argc > 3 ? (uint32_t)strtoul(argv[3], NULL, 0) : 1;
+    if (0 == rng) { rng = 1; }
+
+    unsigned n = n_presses + n_glitches;
+    stimulus_t* stim = malloc((n + 1) * sizeof(*stim));
+    if (!stim) { perror("malloc"); return 1; }
+
+    // random interleaving of presses and glitches
+    sim_reset();
+    uint64_t t_us = FIRST_STIMULUS_US;
+    unsigned presses_left = n_presses;
+    for (unsigned i=0; i<n; ++i)
+    {
+        stim[i].t_us = t_us;
+        stim[i].is_press = sim_rand_range(&rng, 1, n - i) <= presses_left;
+        if (stim[i].is_press)
+        {
+            --presses_left;
+            sim_gen_press(t_us,
+                          sim_rand_range(&rng, MIN_HOLD_US, MAX_HOLD_US),
+                          sim_rand_range(&rng, 0, MAX_BOUNCE_US),
+                          &rng);
+        }
+        else
+        {
+            sim_gen_glitch(t_us, &rng);
+        }
+        t_us += STIMULUS_PERIOD_US + sim_rand_range(&rng, 0, STIMULUS_JITTER_US);
+    }
+    stim[n].t_us = t_us;
+    sim_run(t_us);
+
+    sim_stats_t latency = { 0 };
+    sim_stats_t pulse = { 0 };
+    sim_stats_t skew = { 0 };
+    sim_stats_t awake = { 0 };
+    sim_stats_t active = { 0 };
+    unsigned missed = 0;
+    unsigned extra_pulses = 0;
+    unsigned false_triggers = 0;
+    unsigned wrong_state = 0;
+
+    for (unsigned i=0; i<n; ++i)
+    {
+        uint64_t from = stim[i].t_us;
+        uint64_t to = stim[i + 1].t_us;
+        unsigned pulses = sim_count_edges(SIM_COIL1, HIGH, from, to) +
+                          sim_count_edges(SIM_COIL2, HIGH, from, to);
+
+        if (!stim[i].is_press)
+        {
+            if (pulses)     { ++false_triggers; }
+            if (pulses & 1) { ++wrong_state;    }
+            continue;
+        }
+
+        uint64_t set = sim_find_edge(SIM_COIL1, HIGH, from, to);
+        uint64_t reset = sim_find_edge(SIM_COIL2, HIGH, from, to);
+        uint8_t coil = set < reset ? SIM_COIL1 : SIM_COIL2;
+        uint64_t rise = set < reset ? set : reset;
+
+        sim_stats_add(&awake, (double)sim_time_at_level(SIM_AWAKE, HIGH,
+                                                        from, to) / 1000.0);
+        sim_stats_add(&active, (double)sim_time_at_level(SIM_CPU, HIGH,
+                                                         from, to) / 1000.0);
+        if (UINT64_MAX == rise) { ++missed; continue; }
+        if (pulses > 1) { extra_pulses += pulses - 1; }
+
+        uint64_t fall = sim_find_edge(coil, LOW, rise, to);
+        uint64_t led = sim_find_edge(SIM_LED, SIM_COIL1 == coil ? HIGH : LOW,
+                                     rise, to);
+        if (UINT64_MAX != led)
+        {
+            sim_stats_add(&skew, (double)(led - rise) / 1000.0);
+        }
+        sim_stats_add(&latency, (double)(rise - from) / 1000.0);
+        if (UINT64_MAX != fall)
+        {
+            sim_stats_add(&pulse, (double)(fall - rise) / 1000.0);
+        }
+    }
+
+    printf("presses: %u  missed: %u  extra coil pulses: %u  glitches: %u  "
+           "false triggers: %u (left in wrong state: %u)\n",
+           n_presses, missed, extra_pulses, n_glitches, false_triggers,
+           wrong_state);
+    printf("simulated: %.1f s  awake: %.3f s (active %.3f s)  asleep: %.3f s\n",
+           (double)sim_now_us / 1e6, (double)sim_awake_us / 1e6,
+           (double)sim_active_us / 1e6, (double)sim_sleep_us / 1e6);
+    // an out-of-line pin operation costs an rcall and a ret on the ATtiny
+    // (an estimate: hostsim does not count cycles)
+    printf("HAL calls per stimulus: %.1f, of them pin operations: %.1f "
+           "(est. %.0f ATtiny cycles of call/return, inlined by "
+           "MRC_INLINE_HAL or LTO=1)\n",
+           (double)sim_hal_calls / n, (double)sim_pin_calls / n,
+           7.0 * sim_pin_calls / n);
+#ifdef USE_WAKE_STATS
+    printf("wake-ups: %u  rejected by the quick check: %u (%.1f%%)  "
+           "presses accepted: %u\n", stats_wakes, stats_rejected,
+           stats_wakes ? 100.0 * stats_rejected / stats_wakes : 0.0,
+           stats_presses);
+#endif
+    sim_stats_print("press-to-coil-edge latency", "ms", &latency);
+    sim_stats_print("coil pulse width", "ms", &pulse);
+    sim_stats_print("coil-to-LED skew", "ms", &skew);
+    sim_stats_print("awake time per press", "ms", &awake);
+    sim_stats_print("active time per press", "ms", &active);
+
+    sim_stats_free(&latency);
+    sim_stats_free(&pulse);
+    sim_stats_free(&skew);
+    sim_stats_free(&awake);
+    sim_stats_free(&active);
+    free(stim);
+    return 0;
+}
@@ -0,0 +1,293 @@
+// Copyright (c) Matthew Garman.  All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for
+// license information.
+
+
+/*
+ * event trace check: drives the core's main() (built with USE_TRACE) on the
+ * host simulation with rounds of bouncing presses and glitches, each ended
+ * by a press held down long enough to dump the trace; decodes the dumps from
+ * the LED pin (as sim/trace-decode does a capture), and checks every record
+ * against the event log:
+ *   - wake-up #k is the k-th pass of the main loop (the first one is the
+ *     start-up, the others the wake-ups from power-down, and the presses
+ *     found pending before sleep)
+ *   - a relay set/reset is the first coil pulse of its wake-up, on the
+ *     right coil, with the recorded width (or up to two timer ticks more,
+ *     with USE_SCHEDULER)
+ *   - a press accepted has a coil pulse in its wake-up, a press rejected has
+ *     none
+ *   - the times (steps of TRACE_TIME_MS since the wake-up) agree with the
+ *     coil edge and the end of the lockout, to within a step
+ * records from before the first wake-up in a dump cannot be placed, and are
+ * only counted.  prints the last dump as trace-decode would
+ * exits non-zero on a missing or damaged dump, or a record that does not
+ * agree
+ *
+ * usage: bench-trace [-o capture.csv] [n_rounds [stimuli_per_round [seed]]]
+ *   -o writes the LED pin as CSV (time in seconds, level), for trace-decode
+ */
+
+#include "simlib.h"
+#include "tracedec.h"
+
+#include "../mcu-relay-controller-iface.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#ifndef USE_TRACE
+#  error "bench-trace: build with USE_TRACE"
+#endif
+#if defined(USE_LOWPOWER_SLEEP) || (DEBOUNCE_STRATEGY != DEBOUNCE_INTEGRATOR)
+// low-power sleeps show as wake-ups in the event log, and the leading-edge
+// strategies act before they record their verdict
+#  error "bench-trace: the integrator, without USE_LOWPOWER_SLEEP"
+#endif
+
+#define FIRST_STIMULUS_US 3000000UL
+#define STIMULUS_PERIOD_US 600000UL
+#define STIMULUS_JITTER_US 200000UL
+#define MIN_HOLD_US         80000UL
+#define MAX_HOLD_US        400000UL
+#define MAX_BOUNCE_US        5000UL
+
+// the press that dumps the trace, and the quiet time after it (the dump
+// itself takes ~0.2s)
+#define DUMP_HOLD_US  ((TRACE_DUMP_HOLD_MS + 500UL) * 1000UL)
+#define DUMP_QUIET_US 1000000UL
+
+#define MAX_DUMPS 1024
+
+// time of each pass of the main loop: the run starts awake (the first
+// SIM_AWAKE edge, at 0), then every wake-up from power-down, and every
+// press found pending, which starts a pass without sleeping (recorded
+// during the run, in time order)
+static uint64_t* wakes;
+static size_t n_wakes;
+static uint64_t* pending;
+static size_t n_pending;
+static size_t cap_pending;
+
+static void record_pending(void)
+{
+    if (n_pending == cap_pending)
+    {
+        cap_pending = cap_pending ? 2 * cap_pending : 256;
+        pending = realloc(pending, cap_pending * sizeof(*pending));
+        if (!pending) { perror("realloc"); exit(1); }
+    }
+    pending[n_pending++] = sim_now_us;
+}
+
+static void find_wakes(const sim_event_t* log, size_t n)
+{
+    wakes = malloc((n + n_pending + 1) * sizeof(*wakes));
+    if (!wakes) { perror("malloc"); exit(1); }
+    n_wakes = 0;
+    size_t p = 0;
+    for (size_t i=0; i<n; ++i)
+    {
+        if (SIM_AWAKE == log[i].signal && HIGH == log[i].level)
+        {
+            while (p < n_pending && pending[p] < log[i].t_us)
+            {
+                wakes[n_wakes++] = pending[p++];
+            }
+            wakes[n_wakes++] = log[i].t_us;
+        }
+    }
+    while (p < n_pending) { wakes[n_wakes++] = pending[p++]; }
+}
+
+// the recorded time (ms since the wake-up, in steps) agrees with the
+// logged one; the trace counts whole ms of its own delays, so it may be
+// behind by the odd ms, never ahead
+static int time_agrees(uint8_t t_ms, uint64_t wake_us, uint64_t at_us)
+{
+    if (UINT64_MAX == at_us) { return 0; }
+    double ms = (double)(at_us - wake_us) / 1000.0;
+    if (31 * TRACE_TIME_MS == t_ms) { return ms + 1.0 >= t_ms; } // saturated
+    return (ms + 1.0 >= t_ms) && (ms < t_ms + TRACE_TIME_MS + 1.0);
+}
+
+typedef struct
+{
+    unsigned records;
+    unsigned unplaced;
+    unsigned checked;
+    unsigned bad;
+} check_t;
+
+static void check_dump(const tracedec_dump_t* d, check_t* c)
+{
+    // the wake-up the records belong to, once one has been seen
+    uint64_t wake_us = UINT64_MAX;
+    uint64_t next_us = UINT64_MAX;
+    uint64_t wake_number = 0;
+
+    for (unsigned i=0; i<d->n; ++i)
+    {
+        const tracedec_record_t* r = &d->rec[i];
+        ++c->records;
+
+        if (TRACE_EV_WAKE == r->event)
+        {
+            // the wake-up number is kept mod 256: take the latest pass with
+            // that number before the dump
+            uint64_t k = 0;
+            for (uint64_t j=1; j<=n_wakes; ++j)
+            {
+                if (wakes[j - 1] <= (uint64_t)(d->t_s * 1e6) &&
+                    (j & 0xFF) == r->arg)
+                {
+                    k = j;
+                }
+            }
+            ++c->checked;
+            if (0 == k || (wake_number && k != wake_number + 1))
+            {
+                ++c->bad;
+                wake_us = UINT64_MAX;
+                continue;
+            }
+            wake_number = k;
+            wake_us = wakes[k - 1];
+            next_us = (k < n_wakes) ? wakes[k] : UINT64_MAX;
+            continue;
+        }
+        if (UINT64_MAX == wake_us) { ++c->unplaced; continue; }
+
+        ++c->checked;
+        uint64_t set = sim_find_edge(SIM_COIL1, HIGH, wake_us, next_us);
+        uint64_t reset = sim_find_edge(SIM_COIL2, HIGH, wake_us, next_us);
+        uint64_t rise = set < reset ? set : reset;
+        int ok = 1;
+        switch (r->event)
+        {
+        case TRACE_EV_ACCEPT:
+            ok = (UINT64_MAX != rise);
+            break;
+        case TRACE_EV_REJECT:
+            ok = (UINT64_MAX == rise);
+            break;
+        case TRACE_EV_SET:
+        case TRACE_EV_RESET:
+        {
+            uint8_t coil = (TRACE_EV_SET == r->event) ? SIM_COIL1 : SIM_COIL2;
+            uint64_t on = (SIM_COIL1 == coil) ? set : reset;
+            // USE_SCHEDULER ends the pulse on a timer tick after its width
+            uint64_t off = sim_find_edge(coil, LOW, on, next_us);
+            ok = (on == rise) && time_agrees(r->t_ms, wake_us, on) &&
+                 (UINT64_MAX != off) && (off - on >= r->arg * 1000ULL) &&
+                 (off - on <= (r->arg + 2 * TIMER_TICK_MS) * 1000ULL);
+            break;
+        }
+        case TRACE_EV_LOCKOUT_END:
+            ok = time_agrees(r->t_ms, wake_us,
+                             sim_find_edge(SIM_POWER_STATE + POWER_STATE_LOCKOUT,
+                                           LOW, wake_us, next_us));
+            break;
+        default:
+            ok = 0;
+            break;
+        }
+        if (!ok) { ++c->bad; }
+    }
+}
+
+
+int main(int argc, char* argv[])
+{
+    const char* csv_path = NULL;
+    int opt;
+    while (-1 != (opt = getopt(argc, argv, "o:")))
+    {
+        switch (opt)
+        {
+        case 'o': csv_path = optarg; break;
+        default:
+            fprintf(stderr, "usage: %s [-o capture.csv] [n_rounds "
+                    "[stimuli_per_round [seed]]]\n", argv[0]);
+            return 2;
+        }
+    }
+    argc -= optind - 1;
+    argv += optind - 1;
+    unsigned n_rounds = argc > 1 ? (unsigned)strtoul(argv[1], NULL, 0) : 50;
+    unsigned per_round = argc > 2 ? (unsigned)strtoul(argv[2], NULL, 0) : 10;
+    uint32_t rng       = argc > 3 ? (uint32_t)strtoul(argv[3], NULL, 0) : 1;
+    if (0 == rng) { rng = 1; }
+
+    sim_reset();
+    sim_press_pending_hook = record_pending;
+    uint64_t t_us = FIRST_STIMULUS_US;
+    for (unsigned r=0; r<n_rounds; ++r)
+    {
+        for (unsigned i=0; i<per_round; ++i)
+        {
+            if (sim_rand(&rng) & 1)
+            {
+                sim_gen_press(t_us, sim_rand_range(&rng, MIN_HOLD_US, MAX_HOLD_US),
+                              sim_rand_range(&rng, 0, MAX_BOUNCE_US), &rng);
+            }
+            else
+            {
+                sim_gen_glitch(t_us, &rng);
+            }
+            t_us += STIMULUS_PERIOD_US + sim_rand_range(&rng, 0, STIMULUS_JITTER_US);
+        }
+        sim_gen_press(t_us, DUMP_HOLD_US, sim_rand_range(&rng, 0, MAX_BOUNCE_US),
+                      &rng);
+        t_us += DUMP_HOLD_US + DUMP_QUIET_US;
+    }
+    sim_run(t_us);
+
+    // the LED pin, as a logic analyzer would see it
+    size_t n;
+    const sim_event_t* log = sim_log(&n);
+    tracedec_edge_t* led = malloc((n + 1) * sizeof(*led));
+    if (!led) { perror("malloc"); return 1; }
+    size_t n_led = 0;
+    for (size_t i=0; i<n; ++i)
+    {
+        if (SIM_LED != log[i].signal) { continue; }
+        led[n_led++] = (tracedec_edge_t){ (double)log[i].t_us / 1e6, log[i].level };
+    }
+    if (csv_path)
+    {
+        FILE* f = fopen(csv_path, "w");
+        if (!f) { perror(csv_path); return 1; }
+        fprintf(f, "Time [s],LED\n0.000000,0\n");
+        for (size_t i=0; i<n_led; ++i)
+        {
+            fprintf(f, "%.6f,%u\n", led[i].t_s, led[i].level);
+        }
+        fclose(f);
+    }
+
+    static tracedec_dump_t dumps[MAX_DUMPS];
+    unsigned damaged;
+    size_t found = tracedec_decode(led, n_led, (double)TRACE_BIT_US, dumps,
+                                   MAX_DUMPS, &damaged);
+
+    find_wakes(log, n);
+    check_t c = { 0 };
+    for (size_t i=0; i<found; ++i) { check_dump(&dumps[i], &c); }
+
+    printf("rounds: %u  dumps decoded: %zu  damaged: %u  records: %u "
+           "(before the first wake-up of their dump: %u)  checked: %u  "
+           "disagree: %u\n", n_rounds, found, damaged, c.records, c.unplaced,
+           c.checked, c.bad);
+    if (found)
+    {
+        printf("last dump:\n");
+        tracedec_print(stdout, &dumps[found - 1]);
+    }
+
+    free(led);
+    free(wakes);
+    free(pending);
+    return (found != n_rounds || damaged || c.bad) ? 1 : 0;
+}
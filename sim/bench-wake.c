@@ -0,0 +1,263 @@
+// Copyright (c) Matthew Garman.  All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for
+// license information.
+
+
+/*
+ * wake-up race check: runs the core's main() on the host simulation once
+ * through a script of short presses and glitches, then again with a clean
+ * press (no bounce, held for INJECT_HOLD_US) added
+ *   - at every MRC_* call of that run, i.e. between any two calls of the
+ *     core: in particular, between its last look at the switch and the
+ *     sleep, and at every point of the post-press lockout
+ *   - every SWEEP_STEP_US across each stimulus and the quiet time after it
+ * wherever the scripted switch has been up for RELEASE_MIN_US and stays
+ * so until the added press is over (a release any shorter, within the
+ * lockout, is taken for bounce, see LOCKOUT_POLL_MS); each time checks that
+ * the press moves the relay exactly once, and reports the latency from the
+ * press to the coil edge, split by whether the mcu was asleep (power-down)
+ * or awake at the time
+ * exits non-zero on a press lost or doubled, or a latency beyond the bound:
+ * a press that lands just after another one sits out that one's coil pulse
+ * and lockout, then is debounced
+ *
+ * usage: bench-wake [n_stimuli [seed]]
+ */
+
+#include "simlib.h"
+
+#include "../mcu-relay-controller-iface.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef USE_GESTURES
+// a press is then not a toggle: it may be half of a double tap
+#  error "bench-wake: not with USE_GESTURES"
+#endif
+#if MRC_N_CHANNELS != 1
+#  error "bench-wake: single channel only"
+#endif
+
+#define FIRST_STIMULUS_US  3000000UL
+#define STIMULUS_PERIOD_US  600000UL
+#define MIN_HOLD_US          20000UL
+#define MAX_HOLD_US          60000UL
+#define MAX_BOUNCE_US         2000UL
+#define TAIL_US             500000UL
+
+#define INJECT_HOLD_US      200000UL
+#define RELEASE_MIN_US      ((LOCKOUT_POLL_MS + 1) * 1000UL)
+#define AFTER_RELEASE_US    150000UL // the release must not move the relay
+#define SWEEP_STEP_US          250UL
+
+// the coil pulse of the press before, the lockout, the debounce of a clean
+// press (SWITCH_DEBOUNCE_TARGET reads, 1ms apart) and the wake-up
+#define LATENCY_BOUND_MS \
+    (RELAY_SETTLE_TIME_MS + SWITCH_DEBOUNCE_TIME_MS + 8 + 2)
+
+static uint64_t inject_at_call; // sim_hal_calls at which to add the press
+static uint64_t inject_us;      // when it was added
+static uint64_t* call_us;       // baseline: virtual time of every MRC_* call
+static size_t n_call_us;
+static size_t cap_call_us;
+
+static void script(unsigned n_stimuli, uint32_t rng)
+{
+    uint64_t t_us = FIRST_STIMULUS_US;
+    for (unsigned i=0; i<n_stimuli; ++i)
+    {
+        if (i & 1)
+        {
+            sim_gen_glitch(t_us, &rng);
+        }
+        else
+        {
+            sim_gen_press(t_us, sim_rand_range(&rng, MIN_HOLD_US, MAX_HOLD_US),
+                          sim_rand_range(&rng, 0, MAX_BOUNCE_US), &rng);
+        }
+        t_us += STIMULUS_PERIOD_US;
+    }
+}
+
+static void record_call(void)
+{
+    if (n_call_us == cap_call_us)
+    {
+        cap_call_us = cap_call_us ? 2 * cap_call_us : 1024;
+        call_us = realloc(call_us, cap_call_us * sizeof(*call_us));
+        if (!call_us) { perror("realloc"); exit(1); }
+    }
+    call_us[n_call_us++] = sim_now_us;
+}
+
+static void inject_press(uint64_t t_us)
+{
+    inject_us = t_us;
+    sim_switch_insert_edge(t_us, LOW);
+    sim_switch_insert_edge(t_us + INJECT_HOLD_US, HIGH);
+}
+
+static void inject_at_hal_call(void)
+{
+    if (sim_hal_calls == inject_at_call) { inject_press(sim_now_us); }
+}
+
+// switch edges of the script alone, from the baseline run's log
+static uint64_t* script_edges;
+static uint8_t* script_levels;
+static size_t n_script_edges;
+
+// the switch is up, with no scripted edge, for RELEASE_MIN_US before t_us
+// and until the added press is over; and the startup is over
+static int valid_point(uint64_t t_us)
+{
+    if (t_us < FIRST_STIMULUS_US) { return 0; }
+    uint64_t from_us = t_us > RELEASE_MIN_US ? t_us - RELEASE_MIN_US : 0;
+    uint64_t to_us = t_us + INJECT_HOLD_US + AFTER_RELEASE_US;
+    uint8_t level = HIGH;
+    for (size_t i=0; i<n_script_edges; ++i)
+    {
+        if (script_edges[i] > to_us) { break; }
+        if (script_edges[i] >= from_us) { return 0; }
+        level = script_levels[i];
+    }
+    return HIGH == level;
+}
+
+static uint64_t run(unsigned n_stimuli, uint32_t seed, uint64_t until_us)
+{
+    sim_reset();
+    script(n_stimuli, seed);
+    return sim_run(until_us);
+}
+
+// the checks above for a run with the press added at inject_us; sets
+// *latency_us, and *asleep if the mcu was in power-down
+static int check(uint64_t* latency_us, uint8_t* asleep)
+{
+    uint8_t level[SIM_N_SIGNALS];
+    sim_levels_at(inject_us, level);
+    *asleep = !level[SIM_AWAKE];
+
+    uint64_t to_us = inject_us + INJECT_HOLD_US + AFTER_RELEASE_US;
+    unsigned pulses = sim_count_edges(SIM_COIL1, HIGH, inject_us, to_us) +
+                      sim_count_edges(SIM_COIL2, HIGH, inject_us, to_us);
+    if (1 != pulses) { return 0; }
+
+    uint64_t set = sim_find_edge(SIM_COIL1, HIGH, inject_us, to_us);
+    uint64_t reset = sim_find_edge(SIM_COIL2, HIGH, inject_us, to_us);
+    *latency_us = (set < reset ? set : reset) - inject_us;
+    return 1;
+}
+
+typedef struct
+{
+    const char* name;
+    sim_stats_t asleep;
+    sim_stats_t awake;
+    unsigned points;
+    unsigned failed;
+    uint64_t worst_us;
+    uint64_t worst_at_us;
+} sweep_t;
+
+static void sweep_add(sweep_t* s)
+{
+    uint64_t latency_us = 0;
+    uint8_t asleep;
+    ++s->points;
+    if (!check(&latency_us, &asleep))
+    {
+        if (0 == s->failed++)
+        {
+            printf("%s: press at %.6f s lost or doubled\n", s->name,
+                   (double)inject_us / 1e6);
+        }
+        return;
+    }
+    sim_stats_add(asleep ? &s->asleep : &s->awake, (double)latency_us / 1000.0);
+    if (latency_us > s->worst_us)
+    {
+        s->worst_us = latency_us;
+        s->worst_at_us = inject_us;
+    }
+}
+
+static int sweep_report(sweep_t* s)
+{
+    printf("%s: %u points, failed: %u, worst latency %.3f ms at %.6f s "
+           "(bound %u ms)\n", s->name, s->points, s->failed,
+           (double)s->worst_us / 1000.0, (double)s->worst_at_us / 1e6,
+           (unsigned)LATENCY_BOUND_MS);
+    sim_stats_print("  latency, asleep", "ms", &s->asleep);
+    sim_stats_print("  latency, awake", "ms", &s->awake);
+    int bad = s->failed || s->worst_us > (uint64_t)LATENCY_BOUND_MS * 1000;
+    sim_stats_free(&s->asleep);
+    sim_stats_free(&s->awake);
+    return bad;
+}
+
+
+int main(int argc, char* argv[])
+{
+    unsigned n_stimuli = argc > 1 ? (unsigned)strtoul(argv[1], NULL, 0) : 6;
+    uint32_t seed      = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 0) : 1;
+    if (0 == seed) { seed = 1; }
+    const uint64_t until_us =
+        FIRST_STIMULUS_US + (uint64_t)n_stimuli * STIMULUS_PERIOD_US + TAIL_US;
+
+    // the baseline: every MRC_* call, and the scripted switch edges
+    sim_hal_call_hook = record_call;
+    run(n_stimuli, seed, until_us);
+    sim_hal_call_hook = NULL;
+    size_t n;
+    const sim_event_t* log = sim_log(&n);
+    script_edges = malloc((n + 1) * sizeof(*script_edges));
+    script_levels = malloc(n + 1);
+    if (!script_edges || !script_levels) { perror("malloc"); return 1; }
+    for (size_t i=0; i<n; ++i)
+    {
+        if (SIM_SWITCH != log[i].signal) { continue; }
+        script_edges[n_script_edges] = log[i].t_us;
+        script_levels[n_script_edges++] = log[i].level;
+    }
+
+    // the run is the baseline's up to the call the press is added at
+    sweep_t calls = { .name = "every MRC_* call" };
+    sim_hal_call_hook = inject_at_hal_call;
+    for (size_t i=0; i<n_call_us; ++i)
+    {
+        if (!valid_point(call_us[i])) { continue; }
+        inject_at_call = i + 1;
+        run(n_stimuli, seed, until_us);
+        sweep_add(&calls);
+    }
+    sim_hal_call_hook = NULL;
+
+    char steps_name[32];
+    snprintf(steps_name, sizeof(steps_name), "every %lu us", SWEEP_STEP_US);
+    sweep_t steps = { .name = steps_name };
+    for (unsigned k=0; k<n_stimuli; ++k)
+    {
+        uint64_t from_us = FIRST_STIMULUS_US + (uint64_t)k * STIMULUS_PERIOD_US;
+        for (uint64_t t_us = from_us; t_us < from_us + STIMULUS_PERIOD_US;
+             t_us += SWEEP_STEP_US)
+        {
+            if (!valid_point(t_us)) { continue; }
+            sim_reset();
+            script(n_stimuli, seed);
+            inject_press(t_us);
+            sim_run(until_us);
+            sweep_add(&steps);
+        }
+    }
+
+    int status = sweep_report(&calls);
+    status |= sweep_report(&steps);
+
+    free(call_us);
+    free(script_edges);
+    free(script_levels);
+    return status;
+}
@@ -0,0 +1,184 @@
+// Copyright (c) Matthew Garman.  All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for
+// license information.
+
+#include "energy.h"
+
+#include "../mcu-relay-controller-iface.h"
+
+// - ATtiny13A/85: datasheet typicals at 1MHz (low: 1/8 of that), scaled
+//   from the 1.8V/3V figures to 3.3V; v5.x board with a Kemet EC2-3TNU
+//   (64 ohm coil) driven through a transistor
+// - PIC12F675: 4MHz internal oscillator at 5V (no idle mode, no clock
+//   scaling); no reference PCB, assume a 5V Panasonic TQ2-L-5V (178 ohm
+//   coil) driven directly
+// - PIC10F320: 1MHz at 3.3V (low: 250kHz; no idle mode); v3.0 board with
+//   an EC2-3TNU
+// - LED: a high-efficiency LED with a ~1k resistor
+// - a non-latching relay (USE_NON_LATCHING) is assumed to have the same
+//   coil; the hold PWM is Timer1 in idle mode on the ATtiny85, PWM2 on the
+//   pic10f320, which cannot sleep while it runs; the pic12f675 holds at
+//   full current, and the ATtiny13 is not supported
+// - a dimmed LED (USE_LED_DIM): Timer0 in idle mode on the ATtiny, PWM1 on
+//   the pic10f320 (awake, as the hold), nothing on the pic12f675; the
+//   watchdog pulses are ATtiny only: 16ms, its oscillator's datasheet
+//   current scaled to 3.3V, and ~50 cycles per wake-up besides the pulse
+// - the simulated timing (interrupt and wake-up cycles) is the ATtiny's
+#define HOLD_PWM (RELAY_HOLD_PERCENT / 100.0)
+const energy_target_t energy_targets[] =
+{
+    // name        board              vdd  active idle  act-lo idl-lo sleep coil  led  hold      hold wait       LED PWM wait    wdt ms wdt uA wake us
+    { "attiny13",  "v5.x, EC2-3TNU",  3.3, 0.40,  0.05, 0.09,  0.02,  0.15, 48.0, 2.0, 0,        PWM_WAIT_NONE,  PWM_WAIT_IDLE,  16,    4.5,   50 },
+    { "attiny85",  "v5.x, EC2-3TNU",  3.3, 0.55,  0.10, 0.12,  0.03,  0.20, 48.0, 2.0, HOLD_PWM, PWM_WAIT_IDLE,  PWM_WAIT_IDLE,  16,    5.0,   50 },
+    { "pic12f675", "5V, TQ2-L-5V",    5.0, 1.10,  1.10, 1.10,  1.10,  0.01, 28.0, 2.0, 1,        PWM_WAIT_SLEEP, PWM_WAIT_NONE,  0,     0,     0  },
+    { "pic10f320", "v3.0, EC2-3TNU",  3.3, 0.20,  0.20, 0.07,  0.07,  0.03, 48.0, 2.0, HOLD_PWM, PWM_WAIT_AWAKE, PWM_WAIT_AWAKE, 0,     0,     0  },
+};
+const size_t n_energy_targets = sizeof(energy_targets) / sizeof(energy_targets[0]);
+
+const char* const energy_bucket_names[ENERGY_N_BUCKETS] =
+{
+    "coil", "debounce", "lockout", "hold", "awake", "sleep"
+};
+
+// the mcu's current while it waits for a press with a PWM running (wait,
+// PWM_WAIT_*), above the power-down baseline
+static double pwm_wait_mA(const energy_target_t* tgt, uint8_t wait)
+{
+    switch (wait)
+    {
+    case PWM_WAIT_IDLE:  return tgt->idle_mA - tgt->sleep_uA / 1000.0;
+    case PWM_WAIT_AWAKE: return tgt->active_mA - tgt->sleep_uA / 1000.0;
+    default:             return 0;
+    }
+}
+
+// the simulation idles while the relay is held, as the ATtiny85 does; the
+// other targets' hold_wait takes its place (the dimmed LED's wait is in
+// energy_on_mA(), the simulation powers down)
+static void account_segment(const energy_target_t* tgt, const uint8_t* level,
+                            double dt_us, energy_account_t* acct)
+{
+    uint8_t coil = level[SIM_COIL1] || level[SIM_COIL2];
+    uint8_t held = level[SIM_COIL_HOLD];
+    uint8_t bucket =
+        (coil || level[SIM_POWER_STATE + POWER_STATE_COIL]) ? ENERGY_COIL     :
+        level[SIM_POWER_STATE + POWER_STATE_DEBOUNCE]       ? ENERGY_DEBOUNCE :
+        level[SIM_POWER_STATE + POWER_STATE_LOCKOUT]        ? ENERGY_LOCKOUT  :
+        held                                                ? ENERGY_HOLD     :
+        level[SIM_AWAKE]                                    ? ENERGY_AWAKE    :
+                                                              ENERGY_SLEEP;
+
+    double mA = 0;
+    if (ENERGY_HOLD == bucket && !level[SIM_CPU])
+    {
+        mA += pwm_wait_mA(tgt, tgt->hold_wait);
+    }
+    else if (level[SIM_AWAKE])
+    {
+        if (level[SIM_CLOCK_LOW])
+        {
+            mA += level[SIM_CPU] ? tgt->active_low_mA : tgt->idle_low_mA;
+        }
+        else
+        {
+            mA += level[SIM_CPU] ? tgt->active_mA : tgt->idle_mA;
+        }
+        mA -= tgt->sleep_uA / 1000.0;
+    }
+    if (coil)      { mA += tgt->coil_mA; }
+    else if (held) { mA += tgt->coil_mA * tgt->hold_duty; }
+
+    acct->t_us[bucket] += dt_us;
+    acct->charge_uC[bucket] += mA * dt_us / 1000.0; // mA * us = nC
+    if (level[SIM_LED]) { acct->led_on_us += dt_us; }
+}
+
+void energy_account(const energy_target_t* tgt, uint64_t from_us,
+                    uint64_t to_us, energy_account_t* acct)
+{
+    size_t n;
+    const sim_event_t* log = sim_log(&n);
+    uint8_t level[SIM_N_SIGNALS];
+    uint64_t t_us = from_us;
+
+    *acct = (energy_account_t){ { 0 } };
+    sim_levels_at(from_us, level);
+
+    for (size_t i=sim_log_lower_bound(from_us); i<n && log[i].t_us<to_us; ++i)
+    {
+        account_segment(tgt, level, (double)(log[i].t_us - t_us), acct);
+        level[log[i].signal] = log[i].level;
+        t_us = log[i].t_us;
+    }
+    account_segment(tgt, level, (double)(to_us - t_us), acct);
+}
+
+double energy_on_mA(const energy_target_t* tgt, uint8_t hold, uint8_t led,
+                    double led_duty)
+{
+    double mA = 0;
+    uint8_t wait = PWM_WAIT_SLEEP;
+    if (ENERGY_HOLD_FULL == hold) { mA += tgt->coil_mA; }
+    if (ENERGY_HOLD_PWM == hold && tgt->hold_duty > 0)
+    {
+        mA += tgt->coil_mA * tgt->hold_duty;
+        if (tgt->hold_wait > wait) { wait = tgt->hold_wait; }
+    }
+
+    double pulse = 0; // share of the time awake for the watchdog pulses
+    switch (led)
+    {
+    case ENERGY_LED_FULL:
+        mA += tgt->led_mA;
+        break;
+    case ENERGY_LED_PWM:
+        if (PWM_WAIT_NONE == tgt->led_pwm_wait) { break; }
+        mA += tgt->led_mA * led_duty;
+        if (tgt->led_pwm_wait > wait) { wait = tgt->led_pwm_wait; }
+        break;
+    case ENERGY_LED_WDT:
+        if (0 == tgt->wdt_ms) { break; }
+        mA += tgt->led_mA * led_duty + tgt->wdt_uA / 1000.0;
+        pulse = led_duty + tgt->wdt_wake_us / 1000.0 / tgt->wdt_ms;
+        break;
+    default:
+        break;
+    }
+
+    // the pulses are spun at the full clock, on top of whatever the wait
+    // costs already
+    double wait_mA = pwm_wait_mA(tgt, wait);
+    double active_mA = tgt->active_mA - tgt->sleep_uA / 1000.0;
+    return mA + wait_mA + pulse * (active_mA - wait_mA);
+}
+
+// the time the relay is held in the simulated run depends on the spacing of
+// its presses: the hold is charged by on_fraction instead
+double energy_average_uA(const energy_target_t* tgt,
+                         const energy_account_t* acct, unsigned n_presses,
+                         double presses_per_hour, double on_fraction,
+                         uint8_t with_led)
+{
+    double press_uC = 0;
+    for (uint8_t b=0; b<ENERGY_N_BUCKETS; ++b)
+    {
+        if (ENERGY_HOLD != b) { press_uC += acct->charge_uC[b]; }
+    }
+    press_uC /= n_presses;
+
+#ifdef USE_NON_LATCHING
+    uint8_t hold = ENERGY_HOLD_PWM;
+#else
+    uint8_t hold = ENERGY_HOLD_NONE;
+#endif // USE_NON_LATCHING
+#ifdef USE_LED_DIM
+    uint8_t led = (LED_DIM_METHOD == LED_DIM_WDT) ? ENERGY_LED_WDT : ENERGY_LED_PWM;
+#else
+    uint8_t led = ENERGY_LED_FULL;
+#endif // USE_LED_DIM
+    if (!with_led) { led = ENERGY_LED_OFF; }
+
+    double uA = tgt->sleep_uA + press_uC * presses_per_hour / 3600.0;
+    uA += on_fraction * energy_on_mA(tgt, hold, led, LED_DIM_PERCENT / 100.0) * 1000.0;
+    return uA;
+}
@@ -0,0 +1,118 @@
+// Copyright (c) Matthew Garman.  All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for
+// license information.
+
+#ifndef ENERGY_H__
+#define ENERGY_H__
+
+/*
+ * energy model for the host simulation: per-target supply currents, and
+ * attribution of simulated time and charge to the core's power states
+ */
+
+#include "simlib.h"
+
+#include <stdint.h>
+#include <stddef.h>
+
+// supply currents of one mcu on its reference board; the mcu figures are
+// typical datasheet values at the given supply voltage and the firmware's
+// clock, so treat the results as estimates for comparing firmware
+// variants, not as a substitute for measuring a board
+typedef struct
+{
+    const char* name;
+    const char* board;
+    double vdd;       // V
+    double active_mA; // cpu running
+    double idle_mA;   // idle mode, timer running (= active_mA without one)
+    double active_low_mA; // the same at CLOCK_PROFILE_LOW (= active_mA,
+    double idle_low_mA;   // idle_mA where the clock cannot be changed)
+    double sleep_uA;  // power-down, wake on pin change only
+    double coil_mA;   // relay coil, while a coil pin is high
+    double led_mA;    // status LED, while lit
+    double hold_duty; // a non-latching relay held (USE_NON_LATCHING): share
+                      // of coil_mA drawn, 1 where there is no PWM on the
+                      // coil pin; 0 where it is not supported
+    uint8_t hold_wait; // how the mcu waits for a press meanwhile, PWM_WAIT_*
+    uint8_t led_pwm_wait; // the same while the LED PWM runs (USE_LED_DIM)
+    double wdt_ms;    // watchdog period, for the LED pulses (USE_LED_DIM);
+                      // 0 where they are not supported
+    double wdt_uA;    // watchdog oscillator, while it runs in power-down
+    double wdt_wake_us; // cpu time of each watchdog wake-up, besides the
+                        // pulse: the wake-up, interrupt and loop
+} energy_target_t;
+
+// how the mcu waits for a press while a PWM runs
+enum
+{
+    PWM_WAIT_NONE = 0, // no such PWM: not supported
+    PWM_WAIT_SLEEP,    // power-down, as with nothing running
+    PWM_WAIT_IDLE,     // idle mode: the PWM needs the clock
+    PWM_WAIT_AWAKE     // no idle mode: the cpu spins
+};
+
+// the relay held ON, and the LED lit, for energy_on_mA()
+enum
+{
+    ENERGY_HOLD_NONE = 0, // latching relay: no hold
+    ENERGY_HOLD_FULL,     // non-latching, at the full coil current
+    ENERGY_HOLD_PWM       // non-latching, by the target's hold PWM
+};
+enum
+{
+    ENERGY_LED_OFF = 0,
+    ENERGY_LED_FULL,      // lit steadily
+    ENERGY_LED_PWM,       // dimmed by PWM (LED_DIM_PWM)
+    ENERGY_LED_WDT        // dimmed by watchdog pulses (LED_DIM_WDT)
+};
+
+extern const energy_target_t energy_targets[];
+extern const size_t n_energy_targets;
+
+// where the time went: each instant is attributed to exactly one bucket,
+// the first that applies in this order
+enum
+{
+    ENERGY_COIL = 0, // POWER_STATE_COIL marked (or a coil pin high)
+    ENERGY_DEBOUNCE, // POWER_STATE_DEBOUNCE marked
+    ENERGY_LOCKOUT,  // POWER_STATE_LOCKOUT marked
+    ENERGY_HOLD,     // relay held (USE_NON_LATCHING), nothing marked: the
+                     // mcu per the target's hold_wait
+    ENERGY_AWAKE,    // awake, nothing marked
+    ENERGY_SLEEP,    // power-down sleep
+    ENERGY_N_BUCKETS
+};
+
+extern const char* const energy_bucket_names[ENERGY_N_BUCKETS];
+
+typedef struct
+{
+    double t_us[ENERGY_N_BUCKETS];
+    double charge_uC[ENERGY_N_BUCKETS]; // above the power-down baseline,
+                                        // excluding the LED
+    double led_on_us;
+} energy_account_t;
+
+// attribute the simulated interval [from_us, to_us) for target tgt
+void energy_account(const energy_target_t* tgt, uint64_t from_us,
+                    uint64_t to_us, energy_account_t* acct);
+
+// supply current above the power-down baseline while the relay is ON and
+// the mcu waits for a press: the relay's hold (ENERGY_HOLD_*), and the LED
+// (ENERGY_LED_*, dimmed to led_duty); the mcu waits in the deepest sleep
+// that the PWMs running allow.  what the target does not support costs
+// nothing
+double energy_on_mA(const energy_target_t* tgt, uint8_t hold, uint8_t led,
+                    double led_duty);
+
+// average supply current for a long-run press rate, given the account of
+// n_presses presses; the relay is ON (and the LED lit) for on_fraction of
+// the time, which costs energy_on_mA() as built (USE_NON_LATCHING,
+// USE_LED_DIM); with_led: include the LED's current
+double energy_average_uA(const energy_target_t* tgt,
+                         const energy_account_t* acct, unsigned n_presses,
+                         double presses_per_hour, double on_fraction,
+                         uint8_t with_led);
+
+#endif // ENERGY_H__
@@ -0,0 +1,233 @@
+// Copyright (c) Matthew Garman.  All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for
+// license information.
+
+#include "simlib.h"
+
+#include "../mcu-relay-controller-iface.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+
+uint32_t sim_rand(uint32_t* state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+uint32_t sim_rand_range(uint32_t* state, uint32_t lo, uint32_t hi)
+{
+    return lo + sim_rand(state) % (hi - lo + 1);
+}
+
+uint64_t sim_gen_bounce(uint64_t t_us, uint32_t bounce_us, uint8_t final_level,
+                        uint32_t* rng)
+{
+    const uint64_t end_us = t_us + bounce_us;
+    uint8_t level = final_level;
+
+    sim_switch_add_edge(t_us, level);
+    for (;;)
+    {
+        uint64_t next_us = t_us + sim_rand_range(rng, SIM_BOUNCE_MIN_GAP_US,
+                                                 SIM_BOUNCE_MAX_GAP_US);
+        if (next_us >= end_us) { break; }
+        t_us = next_us;
+        level = !level;
+        sim_switch_add_edge(t_us, level);
+    }
+    if (level != final_level)
+    {
+        t_us = end_us;
+        sim_switch_add_edge(t_us, final_level);
+    }
+    return t_us;
+}
+
+void sim_gen_press(uint64_t t_us, uint32_t hold_us, uint32_t bounce_us,
+                   uint32_t* rng)
+{
+    sim_gen_bounce(t_us, bounce_us, LOW, rng);
+    sim_gen_bounce(t_us + hold_us, bounce_us, HIGH, rng);
+}
+
+void sim_gen_glitch(uint64_t t_us, uint32_t* rng)
+{
+    uint32_t n_spikes = sim_rand_range(rng, 1, SIM_GLITCH_MAX_SPIKES);
+    for (uint32_t i=0; i<n_spikes; ++i)
+    {
+        uint8_t is_long = sim_rand_range(rng, 1, 100) <= SIM_GLITCH_LONG_PERCENT;
+        sim_switch_add_edge(t_us, LOW);
+        t_us += sim_rand_range(rng, SIM_GLITCH_MIN_WIDTH_US,
+                               is_long ? SIM_GLITCH_LONG_WIDTH_US
+                                       : SIM_GLITCH_MAX_WIDTH_US);
+        sim_switch_add_edge(t_us, HIGH);
+        t_us += sim_rand_range(rng, SIM_BOUNCE_MIN_GAP_US,
+                               SIM_BOUNCE_MAX_GAP_US);
+    }
+}
+
+size_t sim_log_lower_bound(uint64_t t_us)
+{
+    size_t n;
+    const sim_event_t* log = sim_log(&n);
+    size_t lo = 0;
+    size_t hi = n;
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if (log[mid].t_us < t_us) { lo = mid + 1; }
+        else                      { hi = mid;     }
+    }
+    return lo;
+}
+
+uint64_t sim_find_edge(uint8_t signal, uint8_t level,
+                       uint64_t from_us, uint64_t to_us)
+{
+    size_t n;
+    const sim_event_t* log = sim_log(&n);
+
+    for (size_t i=sim_log_lower_bound(from_us); i<n && log[i].t_us<to_us; ++i)
+    {
+        if (log[i].signal == signal && log[i].level == level)
+        {
+            return log[i].t_us;
+        }
+    }
+    return UINT64_MAX;
+}
+
+unsigned sim_count_edges(uint8_t signal, uint8_t level,
+                         uint64_t from_us, uint64_t to_us)
+{
+    size_t n;
+    const sim_event_t* log = sim_log(&n);
+    unsigned count = 0;
+
+    for (size_t i=sim_log_lower_bound(from_us); i<n && log[i].t_us<to_us; ++i)
+    {
+        if (log[i].signal == signal && log[i].level == level) { ++count; }
+    }
+    return count;
+}
+
+unsigned sim_count_edges_while(uint8_t signal, uint8_t level,
+                               uint8_t other, uint8_t other_level,
+                               uint64_t from_us, uint64_t to_us)
+{
+    size_t n;
+    const sim_event_t* log = sim_log(&n);
+    unsigned count = 0;
+
+    // other's level in effect at from_us: the last transition before it
+    uint8_t cur = (SIM_SWITCH == other || SIM_POWER_GOOD == other ? HIGH : LOW);
+    size_t i = sim_log_lower_bound(from_us);
+    for (size_t j=i; j-- > 0; )
+    {
+        if (log[j].signal == other) { cur = log[j].level; break; }
+    }
+
+    for ( ; i<n && log[i].t_us<to_us; ++i)
+    {
+        if (log[i].signal == other) { cur = log[i].level; }
+        else if (log[i].signal == signal && log[i].level == level &&
+                 cur == other_level)
+        {
+            ++count;
+        }
+    }
+    return count;
+}
+
+uint64_t sim_time_at_level(uint8_t signal, uint8_t level,
+                           uint64_t from_us, uint64_t to_us)
+{
+    size_t n;
+    const sim_event_t* log = sim_log(&n);
+
+    // level in effect at from_us: the last transition before it
+    uint8_t cur = (SIM_SWITCH == signal || SIM_POWER_GOOD == signal ? HIGH : LOW);
+    size_t i = sim_log_lower_bound(from_us);
+    for (size_t j=i; j-- > 0; )
+    {
+        if (log[j].signal == signal) { cur = log[j].level; break; }
+    }
+
+    uint64_t total = 0;
+    uint64_t since = from_us;
+    for ( ; i<n && log[i].t_us<to_us; ++i)
+    {
+        if (log[i].signal != signal) { continue; }
+        if (cur == level) { total += log[i].t_us - since; }
+        cur = log[i].level;
+        since = log[i].t_us;
+    }
+    if (cur == level) { total += to_us - since; }
+    return total;
+}
+
+void sim_levels_at(uint64_t t_us, uint8_t* level)
+{
+    size_t n;
+    const sim_event_t* log = sim_log(&n);
+    size_t end = sim_log_lower_bound(t_us);
+
+    for (uint8_t i=0; i<SIM_N_SIGNALS; ++i) { level[i] = LOW; }
+    level[SIM_SWITCH] = HIGH;
+    level[SIM_POWER_GOOD] = HIGH;
+    for (size_t i=0; i<end; ++i) { level[log[i].signal] = log[i].level; }
+}
+
+void sim_stats_add(sim_stats_t* s, double x)
+{
+    if (s->n == s->cap)
+    {
+        s->cap = s->cap ? 2 * s->cap : 256;
+        s->v = realloc(s->v, s->cap * sizeof(*s->v));
+        if (!s->v) { perror("realloc"); exit(1); }
+    }
+    s->v[s->n++] = x;
+}
+
+static int cmp_double(const void* a, const void* b)
+{
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static double percentile(const sim_stats_t* s, double p)
+{
+    size_t i = (size_t)(p * (double)(s->n - 1) + 0.5);
+    return s->v[i];
+}
+
+void sim_stats_print(const char* label, const char* unit, sim_stats_t* s)
+{
+    if (0 == s->n)
+    {
+        printf("%-28s (no samples)\n", label);
+        return;
+    }
+
+    qsort(s->v, s->n, sizeof(*s->v), cmp_double);
+    double sum = 0;
+    for (size_t i=0; i<s->n; ++i) { sum += s->v[i]; }
+
+    printf("%-28s n=%-7zu min=%-9.3f p50=%-9.3f p90=%-9.3f p99=%-9.3f "
+           "max=%-9.3f mean=%.3f %s\n",
+           label, s->n, s->v[0], percentile(s, 0.50), percentile(s, 0.90),
+           percentile(s, 0.99), s->v[s->n - 1], sum / (double)s->n, unit);
+}
+
+void sim_stats_free(sim_stats_t* s)
+{
+    free(s->v);
+    s->v = NULL;
+    s->n = s->cap = 0;
+}
@@ -0,0 +1,88 @@
+// Copyright (c) Matthew Garman.  All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for
+// license information.
+
+#ifndef SIMLIB_H__
+#define SIMLIB_H__
+
+/*
+ * helpers shared by the host simulation programs: switch waveform
+ * generators, event log queries and summary statistics
+ */
+
+#include "../hardware-details/hostsim.h"
+
+#include <stdint.h>
+#include <stddef.h>
+
+// contact bounce is modelled as a burst of transitions whose spacing is
+// uniformly distributed in this range
+#define SIM_BOUNCE_MIN_GAP_US 20
+#define SIM_BOUNCE_MAX_GAP_US 400
+
+// a glitch (e.g. RF picked up by the footswitch wire, not a press) is
+// modelled as a burst of SIM_GLITCH_MAX_SPIKES or fewer low-going spikes;
+// most are short, but SIM_GLITCH_LONG_PERCENT of them (cable movement, a
+// footswitch brushed but not pressed) last up to SIM_GLITCH_LONG_WIDTH_US
+#define SIM_GLITCH_MAX_SPIKES      3
+#define SIM_GLITCH_MIN_WIDTH_US    2
+#define SIM_GLITCH_MAX_WIDTH_US    50
+#define SIM_GLITCH_LONG_PERCENT    10
+#define SIM_GLITCH_LONG_WIDTH_US   2000
+
+// small, fast, reproducible PRNG (xorshift32); state must be non-zero
+uint32_t sim_rand(uint32_t* state);
+
+// uniformly distributed in [lo, hi]
+uint32_t sim_rand_range(uint32_t* state, uint32_t lo, uint32_t hi);
+
+// script a transition of the switch to final_level starting at t_us, with
+// bounce lasting (up to) bounce_us; returns the time of the last edge
+uint64_t sim_gen_bounce(uint64_t t_us, uint32_t bounce_us, uint8_t final_level,
+                        uint32_t* rng);
+
+// script a press at t_us held for hold_us, both edges bouncing for bounce_us
+void sim_gen_press(uint64_t t_us, uint32_t hold_us, uint32_t bounce_us,
+                   uint32_t* rng);
+
+// script a glitch at t_us; the switch is back high within about 8ms
+void sim_gen_glitch(uint64_t t_us, uint32_t* rng);
+
+// index of the first logged event at or after t_us
+size_t sim_log_lower_bound(uint64_t t_us);
+
+// level of every signal in effect at t_us (level has SIM_N_SIGNALS entries)
+void sim_levels_at(uint64_t t_us, uint8_t* level);
+
+// time of the first transition of signal to level within [from_us, to_us),
+// or UINT64_MAX if there is none
+uint64_t sim_find_edge(uint8_t signal, uint8_t level,
+                       uint64_t from_us, uint64_t to_us);
+
+// number of transitions of signal to level within [from_us, to_us)
+unsigned sim_count_edges(uint8_t signal, uint8_t level,
+                         uint64_t from_us, uint64_t to_us);
+
+// number of transitions of signal to level within [from_us, to_us) made
+// while other was at other_level (in the order they were logged)
+unsigned sim_count_edges_while(uint8_t signal, uint8_t level,
+                               uint8_t other, uint8_t other_level,
+                               uint64_t from_us, uint64_t to_us);
+
+// total time signal spent at level within [from_us, to_us)
+uint64_t sim_time_at_level(uint8_t signal, uint8_t level,
+                           uint64_t from_us, uint64_t to_us);
+
+// sample collector with a one-line percentile summary
+typedef struct
+{
+    double* v;
+    size_t n;
+    size_t cap;
+} sim_stats_t;
+
+void sim_stats_add(sim_stats_t* s, double x);
+void sim_stats_print(const char* label, const char* unit, sim_stats_t* s);
+void sim_stats_free(sim_stats_t* s);
+
+#endif // SIMLIB_H__
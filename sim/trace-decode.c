@@ -0,0 +1,107 @@
+// Copyright (c) Matthew Garman.  All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for
+// license information.
+
+
+/*
+ * event trace decoder (USE_TRACE): finds the trace dumps in a capture of the
+ * LED pin and prints each as a timeline, one line per record
+ *
+ * the capture is a logic-analyzer export (or sim/bench-trace -o) as CSV:
+ * time in seconds in the first column, the LED pin level (0/1) in COLUMN
+ * (default 1); lines that do not start with a number (headers) are skipped.
+ * the bit time is measured from the first byte of each dump, the baud rate
+ * only has to be within a factor of two
+ *
+ * usage: trace-decode [-b baud] [FILE[:COLUMN]]   (standard input without FILE)
+ */
+
+#include "tracedec.h"
+
+#include "../mcu-relay-controller-iface.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MAX_DUMPS 64
+
+
+int main(int argc, char* argv[])
+{
+    double baud = TRACE_BAUD;
+    int opt;
+    while (-1 != (opt = getopt(argc, argv, "b:")))
+    {
+        switch (opt)
+        {
+        case 'b': baud = strtod(optarg, NULL); break;
+        default:
+            fprintf(stderr, "usage: %s [-b baud] [FILE[:COLUMN]]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (baud <= 0) { fprintf(stderr, "bad baud rate\n"); return 2; }
+
+    const char* path = NULL;
+    unsigned column = 1;
+    char spec[4096] = "";
+    if (optind < argc)
+    {
+        snprintf(spec, sizeof(spec), "%s", argv[optind]);
+        char* colon = strrchr(spec, ':');
+        if (colon)
+        {
+            char* end;
+            unsigned long c = strtoul(colon + 1, &end, 10);
+            if (colon[1] && !*end) { column = (unsigned)c; *colon = '\0'; }
+        }
+        path = spec;
+    }
+
+    FILE* f = path ? fopen(path, "r") : stdin;
+    if (!f) { perror(path); return 1; }
+
+    tracedec_edge_t* edges = NULL;
+    size_t n = 0;
+    size_t cap = 0;
+    uint8_t level = 1;
+    char line[4096];
+    while (fgets(line, sizeof(line), f))
+    {
+        char* end;
+        double t_s = strtod(line, &end);
+        if (end == line) { continue; }  // header, comment, blank
+
+        char* field = end;
+        for (unsigned c=0; c<column && field; ++c)
+        {
+            field = strchr(field, ',');
+            if (field) { ++field; }
+        }
+        if (!field) { continue; }
+        uint8_t l = strtol(field, NULL, 10) ? 1 : 0;
+        if (l == level) { continue; }
+        level = l;
+
+        if (n == cap)
+        {
+            cap = cap ? 2 * cap : 1024;
+            edges = realloc(edges, cap * sizeof(*edges));
+            if (!edges) { perror("realloc"); return 1; }
+        }
+        edges[n++] = (tracedec_edge_t){ t_s, l };
+    }
+    if (path) { fclose(f); }
+
+    static tracedec_dump_t dumps[MAX_DUMPS];
+    unsigned bad;
+    size_t found = tracedec_decode(edges, n, 1e6 / baud, dumps, MAX_DUMPS, &bad);
+    for (size_t i=0; i<found; ++i) { tracedec_print(stdout, &dumps[i]); }
+    if (bad) { printf("damaged dumps skipped: %u\n", bad); }
+    if (0 == found) { fprintf(stderr, "no trace dumps found\n"); }
+
+    free(edges);
+    return found ? 0 : 1;
+}
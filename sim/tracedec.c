@@ -0,0 +1,190 @@
+// Copyright (c) Matthew Garman.  All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for
+// license information.
+
+#include "tracedec.h"
+
+#include "../mcu-relay-controller-iface.h"
+
+#include <math.h>
+
+// a byte must start within this many bit times of the end of the previous
+// one (the core sends them back to back)
+#define TRACEDEC_MAX_GAP_BITS 20
+
+typedef struct
+{
+    const tracedec_edge_t* e;
+    size_t n;
+    double bit_us;
+} line_t;
+
+// index of the first edge at or after t_s
+static size_t edge_at(const line_t* l, double t_s)
+{
+    size_t lo = 0;
+    size_t hi = l->n;
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if (l->e[mid].t_s < t_s) { lo = mid + 1; }
+        else                     { hi = mid;     }
+    }
+    return lo;
+}
+
+// the line idles high before the first edge
+static uint8_t level_at(const line_t* l, double t_s)
+{
+    size_t i = edge_at(l, t_s);
+    if (i < l->n && l->e[i].t_s == t_s) { return l->e[i].level; }
+    return i ? l->e[i - 1].level : 1;
+}
+
+// the frame whose start bit begins with the falling edge at index i, at the
+// current bit time; returns the byte, or -1 on a framing error
+static int read_frame(const line_t* l, size_t i)
+{
+    const double bit_s = l->bit_us / 1e6;
+    const double t0 = l->e[i].t_s;
+    if (0 != l->e[i].level) { return -1; }
+    if (0 != level_at(l, t0 + 0.5 * bit_s)) { return -1; } // start bit
+
+    int b = 0;
+    for (int k=0; k<8; ++k)
+    {
+        if (level_at(l, t0 + (k + 1.5) * bit_s)) { b |= 1 << k; }
+    }
+    if (1 != level_at(l, t0 + 9.5 * bit_s)) { return -1; } // stop bit
+    return b;
+}
+
+// the next frame after the one that started at *t_s: its start bit is the
+// first falling edge after the previous stop bit began
+static int next_frame(const line_t* l, double* t_s)
+{
+    const double bit_s = l->bit_us / 1e6;
+    const double from = *t_s + 9.0 * bit_s;
+    for (size_t i=edge_at(l, from); i<l->n; ++i)
+    {
+        if (l->e[i].t_s > from + TRACEDEC_MAX_GAP_BITS * bit_s) { break; }
+        if (0 == l->e[i].level)
+        {
+            *t_s = l->e[i].t_s;
+            return read_frame(l, i);
+        }
+    }
+    return -1;
+}
+
+// TRACE_SYNC (0x55) starting with the falling edge at index i: ten edges,
+// one per bit (the start bit and the data bits alternate), the last one
+// rising into the stop bit; sets the bit time from them
+static int is_sync(line_t* l, size_t i, double nominal_us)
+{
+    if (i + 9 >= l->n || 0 != l->e[i].level) { return 0; }
+    double bit_us = (l->e[i + 9].t_s - l->e[i].t_s) * 1e6 / 9.0;
+    if (bit_us < 0.5 * nominal_us || bit_us > 2.0 * nominal_us) { return 0; }
+    for (size_t k=1; k<=9; ++k)
+    {
+        const tracedec_edge_t* e = &l->e[i + k];
+        double dt_us = (e->t_s - l->e[i + k - 1].t_s) * 1e6;
+        if (e->level != (k & 1) || fabs(dt_us - bit_us) > 0.25 * bit_us)
+        {
+            return 0;
+        }
+    }
+    l->bit_us = bit_us;
+    return 1;
+}
+
+size_t tracedec_decode(const tracedec_edge_t* edges, size_t n, double bit_us,
+                       tracedec_dump_t* dumps, size_t max, unsigned* n_bad)
+{
+    line_t l = { edges, n, bit_us };
+    size_t found = 0;
+    *n_bad = 0;
+
+    for (size_t i=0; i<n && found<max; ++i)
+    {
+        if (!is_sync(&l, i, bit_us)) { continue; }
+
+        tracedec_dump_t* d = &dumps[found];
+        d->t_s = edges[i].t_s;
+        d->bit_us = l.bit_us;
+
+        double t_s = d->t_s;
+        int magic = next_frame(&l, &t_s);
+        int count = (TRACE_MAGIC == magic) ? next_frame(&l, &t_s) : -1;
+        if (count < 0)
+        {
+            if (TRACE_MAGIC == magic) { ++*n_bad; }
+            continue; // not a dump after all
+        }
+
+        uint8_t check = (uint8_t)count;
+        int ok = 1;
+        for (int r=0; ok && r<count; ++r)
+        {
+            int b0 = next_frame(&l, &t_s);
+            int b1 = (b0 < 0) ? -1 : next_frame(&l, &t_s);
+            if (b1 < 0) { ok = 0; break; }
+            d->rec[r].event = (uint8_t)b0 >> 5;
+            d->rec[r].t_ms = (uint8_t)((b0 & 0x1F) * TRACE_TIME_MS);
+            d->rec[r].arg = (uint8_t)b1;
+            check ^= (uint8_t)(b0 ^ b1);
+        }
+        int sent = ok ? next_frame(&l, &t_s) : -1;
+        if (sent < 0 || (uint8_t)sent != check)
+        {
+            ++*n_bad;
+            continue;
+        }
+
+        d->n = (uint8_t)count;
+        ++found;
+        i = edge_at(&l, t_s + 9.5 * l.bit_us / 1e6) - 1; // on past the dump
+    }
+    return found;
+}
+
+void tracedec_print(FILE* f, const tracedec_dump_t* d)
+{
+    fprintf(f, "dump at %.6f s: %u records (%.1f us/bit, %.0f baud)\n",
+            d->t_s, d->n, d->bit_us, 1e6 / d->bit_us);
+    for (unsigned i=0; i<d->n; ++i)
+    {
+        const tracedec_record_t* r = &d->rec[i];
+        if (TRACE_EV_WAKE == r->event)
+        {
+            fprintf(f, "  wake-up #%u\n", r->arg);
+            continue;
+        }
+
+        // the last step stands for that time or later
+        fprintf(f, "    %s%3u ms  ", 31 * TRACE_TIME_MS == r->t_ms ? ">=" : " +",
+                r->t_ms);
+        switch (r->event)
+        {
+        case TRACE_EV_ACCEPT:
+            if (r->arg) { fprintf(f, "press accepted, %u reads\n", r->arg); }
+            else        { fprintf(f, "press accepted, leading edge\n"); }
+            break;
+        case TRACE_EV_REJECT:
+            fprintf(f, "no press, %u reads\n", r->arg);
+            break;
+        case TRACE_EV_SET:
+            fprintf(f, "relay set, %u ms coil pulse\n", r->arg);
+            break;
+        case TRACE_EV_RESET:
+            fprintf(f, "relay reset, %u ms coil pulse\n", r->arg);
+            break;
+        case TRACE_EV_LOCKOUT_END:
+            fprintf(f, "lockout over\n");
+            break;
+        default:
+            fprintf(f, "unknown event %u (argument %u)\n", r->event, r->arg);
+            break;
+        }
+    }
+}
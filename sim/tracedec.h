@@ -0,0 +1,50 @@
+// Copyright (c) Matthew Garman.  All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for
+// license information.
+
+#ifndef TRACEDEC_H__
+#define TRACEDEC_H__
+
+/*
+ * decoder for the core's event trace dumps (USE_TRACE): 8N1 serial on the
+ * LED pin, given as the pin's edges; shared by sim/trace-decode (captures)
+ * and sim/bench-trace (the host simulation)
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+typedef struct
+{
+    double t_s;    // time of the transition, in seconds
+    uint8_t level; // new level: 0/1
+} tracedec_edge_t;
+
+typedef struct
+{
+    uint8_t event; // TRACE_EV_*
+    uint8_t t_ms;  // time since the wake-up, in TRACE_TIME_MS steps (ms)
+    uint8_t arg;
+} tracedec_record_t;
+
+typedef struct
+{
+    double t_s;    // start of the dump (the start bit of its first byte)
+    double bit_us; // bit time, measured from TRACE_SYNC
+    uint8_t n;
+    tracedec_record_t rec[255];
+} tracedec_dump_t;
+
+// decode the dumps in edges (n of them, in time order, the line high
+// before the first); bit_us is the nominal bit time, corrected for each dump
+// from its TRACE_SYNC byte; fills at most max dumps, and returns how many it
+// found; damaged dumps (framing, count or check byte) are skipped and
+// counted in *n_bad
+size_t tracedec_decode(const tracedec_edge_t* edges, size_t n, double bit_us,
+                       tracedec_dump_t* dumps, size_t max, unsigned* n_bad);
+
+// print a dump as a timeline, one line per record
+void tracedec_print(FILE* f, const tracedec_dump_t* d);
+
+#endif // TRACEDEC_H__